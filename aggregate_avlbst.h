@@ -0,0 +1,370 @@
+#ifndef AGGREGATE_AVLBST_H
+#define AGGREGATE_AVLBST_H
+
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include "avlbst.h"
+
+/**
+* Aggregate policies for AggregateAVLTree. A policy is a monoid over its
+* value_type: combine(a, b) is associative and identity() is its neutral
+* element. combine need not be commutative; the tree always combines in
+* key order. Each entry contributes its Value, converted to value_type.
+*/
+template <typename T>
+struct SumAggregate
+{
+    typedef T value_type;
+    static T identity() { return T(); }
+    static T combine(const T& a, const T& b) { return a + b; }
+};
+
+template <typename T>
+struct MinAggregate
+{
+    typedef T value_type;
+    static T identity() { return std::numeric_limits<T>::max(); }
+    static T combine(const T& a, const T& b) { return (b < a) ? b : a; }
+};
+
+template <typename T>
+struct MaxAggregate
+{
+    typedef T value_type;
+    static T identity() { return std::numeric_limits<T>::lowest(); }
+    static T combine(const T& a, const T& b) { return (a < b) ? b : a; }
+};
+
+/**
+* Node augmentation holding the aggregate of the values in a subtree.
+*/
+template <typename Monoid>
+struct SubtreeAggregate
+{
+    typedef typename Monoid::value_type value_type;
+    static const bool aggregates = true;
+
+    SubtreeAggregate() : aggregate_(Monoid::identity()) { }
+
+    template<typename Item>
+    void update(const Item& item, const SubtreeAggregate* left, const SubtreeAggregate* right)
+    {
+        value_type aggregate = item.second;
+        if(left != nullptr)
+        {
+            aggregate = Monoid::combine(left->aggregate_, aggregate);
+        }
+        if(right != nullptr)
+        {
+            aggregate = Monoid::combine(aggregate, right->aggregate_);
+        }
+        aggregate_ = aggregate;
+    }
+
+    value_type aggregate_;
+};
+
+/**
+* An AVLTree that keeps, in every node, the Monoid aggregate of the values
+* in its subtree, so that the aggregate over any key range (a sum of sizes
+* between two timestamps, the minimum in a window) takes O(log n) instead
+* of a scan over the range.
+*
+* The aggregates follow inserts, removes, rotations, bulk loads and
+* join/split. Values must only be changed through the tree: insert,
+* insert_or_assign, setValue, or assignment to operator[]. Writing through
+* an iterator bypasses the aggregates.
+*/
+template <class Key, class Value, class Monoid = SumAggregate<Value>, class Compare = std::less<Key>,
+          class Alloc = std::allocator<std::pair<const Key, Value> > >
+class AggregateAVLTree : public AVLTree<Key, Value, Compare, Alloc, SubtreeAggregate<Monoid> >
+{
+public:
+    typedef AVLTree<Key, Value, Compare, Alloc, SubtreeAggregate<Monoid> > BaseTree;
+    typedef typename BaseTree::iterator iterator;
+    typedef typename BaseTree::const_iterator const_iterator;
+    typedef typename Monoid::value_type aggregate_type;
+
+    /**
+    * What the non-const operator[] returns: reads give the value, and an
+    * assignment goes through setValue so that the aggregates follow.
+    * Assigning one reference to another (s[1] = s[3]) copies the value;
+    * += and -= are point updates, as for a sum.
+    */
+    class ValueReference
+    {
+    public:
+        ValueReference(const ValueReference& other) = default;
+        ValueReference& operator=(const ValueReference& other);
+        ValueReference& operator=(const Value& value);
+        ValueReference& operator+=(const Value& delta);
+        ValueReference& operator-=(const Value& delta);
+        operator const Value&() const;
+
+    protected:
+        friend class AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>;
+        ValueReference(AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>* tree, Node<Key, Value>* node);
+        AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>* tree_;
+        Node<Key, Value>* node_;
+    };
+
+    AggregateAVLTree();
+    explicit AggregateAVLTree(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit AggregateAVLTree(const Alloc& alloc);
+    template<typename InputIt>
+    AggregateAVLTree(InputIt first, InputIt last, const Compare& comp = Compare(), const Alloc& alloc = Alloc());
+    // Takes over the nodes of an AVLTree with the same augmentation, e.g. one returned by split().
+    explicit AggregateAVLTree(BaseTree&& other) noexcept;
+
+    aggregate_type aggregate() const;
+    aggregate_type aggregate(const Key& low, const Key& high) const;
+
+    void setValue(const Key& key, const Value& value);
+    ValueReference operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    // Same as AVLTree::split, keeping the aggregates.
+    AggregateAVLTree<Key, Value, Monoid, Compare, Alloc> split(const Key& key);
+
+protected:
+    typedef AVLNode<Key, Value, SubtreeAggregate<Monoid> > AggregateNode;
+
+    static aggregate_type subtreeAggregate(const AggregateNode* node);
+};
+
+/*
+  ------------------------------------------------------------------
+  Begin implementations for the AggregateAVLTree::ValueReference class.
+  ------------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference::ValueReference(
+    AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>* tree, Node<Key, Value>* node) :
+    tree_(tree), node_(node)
+{
+
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+typename AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference&
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference::operator=(const Value& value)
+{
+    node_->setValue(value);
+    tree_->valueChanged(node_);
+    return *this;
+}
+
+/*
+ * Assigns the other key's value, not the reference itself.
+ */
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+typename AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference&
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference::operator=(const ValueReference& other)
+{
+    return *this = static_cast<const Value&>(other);
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+typename AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference&
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference::operator+=(const Value& delta)
+{
+    return *this = static_cast<Value>(node_->getValue() + delta);
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+typename AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference&
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference::operator-=(const Value& delta)
+{
+    return *this = static_cast<Value>(node_->getValue() - delta);
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference::operator const Value&() const
+{
+    return node_->getValue();
+}
+
+/*
+  ----------------------------------------------------------------
+  End implementations for the AggregateAVLTree::ValueReference class.
+  ----------------------------------------------------------------
+*/
+
+/*
+  --------------------------------------------------
+  Begin implementations for the AggregateAVLTree class.
+  --------------------------------------------------
+*/
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::AggregateAVLTree()
+{
+
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::AggregateAVLTree(const Compare& comp, const Alloc& alloc) :
+    BaseTree(comp, alloc)
+{
+
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::AggregateAVLTree(const Alloc& alloc) : BaseTree(alloc)
+{
+
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+template<typename InputIt>
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::AggregateAVLTree(InputIt first, InputIt last,
+                                                                       const Compare& comp, const Alloc& alloc) :
+    BaseTree(first, last, comp, alloc)
+{
+
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::AggregateAVLTree(BaseTree&& other) noexcept :
+    BaseTree(std::move(other))
+{
+
+}
+
+/**
+* The aggregate of every value in the tree, in O(1).
+*/
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+typename AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::aggregate_type
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::aggregate() const
+{
+    return subtreeAggregate(static_cast<const AggregateNode*>(this->root_));
+}
+
+/**
+* The aggregate of the values with low <= key <= high, or the identity if
+* there are none. The search goes down to the first node inside the range,
+* then one path collects the part of its left subtree not below low, and
+* another the part of its right subtree not above high. Both paths take
+* whole subtree aggregates wherever a subtree lies inside the range, so
+* the cost is O(log n) whatever the size of the range.
+*/
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+typename AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::aggregate_type
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::aggregate(const Key& low, const Key& high) const
+{
+    //find the topmost node in range; every other node in range is below it
+    const AggregateNode* top = static_cast<const AggregateNode*>(this->root_);
+    while(top != nullptr)
+    {
+        if(compareKeys(this->comp_, top->getKey(), low) < 0)
+        {
+            top = top->getRight();
+        }
+        else if(compareKeys(this->comp_, high, top->getKey()) < 0)
+        {
+            top = top->getLeft();
+        }
+        else
+        {
+            break;
+        }
+    }
+    if(top == nullptr)
+    {
+        return Monoid::identity();
+    }
+
+    //left of top: everything from low on, found in reverse key order, so it is prepended
+    aggregate_type lower = Monoid::identity();
+    for(const AggregateNode* node = top->getLeft(); node != nullptr; )
+    {
+        if(compareKeys(this->comp_, node->getKey(), low) < 0)
+        {
+            node = node->getRight();
+        }
+        else
+        {
+            lower = Monoid::combine(Monoid::combine(node->getValue(), subtreeAggregate(node->getRight())), lower);
+            node = node->getLeft();
+        }
+    }
+
+    //right of top: everything up to high, found in key order, so it is appended
+    aggregate_type upper = Monoid::identity();
+    for(const AggregateNode* node = top->getRight(); node != nullptr; )
+    {
+        if(compareKeys(this->comp_, high, node->getKey()) < 0)
+        {
+            node = node->getLeft();
+        }
+        else
+        {
+            upper = Monoid::combine(upper, Monoid::combine(subtreeAggregate(node->getLeft()), node->getValue()));
+            node = node->getRight();
+        }
+    }
+
+    return Monoid::combine(lower, Monoid::combine(top->getValue(), upper));
+}
+
+/**
+* Overwrites the value of an existing key and updates the aggregates above
+* it, in O(log n). Throws std::out_of_range if the key is not in the tree.
+*/
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+void AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::setValue(const Key& key, const Value& value)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    node->setValue(value);
+    this->valueChanged(node);
+}
+
+/**
+* @precondition The key exists in the map
+* Returns a reference whose assignment goes through setValue.
+*/
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+typename AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::ValueReference
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::operator[](const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    return ValueReference(this, node);
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+Value const & AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::operator[](const Key& key) const
+{
+    return BaseTree::operator[](key);
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc> AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::split(const Key& key)
+{
+    return AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>(BaseTree::split(key));
+}
+
+template<class Key, class Value, class Monoid, class Compare, class Alloc>
+typename AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::aggregate_type
+AggregateAVLTree<Key, Value, Monoid, Compare, Alloc>::subtreeAggregate(const AggregateNode* node)
+{
+    return (node == nullptr) ? Monoid::identity() : node->aggregate_;
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the AggregateAVLTree class.
+  ------------------------------------------------
+*/
+
+#endif
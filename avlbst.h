@@ -6,37 +6,92 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 #include "bst.h"
+#include "frozen_map.h"
 
 struct KeyError { };
 
+/**
+* What AVLTree::bulkLoad does with a run of equal keys in its input:
+* keep the last one (like repeated inserts), keep the first one, or
+* throw std::invalid_argument.
+*/
+enum class DuplicateKeys { KEEP_LAST, KEEP_FIRST, REJECT };
+
+/**
+* The default Augment parameter of AVLNode/AVLTree: no extra data per node.
+*
+* An augmentation is a base class of every AVLNode, holding data derived from
+* the node's subtree (see ranked_avlbst.h and aggregate_avlbst.h). After the
+* tree has changed below a node, or the node's value has been overwritten by
+* insert/insert_or_assign, it calls
+*     update(item, leftAugment, rightAugment)
+* on it, with the augmentations of its children (nullptr for a missing child),
+* bottom up from there to every node whose subtree has changed.
+*
+* Every augmentation says whether it is derived from the subtree at all in
+* a static const bool aggregates. If not, the tree skips the walk up.
+*/
+struct NoAugment
+{
+    static const bool aggregates = false;
+
+    template<typename Item>
+    void update(const Item&, const NoAugment*, const NoAugment*) { }
+};
+
 /**
 * A special kind of node for an AVL tree, which adds the balance as a data member, plus
 * other additional helper functions. You do NOT need to implement any functionality or
 * add additional data members or helper functions.
+*
+* With AVL_COMPACT_NODES defined, the balance has no member of its own: it is stored,
+* offset by 2, in the low bits of the parent link (see Node in bst.h), so a node is
+* exactly key + value + 3 pointers. Three bits are needed rather than two, since the
+* fix-up code briefly stores balances of -2 and +2, which is why the compact layout
+* requires 8-byte aligned nodes.
+*
+* The Augment base adds per-subtree data kept up to date by AVLTree; the
+* default one is empty and takes no space.
 */
-template <typename Key, typename Value>
-class AVLNode : public Node<Key, Value>
+template <typename Key, typename Value, typename Augment = NoAugment>
+class AVLNode : public Node<Key, Value>, public Augment
 {
 public:
     // Constructor/destructor.
-    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, Augment>* parent);
+    template<typename... Args>
+    explicit AVLNode(AVLNode<Key, Value, Augment>* parent, Args&&... itemArgs);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
+    void copyMetadata(const AVLNode<Key, Value, Augment>& other);
+
+    // Recomputes the augmentation from the children's.
+    void refreshAugment();
 
-    // Getters for parent, left, and right. These need to be redefined since they
-    // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
-    // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    // Getters for parent, left, and right. These hide the Node versions since they
+    // return pointers to AVLNodes - not plain Nodes. They are not virtual, so calls
+    // made through an AVLNode pointer are resolved at compile time. See the Node
+    // class in bst.h for more information.
+    AVLNode<Key, Value, Augment>* getParent() const;
+    AVLNode<Key, Value, Augment>* getLeft() const;
+    AVLNode<Key, Value, Augment>* getRight() const;
 
 protected:
+#ifdef AVL_COMPACT_NODES
+    static_assert(alignof(void*) >= 8, "compact AVL nodes need 3 free bits in the parent link");
+    static const int8_t BALANCE_OFFSET = 2;
+#else
     int8_t balance_;    // effectively a signed char
+#endif
 };
 
 /*
@@ -48,18 +103,35 @@ protected:
 /**
 * An explicit constructor to initialize the elements by calling the base class constructor
 */
-template<class Key, class Value>
-AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, Augment> *parent) :
+    Node<Key, Value>(key, value, parent)
+#ifndef AVL_COMPACT_NODES
+    , balance_(0)
+#endif
 {
+    setBalance(0);
+}
 
+/**
+* A constructor that builds the item in place (see the matching Node constructor).
+*/
+template<class Key, class Value, class Augment>
+template<typename... Args>
+AVLNode<Key, Value, Augment>::AVLNode(AVLNode<Key, Value, Augment> *parent, Args&&... itemArgs) :
+    Node<Key, Value>(parent, std::forward<Args>(itemArgs)...)
+#ifndef AVL_COMPACT_NODES
+    , balance_(0)
+#endif
+{
+    setBalance(0);
 }
 
 /**
 * A destructor which does nothing.
 */
-template<class Key, class Value>
-AVLNode<Key, Value>::~AVLNode()
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment>::~AVLNode()
 {
 
 }
@@ -67,56 +139,84 @@ AVLNode<Key, Value>::~AVLNode()
 /**
 * A getter for the balance of a AVLNode.
 */
-template<class Key, class Value>
-int8_t AVLNode<Key, Value>::getBalance() const
+template<class Key, class Value, class Augment>
+int8_t AVLNode<Key, Value, Augment>::getBalance() const
 {
+#ifdef AVL_COMPACT_NODES
+    return static_cast<int8_t>(static_cast<int8_t>(this->parent_ & this->PARENT_TAG_MASK) - BALANCE_OFFSET);
+#else
     return balance_;
+#endif
 }
 
 /**
 * A setter for the balance of a AVLNode.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::setBalance(int8_t balance)
+template<class Key, class Value, class Augment>
+void AVLNode<Key, Value, Augment>::setBalance(int8_t balance)
 {
+#ifdef AVL_COMPACT_NODES
+    this->parent_ = (this->parent_ & ~this->PARENT_TAG_MASK) | static_cast<std::uintptr_t>(balance + BALANCE_OFFSET);
+#else
     balance_ = balance;
+#endif
 }
 
 /**
 * Adds diff to the balance of a AVLNode.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::updateBalance(int8_t diff)
+template<class Key, class Value, class Augment>
+void AVLNode<Key, Value, Augment>::updateBalance(int8_t diff)
+{
+    setBalance(getBalance() + diff);
+}
+
+/**
+* Copies the balance and augmentation, for cloning a tree without rebalancing it.
+*/
+template<class Key, class Value, class Augment>
+void AVLNode<Key, Value, Augment>::copyMetadata(const AVLNode<Key, Value, Augment>& other)
 {
-    balance_ += diff;
+    setBalance(other.getBalance());
+    static_cast<Augment&>(*this) = static_cast<const Augment&>(other);
+}
+
+template<class Key, class Value, class Augment>
+void AVLNode<Key, Value, Augment>::refreshAugment()
+{
+    const AVLNode<Key, Value, Augment>* left = getLeft();
+    const AVLNode<Key, Value, Augment>* right = getRight();
+    Augment::update(this->getItem(),
+                    static_cast<const Augment*>(left),
+                    static_cast<const Augment*>(right));
 }
 
 /**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
+* Hides Node::getParent since a static_cast is necessary to make sure
 * that our node is a AVLNode.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment> *AVLNode<Key, Value, Augment>::getParent() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->parent_);
+    return static_cast<AVLNode<Key, Value, Augment>*>(Node<Key, Value>::getParent());
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment> *AVLNode<Key, Value, Augment>::getLeft() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->left_);
+    return static_cast<AVLNode<Key, Value, Augment>*>(this->left_);
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
+template<class Key, class Value, class Augment>
+AVLNode<Key, Value, Augment> *AVLNode<Key, Value, Augment>::getRight() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->right_);
+    return static_cast<AVLNode<Key, Value, Augment>*>(this->right_);
 }
 
 
@@ -127,68 +227,323 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+/**
+* An AVL tree. Augment is the node augmentation (see NoAugment), which the
+* tree keeps up to date through inserts, removes, rotations, bulk loads and
+* joins/splits.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = std::allocator<std::pair<const Key, Value> >,
+          class Augment = NoAugment>
+class AVLTree : public BinarySearchTree<Key, Value, Compare, Alloc>
 {
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    AVLTree();
+    explicit AVLTree(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit AVLTree(const Alloc& alloc);
+    template<typename InputIt>
+    AVLTree(InputIt first, InputIt last, const Compare& comp = Compare(), const Alloc& alloc = Alloc());
+    AVLTree(const AVLTree<Key, Value, Compare, Alloc, Augment>& other);
+    AVLTree(AVLTree<Key, Value, Compare, Alloc, Augment>&& other) noexcept;
+    virtual ~AVLTree();
+    AVLTree<Key, Value, Compare, Alloc, Augment>& operator=(const AVLTree<Key, Value, Compare, Alloc, Augment>& other);
+    AVLTree<Key, Value, Compare, Alloc, Augment>& operator=(AVLTree<Key, Value, Compare, Alloc, Augment>&& other)
+        noexcept(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value);
+
+    // Replaces the contents with [first, last), which must be sorted by key.
+    template<typename InputIt>
+    void bulkLoad(InputIt first, InputIt last, DuplicateKeys duplicates = DuplicateKeys::KEEP_LAST);
+
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator iterator;
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator const_iterator;
+
+    virtual std::pair<iterator, bool> insert (const std::pair<const Key, Value> &new_item); // TODO
+    virtual std::pair<iterator, bool> insert (std::pair<const Key, Value>&& new_item);
+    virtual iterator insert(const_iterator hint, const std::pair<const Key, Value>& new_item);
+    virtual iterator insert(const_iterator hint, std::pair<const Key, Value>&& new_item);
     virtual void remove(const Key& key);  // TODO
+
+    // Same as in BinarySearchTree, building AVLNodes.
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value);
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, V&& value);
+
+    // Join/split, and the set operations built on them. Nodes move between
+    // trees with equal allocators; the others' nodes are copied.
+    void join(const std::pair<const Key, Value>& item, AVLTree<Key, Value, Compare, Alloc, Augment>&& right);
+    AVLTree<Key, Value, Compare, Alloc, Augment> split(const Key& key);
+    void unionWith(AVLTree<Key, Value, Compare, Alloc, Augment>&& other);
+    void unionWith(const AVLTree<Key, Value, Compare, Alloc, Augment>& other);
+    void intersectWith(const AVLTree<Key, Value, Compare, Alloc, Augment>& other);
+    void difference(const AVLTree<Key, Value, Compare, Alloc, Augment>& other);
+
+    // An immutable, read-optimized copy of the current contents.
+    FrozenMap<Key, Value, Compare> freeze() const;
+    // Moves every node into new memory in van Emde Boas order, so that
+    // descents touch fewer cache lines. Invalidates all iterators.
+    void relayout();
+
 protected:
-    virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual void nodeSwap( AVLNode<Key, Value, Augment>* n1, AVLNode<Key, Value, Augment>* n2);
+    virtual void attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft);
+    virtual void eraseNode(Node<Key, Value>* node);
+    virtual void valueChanged(Node<Key, Value>* node);
+    virtual void destroyAllNodes();
+    virtual Node<Key, Value>* cloneNodes(const Node<Key, Value>* root);
 
     // Add helper functions here
-    void rotateLeft(AVLNode<Key, Value>* node);  //insert helper
-    void rotateRight(AVLNode<Key, Value>* node); //insert helper
-    void insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node);   //insert helper 
-
-    void removeFix(AVLNode<Key, Value>* node, int diff); //remove helper
+    void rotateLeft(AVLNode<Key, Value, Augment>* node);  //insert helper
+    void rotateRight(AVLNode<Key, Value, Augment>* node); //insert helper
+    void insertFix(AVLNode<Key, Value, Augment>* parent, AVLNode<Key, Value, Augment>* node);   //insert helper 
+
+    void removeFix(AVLNode<Key, Value, Augment>* node, int diff); //remove helper
+
+    // refreshes the augmentation of node and all its ancestors
+    static void refreshToRoot(AVLNode<Key, Value, Augment>* node);
+
+    // bulkLoad helpers
+    template<typename ForwardIt>
+    void bulkLoad(ForwardIt first, ForwardIt last, DuplicateKeys duplicates, std::forward_iterator_tag);
+    template<typename InputIt>
+    void bulkLoad(InputIt first, InputIt last, DuplicateKeys duplicates, std::input_iterator_tag);
+    template<typename ForwardIt>
+    AVLNode<Key, Value, Augment>* buildBalanced(ForwardIt& next, ForwardIt last, std::size_t count,
+                                       DuplicateKeys duplicates, int& height);
+
+    // join/split helpers, working on parentless subtrees and their heights
+    AVLNode<Key, Value, Augment>* adoptNodes(AVLTree<Key, Value, Compare, Alloc, Augment>& other);
+    static int subtreeHeight(const AVLNode<Key, Value, Augment>* root);
+    AVLNode<Key, Value, Augment>* joinSubtrees(AVLNode<Key, Value, Augment>* left, int leftHeight, AVLNode<Key, Value, Augment>* key,
+                                      AVLNode<Key, Value, Augment>* right, int rightHeight, int& height);
+    static void linkJoinNode(AVLNode<Key, Value, Augment>* node, AVLNode<Key, Value, Augment>* left, int leftHeight,
+                             AVLNode<Key, Value, Augment>* right, int rightHeight);
+    bool growFix(AVLNode<Key, Value, Augment>* node);
+    AVLNode<Key, Value, Augment>* splitSubtree(AVLNode<Key, Value, Augment>* root, int height, const Key& key,
+                                      AVLNode<Key, Value, Augment>*& left, int& leftHeight,
+                                      AVLNode<Key, Value, Augment>*& right, int& rightHeight);
+    static void detachChildren(AVLNode<Key, Value, Augment>* node, int height, AVLNode<Key, Value, Augment>*& left, int& leftHeight,
+                               AVLNode<Key, Value, Augment>*& right, int& rightHeight);
+    AVLNode<Key, Value, Augment>* splitLast(AVLNode<Key, Value, Augment>* root, int height, AVLNode<Key, Value, Augment>*& rest, int& restHeight);
+    AVLNode<Key, Value, Augment>* concatSubtrees(AVLNode<Key, Value, Augment>* left, int leftHeight,
+                                        AVLNode<Key, Value, Augment>* right, int rightHeight, int& height);
+    AVLNode<Key, Value, Augment>* unionSubtrees(AVLNode<Key, Value, Augment>* a, int aHeight, AVLNode<Key, Value, Augment>* b, int bHeight, int& height);
+    AVLNode<Key, Value, Augment>* intersectSubtrees(AVLNode<Key, Value, Augment>* a, int aHeight, const AVLNode<Key, Value, Augment>* b, int& height);
+    AVLNode<Key, Value, Augment>* differenceSubtrees(AVLNode<Key, Value, Augment>* a, int aHeight, const AVLNode<Key, Value, Augment>* b, int& height);
+
+    // relayout helpers
+    static void vanEmdeBoasOrder(AVLNode<Key, Value, Augment>* root, int height, std::vector<AVLNode<Key, Value, Augment>*>& order);
+    static void nodesAtDepth(AVLNode<Key, Value, Augment>* root, int depth, std::vector<AVLNode<Key, Value, Augment>*>& nodes);
 };
 
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment>::AVLTree()
+{
+
+}
+
+/*
+ * Constructs an empty tree whose nodes are allocated with a copy of alloc.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment>::AVLTree(const Alloc& alloc) : BinarySearchTree<Key, Value, Compare, Alloc>(alloc)
+{
+
+}
+
+/*
+ * Constructs an empty tree ordered by a copy of comp.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment>::AVLTree(const Compare& comp, const Alloc& alloc) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp, alloc)
+{
+
+}
+
+/*
+ * Constructs a tree holding the sorted range [first, last); see bulkLoad.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename InputIt>
+AVLTree<Key, Value, Compare, Alloc, Augment>::AVLTree(InputIt first, InputIt last, const Compare& comp, const Alloc& alloc) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp, alloc)
+{
+    bulkLoad(first, last);
+}
+
+/*
+ * AVLNodes must be deleted as AVLNodes (Node has no virtual destructor), so the
+ * tree is emptied here, while clear() still dispatches to AVLTree::destroyAllNodes.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment>::~AVLTree()
+{
+    this->clear();
+}
+
+/*
+ * Copy constructor: clones the AVLNodes of other, balances included.
+ * The BinarySearchTree copy constructor is not used, as it would clone
+ * plain Nodes (virtual calls do not reach AVLTree from a base constructor).
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment>::AVLTree(const AVLTree<Key, Value, Compare, Alloc, Augment>& other) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(other.comp_,
+        std::allocator_traits<Alloc>::select_on_container_copy_construction(other.alloc_))
+{
+    this->root_ = this->cloneSubtree(static_cast<const AVLNode<Key, Value, Augment>*>(other.root_));
+    this->refreshBounds();
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment>::AVLTree(AVLTree<Key, Value, Compare, Alloc, Augment>&& other) noexcept :
+    BinarySearchTree<Key, Value, Compare, Alloc>(std::move(other))
+{
+
+}
+
+/*
+ * Used by clear(): frees the nodes as AVLNodes.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::destroyAllNodes()
+{
+    this->destroySubtree(static_cast<AVLNode<Key, Value, Augment>*>(this->root_));
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment>& AVLTree<Key, Value, Compare, Alloc, Augment>::operator=(const AVLTree<Key, Value, Compare, Alloc, Augment>& other)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment>& AVLTree<Key, Value, Compare, Alloc, Augment>::operator=(AVLTree<Key, Value, Compare, Alloc, Augment>&& other)
+    noexcept(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(std::move(other));
+    return *this;
+}
+
+/*
+ * Used by the assignments: clones the nodes as AVLNodes.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+Node<Key, Value>* AVLTree<Key, Value, Compare, Alloc, Augment>::cloneNodes(const Node<Key, Value>* root)
+{
+    return this->cloneSubtree(static_cast<const AVLNode<Key, Value, Augment>*>(root));
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
+ * The key is looked up first, so no node is built for an existing key.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+std::pair<typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator, bool>
+AVLTree<Key, Value, Compare, Alloc, Augment>::insert(const std::pair<const Key, Value> &new_item)
 {
     // TODO
-    AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr);
-    if(this->root_ == nullptr)
-    {
-        this->root_ = newNode;
-        return;
-    }
+    return this->template insertOrAssignNode<AVLNode<Key, Value, Augment> >(new_item.first, new_item.second);
+}
 
-    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
-    AVLNode<Key, Value>* parent = nullptr;
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+std::pair<typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator, bool>
+AVLTree<Key, Value, Compare, Alloc, Augment>::insert(std::pair<const Key, Value>&& new_item)
+{
+    return this->template insertOrAssignNode<AVLNode<Key, Value, Augment> >(new_item.first, std::move(new_item.second));
+}
 
-    //find the correct spot to insert the new node - at leaf
-    while(current != nullptr)
-    {
-        parent = current;
-        //if new key is less than current key, go left
-        if(new_item.first < current->getKey())
-        {
-            current = current->getLeft();
-        }
-        //if new key is greater than current key, go right
-        else if(new_item.first > current->getKey())
-        {
-            current = current->getRight();
-        }
-        //if new key is equal to current, update
-        else
-        {
-            current->setValue(new_item.second);
-            delete newNode;
-            return;
-        }
-    }
+/*
+ * Hinted insertion, see BinarySearchTree::findFinger. Only the search is
+ * shortened: the rebalancing after it is the same as for any insert.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator
+AVLTree<Key, Value, Compare, Alloc, Augment>::insert(const_iterator hint, const std::pair<const Key, Value>& new_item)
+{
+    return this->template insertOrAssignNode<AVLNode<Key, Value, Augment> >(new_item.first, new_item.second,
+                                                                           this->findFinger(hint, new_item.first)).first;
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator
+AVLTree<Key, Value, Compare, Alloc, Augment>::insert(const_iterator hint, std::pair<const Key, Value>&& new_item)
+{
+    return this->template insertOrAssignNode<AVLNode<Key, Value, Augment> >(new_item.first, std::move(new_item.second),
+                                                                           this->findFinger(hint, new_item.first)).first;
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename... Args>
+std::pair<typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator, bool>
+AVLTree<Key, Value, Compare, Alloc, Augment>::emplace(Args&&... args)
+{
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::template EmplacesKeyValue<Args...> KeyValueArgs;
+    return this->template emplaceNode<AVLNode<Key, Value, Augment> >(KeyValueArgs(), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename... Args>
+std::pair<typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator, bool>
+AVLTree<Key, Value, Compare, Alloc, Augment>::try_emplace(const Key& key, Args&&... args)
+{
+    return this->template tryEmplaceNode<AVLNode<Key, Value, Augment> >(key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename... Args>
+std::pair<typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator, bool>
+AVLTree<Key, Value, Compare, Alloc, Augment>::try_emplace(Key&& key, Args&&... args)
+{
+    return this->template tryEmplaceNode<AVLNode<Key, Value, Augment> >(std::move(key), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename V>
+std::pair<typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator, bool>
+AVLTree<Key, Value, Compare, Alloc, Augment>::insert_or_assign(const Key& key, V&& value)
+{
+    return this->template insertOrAssignNode<AVLNode<Key, Value, Augment> >(key, std::forward<V>(value));
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename V>
+std::pair<typename AVLTree<Key, Value, Compare, Alloc, Augment>::iterator, bool>
+AVLTree<Key, Value, Compare, Alloc, Augment>::insert_or_assign(Key&& key, V&& value)
+{
+    return this->template insertOrAssignNode<AVLNode<Key, Value, Augment> >(std::move(key), std::forward<V>(value));
+}
+
+/*
+ * Links a new leaf into the slot found by findSlot, then updates the
+ * balance of its parent and fixes the tree up from there.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::attachNode(Node<Key, Value>* node, Node<Key, Value>* parentNode, bool isLeft)
+{
+    AVLNode<Key, Value, Augment>* newNode = static_cast<AVLNode<Key, Value, Augment>*>(node);
+    AVLNode<Key, Value, Augment>* parent = static_cast<AVLNode<Key, Value, Augment>*>(parentNode);
 
     //insert new node
     newNode->setParent(parent);
+    newNode->setBalance(0);
+    this->nodeAttached(newNode, parent, isLeft);
+    if(parent == nullptr)
+    {
+        this->root_ = newNode;
+        newNode->refreshAugment();
+        return;
+    }
     //if new key is less than parent key, insert left
-    if(new_item.first < parent->getKey())
+    if(isLeft)
     {
         parent->setLeft(newNode);
     }
@@ -197,9 +552,7 @@ void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
     {
         parent->setRight(newNode);
     }
-
-    //update balance factors
-    newNode->setBalance(0);
+    refreshToRoot(newNode);
 
     //fix balance factors
     if(parent->getBalance() == -1)
@@ -227,17 +580,857 @@ void AVLTree<Key, Value>::insert(const std::pair<const Key, Value> &new_item)
 }
 
 
+/*
+ * An augmentation may be derived from the values, so a new value is
+ * refreshed up to the root.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::valueChanged(Node<Key, Value>* node)
+{
+    refreshToRoot(static_cast<AVLNode<Key, Value, Augment>*>(node));
+}
+
+/*
+ * Builds a perfectly balanced tree from a range of key/value pairs sorted by
+ * Compare, in O(n) and without a single rotation: the nodes are created in
+ * key order, the middle one of every subrange becoming its root, and their
+ * balances are set from the subtree heights. Equal keys are handled as
+ * duplicates says. Unsorted input or a rejected duplicate throws
+ * std::invalid_argument before any node is built; either way, the tree
+ * keeps its old contents until the new ones are complete.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename InputIt>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::bulkLoad(InputIt first, InputIt last, DuplicateKeys duplicates)
+{
+    bulkLoad(first, last, duplicates, typename std::iterator_traits<InputIt>::iterator_category());
+}
+
+/*
+ * Single pass input is buffered first, since the tree shape depends on its length.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename InputIt>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::bulkLoad(InputIt first, InputIt last, DuplicateKeys duplicates, std::input_iterator_tag)
+{
+    std::vector<typename std::iterator_traits<InputIt>::value_type> buffer(first, last);
+    bulkLoad(std::make_move_iterator(buffer.begin()), std::make_move_iterator(buffer.end()),
+             duplicates, std::forward_iterator_tag());
+}
+
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename ForwardIt>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::bulkLoad(ForwardIt first, ForwardIt last, DuplicateKeys duplicates, std::forward_iterator_tag)
+{
+    //first pass: check the order and count the distinct keys
+    std::size_t count = 0;
+    for(ForwardIt prev = first, it = first; it != last; prev = it, ++it)
+    {
+        const int order = (it == first) ? -1 : compareKeys(this->comp_, (*prev).first, (*it).first);
+        if(order < 0)
+        {
+            ++count;
+        }
+        else if(order > 0)
+        {
+            throw std::invalid_argument("bulkLoad: keys are not sorted");
+        }
+        else if(duplicates == DuplicateKeys::REJECT)
+        {
+            throw std::invalid_argument("bulkLoad: duplicate key");
+        }
+    }
+
+    //second pass: build the new tree, then swap it in for the old one
+    int height;
+    ForwardIt next = first;
+    AVLNode<Key, Value, Augment>* root = buildBalanced(next, last, count, duplicates, height);
+    this->threadSubtree(root);
+    this->clear();
+    this->root_ = root;
+    this->refreshBounds();
+}
+
+/*
+ * Builds a balanced subtree from the next count distinct keys of the input
+ * and returns its root, with height set to its height. On failure,
+ * everything built so far is destroyed again.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+template<typename ForwardIt>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::buildBalanced(ForwardIt& next, ForwardIt last, std::size_t count,
+                                                                       DuplicateKeys duplicates, int& height)
+{
+    if(count == 0)
+    {
+        height = 0;
+        return nullptr;
+    }
+
+    //the left half gets the smaller share, so a subtree is never left heavy
+    const std::size_t leftCount = (count - 1) / 2;
+    int leftHeight;
+    AVLNode<Key, Value, Augment>* left = buildBalanced(next, last, leftCount, duplicates, leftHeight);
+
+    //take one item for this node, skipping over the rest of its run of equal keys
+    ForwardIt item = next;
+    for(++next; next != last && compareKeys(this->comp_, (*item).first, (*next).first) == 0; ++next)
+    {
+        if(duplicates == DuplicateKeys::KEEP_LAST)
+        {
+            item = next;
+        }
+    }
+
+    AVLNode<Key, Value, Augment>* node;
+    try
+    {
+        node = this->template createNode<AVLNode<Key, Value, Augment> >(nullptr, *item);
+    }
+    catch(...)
+    {
+        this->destroySubtree(left);
+        throw;
+    }
+    node->setLeft(left);
+    if(left != nullptr)
+    {
+        left->setParent(node);
+    }
+
+    int rightHeight;
+    AVLNode<Key, Value, Augment>* right;
+    try
+    {
+        right = buildBalanced(next, last, count - 1 - leftCount, duplicates, rightHeight);
+    }
+    catch(...)
+    {
+        this->destroySubtree(node);
+        throw;
+    }
+    node->setRight(right);
+    if(right != nullptr)
+    {
+        right->setParent(node);
+    }
+
+    node->setBalance(static_cast<int8_t>(rightHeight - leftHeight));
+    node->refreshAugment();
+    height = std::max(leftHeight, rightHeight) + 1;
+    return node;
+}
+
+/*
+ * Appends item and then all of right to this tree, leaving right empty.
+ * Every key of this tree must be less than item's key, and item's key less
+ * than every key of right, or std::invalid_argument is thrown. Runs in
+ * O(log n): the shorter tree is hung off the spine of the taller one and
+ * the tree is rebalanced from there. The nodes of right are adopted as they
+ * are when both trees use equal allocators; otherwise they are copied.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::join(const std::pair<const Key, Value>& item, AVLTree<Key, Value, Compare, Alloc, Augment>&& right)
+{
+    AVLNode<Key, Value, Augment>* largest = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    while(largest != nullptr && largest->getRight() != nullptr)
+    {
+        largest = largest->getRight();
+    }
+    const Node<Key, Value>* smallest = right.getSmallestNode();
+    if(&right == this ||
+       (largest != nullptr && compareKeys(this->comp_, largest->getKey(), item.first) >= 0) ||
+       (smallest != nullptr && compareKeys(this->comp_, item.first, smallest->getKey()) >= 0))
+    {
+        throw std::invalid_argument("join: keys are out of order");
+    }
+
+    AVLNode<Key, Value, Augment>* key = this->template createNode<AVLNode<Key, Value, Augment> >(nullptr, item);
+    AVLNode<Key, Value, Augment>* rightRoot;
+    try
+    {
+        rightRoot = adoptNodes(right);
+    }
+    catch(...)
+    {
+        this->destroyNode(key);
+        throw;
+    }
+
+    int height;
+    AVLNode<Key, Value, Augment>* left = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    this->joinThreads(left, key, rightRoot);
+    this->root_ = joinSubtrees(left, subtreeHeight(left), key, rightRoot, subtreeHeight(rightRoot), height);
+    this->refreshBounds();
+}
+
+/*
+ * Moves the entries with keys greater than or equal to key out of this tree
+ * and returns them as a new tree, in O(log n).
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLTree<Key, Value, Compare, Alloc, Augment> AVLTree<Key, Value, Compare, Alloc, Augment>::split(const Key& key)
+{
+    AVLNode<Key, Value, Augment>* root = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    AVLNode<Key, Value, Augment>* left;
+    AVLNode<Key, Value, Augment>* right;
+    int leftHeight, rightHeight;
+    AVLNode<Key, Value, Augment>* found = splitSubtree(root, subtreeHeight(root), key, left, leftHeight, right, rightHeight);
+    if(found != nullptr)
+    {
+        right = joinSubtrees(nullptr, 0, found, right, rightHeight, rightHeight);
+    }
+    this->root_ = left;
+    this->refreshBounds();
+    this->cutThreads(left, right);
+
+    AVLTree<Key, Value, Compare, Alloc, Augment> greater(this->comp_, this->alloc_);
+    greater.root_ = right;
+    greater.refreshBounds();
+    return greater;
+}
+
+/*
+ * Adds every entry of other; for a key in both trees, other's value wins.
+ * With n entries here and m in other (m <= n, or the other way around),
+ * this takes O(m log(n/m + 1)): other is walked top down, and this tree is
+ * split at each of its keys and joined back together around it. Only the
+ * paths that are split are touched, so a small delta costs little more
+ * than its own size, and two trees of equal size merge in linear time.
+ * With BST_THREADED_NODES, all set operations finish with an O(n) walk
+ * that relinks the threads.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::unionWith(AVLTree<Key, Value, Compare, Alloc, Augment>&& other)
+{
+    if(&other == this)
+    {
+        return;
+    }
+    AVLNode<Key, Value, Augment>* otherRoot = adoptNodes(other);
+    AVLNode<Key, Value, Augment>* root = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    int height;
+    this->root_ = unionSubtrees(root, subtreeHeight(root), otherRoot, subtreeHeight(otherRoot), height);
+    this->threadSubtree(this->root_);
+    this->refreshBounds();
+}
+
+/*
+ * Same as above, for a tree that has to stay as it is: its nodes are copied
+ * first, in O(m).
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::unionWith(const AVLTree<Key, Value, Compare, Alloc, Augment>& other)
+{
+    if(&other == this)
+    {
+        return;
+    }
+    AVLNode<Key, Value, Augment>* copy = this->cloneSubtree(static_cast<const AVLNode<Key, Value, Augment>*>(other.root_));
+    AVLNode<Key, Value, Augment>* root = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    int height;
+    this->root_ = unionSubtrees(root, subtreeHeight(root), copy, subtreeHeight(copy), height);
+    this->threadSubtree(this->root_);
+    this->refreshBounds();
+}
+
+/*
+ * Keeps only the keys that are also in other, with their values from this
+ * tree. Same bound as unionWith; other is not modified.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::intersectWith(const AVLTree<Key, Value, Compare, Alloc, Augment>& other)
+{
+    if(&other == this)
+    {
+        return;
+    }
+    AVLNode<Key, Value, Augment>* root = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    int height;
+    this->root_ = intersectSubtrees(root, subtreeHeight(root), static_cast<const AVLNode<Key, Value, Augment>*>(other.root_), height);
+    this->threadSubtree(this->root_);
+    this->refreshBounds();
+}
+
+/*
+ * Removes every key that is in other. Same bound as unionWith; other is
+ * not modified.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::difference(const AVLTree<Key, Value, Compare, Alloc, Augment>& other)
+{
+    if(&other == this)
+    {
+        this->clear();
+        return;
+    }
+    AVLNode<Key, Value, Augment>* root = static_cast<AVLNode<Key, Value, Augment>*>(this->root_);
+    int height;
+    this->root_ = differenceSubtrees(root, subtreeHeight(root), static_cast<const AVLNode<Key, Value, Augment>*>(other.root_), height);
+    this->threadSubtree(this->root_);
+    this->refreshBounds();
+}
+
+/*
+ * Copies the entries into a FrozenMap in O(n), for trees that are built once
+ * and then only read. The tree stays as it is; later changes to it do not
+ * show in the map.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+FrozenMap<Key, Value, Compare> AVLTree<Key, Value, Compare, Alloc, Augment>::freeze() const
+{
+    return FrozenMap<Key, Value, Compare>(this->begin(), this->end(), this->comp_);
+}
+
+/*
+ * Nodes allocated over a long run of inserts and removes end up scattered
+ * over the heap, and each level of a descent is a cache miss of its own.
+ * This allocates a fresh node for every entry, in van Emde Boas order: the
+ * top half of the levels first, laid out the same way recursively, then
+ * each subtree hanging below it, one after the other. Every subtree of
+ * height 2^k is then a contiguous run of nodes, and a descent touches
+ * O(log_B n) cache lines whatever the cache line size B, instead of
+ * O(log n). The old nodes are freed once the new ones are linked up.
+ *
+ * How contiguous the new nodes really are is up to the allocator; plain
+ * malloc, or a PoolAllocator, hand out a run of fresh memory to a burst of
+ * allocations like this one. Takes O(n log log n) time and, while it
+ * runs, memory for a second copy of the nodes. Entries are moved when that
+ * cannot throw; otherwise they are copied, and an exception leaves the
+ * tree as it was.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::relayout()
+{
+    typedef AVLNode<Key, Value, Augment> TreeNode;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<TreeNode> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeTraits;
+
+    TreeNode* root = static_cast<TreeNode*>(this->root_);
+    if(root == nullptr)
+    {
+        return;
+    }
+    std::vector<TreeNode*> order;
+    vanEmdeBoasOrder(root, subtreeHeight(root), order);
+
+    //allocate and fill every new node before the old ones are touched
+    NodeAlloc nodeAlloc(this->alloc_);
+    std::vector<TreeNode*> fresh;
+    fresh.reserve(order.size());
+    std::size_t built = 0;
+    try
+    {
+        for(std::size_t i = 0; i < order.size(); ++i)
+        {
+            fresh.push_back(NodeTraits::allocate(nodeAlloc, 1));
+        }
+        for(; built < order.size(); ++built)
+        {
+            NodeTraits::construct(nodeAlloc, fresh[built], static_cast<TreeNode*>(nullptr),
+                                  std::move_if_noexcept(order[built]->getItem()));
+            fresh[built]->copyMetadata(*order[built]);
+        }
+    }
+    catch(...)
+    {
+        for(std::size_t i = 0; i < fresh.size(); ++i)
+        {
+            if(i < built)
+            {
+                NodeTraits::destroy(nodeAlloc, fresh[i]);
+            }
+            NodeTraits::deallocate(nodeAlloc, fresh[i], 1);
+        }
+        throw;
+    }
+
+    //the parent link of each old node now forwards to its copy
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        order[i]->setParent(fresh[i]);
+    }
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        TreeNode* left = order[i]->getLeft();
+        TreeNode* right = order[i]->getRight();
+        if(left != nullptr)
+        {
+            fresh[i]->setLeft(left->getParent());
+            left->getParent()->setParent(fresh[i]);
+        }
+        if(right != nullptr)
+        {
+            fresh[i]->setRight(right->getParent());
+            right->getParent()->setParent(fresh[i]);
+        }
+    }
+    for(std::size_t i = 0; i < order.size(); ++i)
+    {
+        this->destroyNode(order[i]);
+    }
+
+    this->root_ = fresh[0];
+    this->threadSubtree(this->root_);
+    this->refreshBounds();
+}
+
+/*
+ * Appends the nodes of the top height levels of root's subtree in van Emde
+ * Boas order. height may exceed the height of the subtree.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::vanEmdeBoasOrder(AVLNode<Key, Value, Augment>* root, int height,
+                                                                   std::vector<AVLNode<Key, Value, Augment>*>& order)
+{
+    if(root == nullptr)
+    {
+        return;
+    }
+    if(height <= 2)
+    {
+        order.push_back(root);
+        if(height == 2)
+        {
+            if(root->getLeft() != nullptr)
+            {
+                order.push_back(root->getLeft());
+            }
+            if(root->getRight() != nullptr)
+            {
+                order.push_back(root->getRight());
+            }
+        }
+        return;
+    }
+    const int topHeight = height / 2;
+    vanEmdeBoasOrder(root, topHeight, order);
+    std::vector<AVLNode<Key, Value, Augment>*> bottoms;
+    nodesAtDepth(root, topHeight, bottoms);
+    for(std::size_t i = 0; i < bottoms.size(); ++i)
+    {
+        vanEmdeBoasOrder(bottoms[i], height - topHeight, order);
+    }
+}
+
+/*
+ * Appends the nodes depth levels below root, from left to right.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::nodesAtDepth(AVLNode<Key, Value, Augment>* root, int depth,
+                                                               std::vector<AVLNode<Key, Value, Augment>*>& nodes)
+{
+    if(root == nullptr)
+    {
+        return;
+    }
+    if(depth == 0)
+    {
+        nodes.push_back(root);
+        return;
+    }
+    nodesAtDepth(root->getLeft(), depth - 1, nodes);
+    nodesAtDepth(root->getRight(), depth - 1, nodes);
+}
+
+/*
+ * Takes the nodes of other, leaving it empty. They are used as they are when
+ * the two allocators are equal, and copied with this tree's allocator otherwise.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::adoptNodes(AVLTree<Key, Value, Compare, Alloc, Augment>& other)
+{
+    AVLNode<Key, Value, Augment>* root = static_cast<AVLNode<Key, Value, Augment>*>(other.root_);
+    if(!(this->alloc_ == other.alloc_))
+    {
+        root = this->cloneSubtree(static_cast<const AVLNode<Key, Value, Augment>*>(root));
+        other.clear();
+    }
+    other.root_ = nullptr;
+    other.refreshBounds();
+    return root;
+}
+
+/*
+ * The height of a subtree, found in O(log n) by following the taller child.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+int AVLTree<Key, Value, Compare, Alloc, Augment>::subtreeHeight(const AVLNode<Key, Value, Augment>* root)
+{
+    int height = 0;
+    while(root != nullptr)
+    {
+        ++height;
+        root = (root->getBalance() > 0) ? root->getRight() : root->getLeft();
+    }
+    return height;
+}
+
+/*
+ * Joins two subtrees with the detached node key, whose key lies between
+ * theirs. The subtree roots must have no parent; so does the returned root.
+ * height is set to the height of the result. Trees whose heights differ by
+ * at most one just become the children of key; otherwise key goes down the
+ * inner spine of the taller tree, costing O(|leftHeight - rightHeight|).
+ *
+ * Like the rotations, joining may overwrite root_ while it works on
+ * detached subtrees, so callers set root_ once they are done.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::joinSubtrees(AVLNode<Key, Value, Augment>* left, int leftHeight,
+    AVLNode<Key, Value, Augment>* key, AVLNode<Key, Value, Augment>* right, int rightHeight, int& height)
+{
+    if(leftHeight > rightHeight + 1)
+    {
+        //go down the right spine of the left tree to a subtree as tall as right (or one taller)
+        AVLNode<Key, Value, Augment>* parent = nullptr;
+        AVLNode<Key, Value, Augment>* spine = left;
+        int spineHeight = leftHeight;
+        while(spineHeight > rightHeight + 1)
+        {
+            spineHeight -= (spine->getBalance() < 0) ? 2 : 1;
+            parent = spine;
+            spine = spine->getRight();
+        }
+        linkJoinNode(key, spine, spineHeight, right, rightHeight);
+        key->setParent(parent);
+        parent->setRight(key);
+        refreshToRoot(parent);
+        height = leftHeight + (growFix(key) ? 1 : 0);
+        return (left->getParent() != nullptr) ? left->getParent() : left;
+    }
+    if(rightHeight > leftHeight + 1)
+    {
+        //mirror image: go down the left spine of the right tree
+        AVLNode<Key, Value, Augment>* parent = nullptr;
+        AVLNode<Key, Value, Augment>* spine = right;
+        int spineHeight = rightHeight;
+        while(spineHeight > leftHeight + 1)
+        {
+            spineHeight -= (spine->getBalance() > 0) ? 2 : 1;
+            parent = spine;
+            spine = spine->getLeft();
+        }
+        linkJoinNode(key, left, leftHeight, spine, spineHeight);
+        key->setParent(parent);
+        parent->setLeft(key);
+        refreshToRoot(parent);
+        height = rightHeight + (growFix(key) ? 1 : 0);
+        return (right->getParent() != nullptr) ? right->getParent() : right;
+    }
+    linkJoinNode(key, left, leftHeight, right, rightHeight);
+    key->setParent(nullptr);
+    height = std::max(leftHeight, rightHeight) + 1;
+    return key;
+}
+
+/*
+ * Makes left and right (of the given heights, differing by at most one)
+ * the children of node.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::linkJoinNode(AVLNode<Key, Value, Augment>* node, AVLNode<Key, Value, Augment>* left, int leftHeight,
+                                                       AVLNode<Key, Value, Augment>* right, int rightHeight)
+{
+    node->setLeft(left);
+    if(left != nullptr)
+    {
+        left->setParent(node);
+    }
+    node->setRight(right);
+    if(right != nullptr)
+    {
+        right->setParent(node);
+    }
+    node->setBalance(static_cast<int8_t>(rightHeight - leftHeight));
+    node->refreshAugment();
+}
+
+/*
+ * The subtree rooted at node has grown by one level: updates the balances
+ * above it, rotating where one reaches +/-2. Returns true if the growth
+ * reaches past the topmost ancestor.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+bool AVLTree<Key, Value, Compare, Alloc, Augment>::growFix(AVLNode<Key, Value, Augment>* node)
+{
+    AVLNode<Key, Value, Augment>* parent = node->getParent();
+    while(parent != nullptr)
+    {
+        parent->updateBalance((node == parent->getLeft()) ? -1 : 1);
+        const int8_t balance = parent->getBalance();
+        if(balance == 0)
+        {
+            return false;
+        }
+        if(balance == 2 || balance == -2)
+        {
+            const int8_t side = (balance > 0) ? 1 : -1;
+            if(node->getBalance() == -side)
+            {
+                //zig-zag: as in insertFix, the balances come from the grandchild
+                //read before rotating, since the rotations only get them right
+                //for a single rotation
+                AVLNode<Key, Value, Augment>* child = (side > 0) ? node->getLeft() : node->getRight();
+                const int8_t childBalance = child->getBalance();
+                if(side > 0)
+                {
+                    rotateRight(node);
+                    rotateLeft(parent);
+                }
+                else
+                {
+                    rotateLeft(node);
+                    rotateRight(parent);
+                }
+                parent->setBalance((childBalance == side) ? -side : 0);
+                node->setBalance((childBalance == -side) ? side : 0);
+                child->setBalance(0);
+                return false;
+            }
+            //zig-zig: the subtree is back to its old height unless the child was
+            //evenly balanced
+            if(side > 0)
+            {
+                rotateLeft(parent);
+            }
+            else
+            {
+                rotateRight(parent);
+            }
+            if(node->getBalance() == 0)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            node = parent;
+        }
+        parent = node->getParent();
+    }
+    return true;
+}
+
+/*
+ * Splits the subtree root (of the given height) at key: left and right get
+ * the keys below and above it, as parentless subtrees with their heights.
+ * Returns the node holding key, detached, or nullptr if there is none.
+ * Each level on the way down to key costs one join, for O(log n) overall.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::splitSubtree(AVLNode<Key, Value, Augment>* root, int height, const Key& key,
+    AVLNode<Key, Value, Augment>*& left, int& leftHeight, AVLNode<Key, Value, Augment>*& right, int& rightHeight)
+{
+    if(root == nullptr)
+    {
+        left = right = nullptr;
+        leftHeight = rightHeight = 0;
+        return nullptr;
+    }
+    AVLNode<Key, Value, Augment>* rootLeft;
+    AVLNode<Key, Value, Augment>* rootRight;
+    int rootLeftHeight, rootRightHeight;
+    detachChildren(root, height, rootLeft, rootLeftHeight, rootRight, rootRightHeight);
+
+    const int order = compareKeys(this->comp_, key, root->getKey());
+    if(order == 0)
+    {
+        left = rootLeft;
+        leftHeight = rootLeftHeight;
+        right = rootRight;
+        rightHeight = rootRightHeight;
+        return root;
+    }
+    AVLNode<Key, Value, Augment>* found;
+    if(order < 0)
+    {
+        AVLNode<Key, Value, Augment>* middle;
+        int middleHeight;
+        found = splitSubtree(rootLeft, rootLeftHeight, key, left, leftHeight, middle, middleHeight);
+        right = joinSubtrees(middle, middleHeight, root, rootRight, rootRightHeight, rightHeight);
+    }
+    else
+    {
+        AVLNode<Key, Value, Augment>* middle;
+        int middleHeight;
+        found = splitSubtree(rootRight, rootRightHeight, key, middle, middleHeight, right, rightHeight);
+        left = joinSubtrees(rootLeft, rootLeftHeight, root, middle, middleHeight, leftHeight);
+    }
+    return found;
+}
+
+/*
+ * Cuts both children off node, setting their heights from node's height and balance.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::detachChildren(AVLNode<Key, Value, Augment>* node, int height,
+    AVLNode<Key, Value, Augment>*& left, int& leftHeight, AVLNode<Key, Value, Augment>*& right, int& rightHeight)
+{
+    left = node->getLeft();
+    right = node->getRight();
+    leftHeight = height - ((node->getBalance() > 0) ? 2 : 1);
+    rightHeight = height - ((node->getBalance() < 0) ? 2 : 1);
+    if(left != nullptr)
+    {
+        left->setParent(nullptr);
+    }
+    if(right != nullptr)
+    {
+        right->setParent(nullptr);
+    }
+    node->setLeft(nullptr);
+    node->setRight(nullptr);
+    node->setParent(nullptr);
+}
+
+/*
+ * Removes the largest node from a non-empty subtree and returns it detached;
+ * rest gets the remaining subtree and its height.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::splitLast(AVLNode<Key, Value, Augment>* root, int height,
+    AVLNode<Key, Value, Augment>*& rest, int& restHeight)
+{
+    AVLNode<Key, Value, Augment>* left;
+    AVLNode<Key, Value, Augment>* right;
+    int leftHeight, rightHeight;
+    detachChildren(root, height, left, leftHeight, right, rightHeight);
+    if(right == nullptr)
+    {
+        rest = left;
+        restHeight = leftHeight;
+        return root;
+    }
+    AVLNode<Key, Value, Augment>* rightRest;
+    int rightRestHeight;
+    AVLNode<Key, Value, Augment>* last = splitLast(right, rightHeight, rightRest, rightRestHeight);
+    rest = joinSubtrees(left, leftHeight, root, rightRest, rightRestHeight, restHeight);
+    return last;
+}
+
+/*
+ * Joins two subtrees, all of whose keys are in order, without a node in
+ * between: the largest node of left takes that place.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::concatSubtrees(AVLNode<Key, Value, Augment>* left, int leftHeight,
+    AVLNode<Key, Value, Augment>* right, int rightHeight, int& height)
+{
+    if(left == nullptr)
+    {
+        height = rightHeight;
+        return right;
+    }
+    AVLNode<Key, Value, Augment>* rest;
+    int restHeight;
+    AVLNode<Key, Value, Augment>* last = splitLast(left, leftHeight, rest, restHeight);
+    return joinSubtrees(rest, restHeight, last, right, rightHeight, height);
+}
+
+/*
+ * Union of two parentless subtrees, taking over the nodes of both. For keys
+ * in both, the node of b is kept.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::unionSubtrees(AVLNode<Key, Value, Augment>* a, int aHeight,
+    AVLNode<Key, Value, Augment>* b, int bHeight, int& height)
+{
+    if(b == nullptr)
+    {
+        height = aHeight;
+        return a;
+    }
+    if(a == nullptr)
+    {
+        height = bHeight;
+        return b;
+    }
+    AVLNode<Key, Value, Augment>* bLeft;
+    AVLNode<Key, Value, Augment>* bRight;
+    int bLeftHeight, bRightHeight;
+    detachChildren(b, bHeight, bLeft, bLeftHeight, bRight, bRightHeight);
+
+    AVLNode<Key, Value, Augment>* aLeft;
+    AVLNode<Key, Value, Augment>* aRight;
+    int aLeftHeight, aRightHeight;
+    AVLNode<Key, Value, Augment>* found = splitSubtree(a, aHeight, b->getKey(), aLeft, aLeftHeight, aRight, aRightHeight);
+    if(found != nullptr)
+    {
+        this->destroyNode(found);
+    }
+
+    int leftHeight, rightHeight;
+    AVLNode<Key, Value, Augment>* left = unionSubtrees(aLeft, aLeftHeight, bLeft, bLeftHeight, leftHeight);
+    AVLNode<Key, Value, Augment>* right = unionSubtrees(aRight, aRightHeight, bRight, bRightHeight, rightHeight);
+    return joinSubtrees(left, leftHeight, b, right, rightHeight, height);
+}
+
+/*
+ * Keeps the nodes of the parentless subtree a whose keys are in the subtree b.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::intersectSubtrees(AVLNode<Key, Value, Augment>* a, int aHeight,
+    const AVLNode<Key, Value, Augment>* b, int& height)
+{
+    if(a == nullptr || b == nullptr)
+    {
+        this->destroySubtree(a);
+        height = 0;
+        return nullptr;
+    }
+    AVLNode<Key, Value, Augment>* aLeft;
+    AVLNode<Key, Value, Augment>* aRight;
+    int aLeftHeight, aRightHeight;
+    AVLNode<Key, Value, Augment>* found = splitSubtree(a, aHeight, b->getKey(), aLeft, aLeftHeight, aRight, aRightHeight);
+
+    int leftHeight, rightHeight;
+    AVLNode<Key, Value, Augment>* left = intersectSubtrees(aLeft, aLeftHeight, b->getLeft(), leftHeight);
+    AVLNode<Key, Value, Augment>* right = intersectSubtrees(aRight, aRightHeight, b->getRight(), rightHeight);
+    if(found != nullptr)
+    {
+        return joinSubtrees(left, leftHeight, found, right, rightHeight, height);
+    }
+    return concatSubtrees(left, leftHeight, right, rightHeight, height);
+}
+
+/*
+ * Drops the nodes of the parentless subtree a whose keys are in the subtree b.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+AVLNode<Key, Value, Augment>* AVLTree<Key, Value, Compare, Alloc, Augment>::differenceSubtrees(AVLNode<Key, Value, Augment>* a, int aHeight,
+    const AVLNode<Key, Value, Augment>* b, int& height)
+{
+    if(a == nullptr || b == nullptr)
+    {
+        height = aHeight;
+        return a;
+    }
+    AVLNode<Key, Value, Augment>* aLeft;
+    AVLNode<Key, Value, Augment>* aRight;
+    int aLeftHeight, aRightHeight;
+    AVLNode<Key, Value, Augment>* found = splitSubtree(a, aHeight, b->getKey(), aLeft, aLeftHeight, aRight, aRightHeight);
+    if(found != nullptr)
+    {
+        this->destroyNode(found);
+    }
+
+    int leftHeight, rightHeight;
+    AVLNode<Key, Value, Augment>* left = differenceSubtrees(aLeft, aLeftHeight, b->getLeft(), leftHeight);
+    AVLNode<Key, Value, Augment>* right = differenceSubtrees(aRight, aRightHeight, b->getRight(), rightHeight);
+    return concatSubtrees(left, leftHeight, right, rightHeight, height);
+}
 
 /*
  * helper function for insert - rotate left
  * Left Rotation is taking a right child, making it the parent and making the original parent the new left child 
  * balances right subtree when its too tall 
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node)
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::rotateLeft(AVLNode<Key, Value, Augment>* node)
 {
     //get right child - will become new root
-    AVLNode<Key, Value>* rightChild = node->getRight();
+    AVLNode<Key, Value, Augment>* rightChild = node->getRight();
 
     //sets right childs left subtree to node's right subtree
     node->setRight(rightChild->getLeft());
@@ -283,17 +1476,21 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node)
     //rightchilds new balance factor is updated by its original balance and the min height balance of nodes subtrees
     rightChild->setBalance(rightBalance - static_cast<int8_t>(1) + std::min(static_cast<int8_t>(0), nodeBalance));
 
+    //node is now below right child, so its augmentation is refreshed first
+    node->refreshAugment();
+    rightChild->refreshAugment();
+
 }
 
 /* 
  * helper function for insert - rotate right
  * Right Rotation is taking a left child, making it the parent and making the original parent the new right child
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node)
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::rotateRight(AVLNode<Key, Value, Augment>* node)
 {
     //get left child - will become new root
-    AVLNode<Key, Value>* leftChild = node->getLeft();
+    AVLNode<Key, Value, Augment>* leftChild = node->getLeft();
 
     //sets left childs right subtree to nodes left subtree
     node->setLeft(leftChild->getRight());
@@ -339,12 +1536,16 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node)
     //leftchilds new balance factor is updated by its original balance and the max height balance of nodes subtrees
     leftChild->setBalance(leftBalance + static_cast<int8_t>(1) + std::max(static_cast<int8_t>(0), nodeBalance));
 
+    //node is now below left child, so its augmentation is refreshed first
+    node->refreshAugment();
+    leftChild->refreshAugment();
+
 }
 
 
 //helper function for insert - fix the balance after rotations
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* node)
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::insertFix(AVLNode<Key, Value, Augment>* parent, AVLNode<Key, Value, Augment>* node)
 {
     //if p is null, return
     if(parent == nullptr || parent->getParent() == nullptr)
@@ -352,7 +1553,7 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
         return;
     }
 
-    AVLNode<Key, Value>* grandparent = parent->getParent();
+    AVLNode<Key, Value, Augment>* grandparent = parent->getParent();
 
 
     //Case 1 - parent is left child of grandparent (assume)
@@ -489,28 +1690,39 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::remove(const Key& key)
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::remove(const Key& key)
 {
     // TODO
-    AVLNode<Key, Value>* removeNode = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    Node<Key, Value>* found = this->internalFind(key);
 
     //if key is not in tree
-    if(removeNode == nullptr)
+    if(found == nullptr)
     {
         return;
     }
+    eraseNode(found);
+}
+
+/*
+ * Unlinks node as in a plain BST, then walks back up to rebalance.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::eraseNode(Node<Key, Value>* node)
+{
+    AVLNode<Key, Value, Augment>* removeNode = static_cast<AVLNode<Key, Value, Augment>*>(node);
 
     //case 1 - node has 2 children - swap with predecessor
     if(removeNode->getLeft() != nullptr && removeNode->getRight() != nullptr)
     {
-        AVLNode<Key, Value>* pred = dynamic_cast<AVLNode<Key, Value>*>(this->predecessor(dynamic_cast<Node<Key, Value>*>(removeNode)));
+        AVLNode<Key, Value, Augment>* pred = static_cast<AVLNode<Key, Value, Augment>*>(this->predecessor(removeNode));
         nodeSwap(removeNode, pred);
     }
+    this->nodeDetaching(removeNode);
 
     //case 2 - node has 1 or 0 children
-    AVLNode<Key, Value>* parent = removeNode->getParent();
-    AVLNode<Key, Value>* child = (removeNode->getLeft() != nullptr) ? removeNode->getLeft() : removeNode->getRight();
+    AVLNode<Key, Value, Augment>* parent = removeNode->getParent();
+    AVLNode<Key, Value, Augment>* child = (removeNode->getLeft() != nullptr) ? removeNode->getLeft() : removeNode->getRight();
     int diff = 0;
 
     //set diff based on child that is being removed
@@ -550,10 +1762,11 @@ void AVLTree<Key, Value>::remove(const Key& key)
     }
 
     //delete node
-    delete removeNode;
+    this->destroyNode(removeNode);
 
     if(parent != nullptr)
     {
+        refreshToRoot(parent);
         removeFix(parent, diff);
     }
 
@@ -564,8 +1777,8 @@ void AVLTree<Key, Value>::remove(const Key& key)
 * helper function for remove - fix the balance after rotations
 * ndiff is the difference in height of the node's subtree after the node is removed
 */
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::removeFix(AVLNode<Key, Value, Augment>* node, int diff)
 {
     //if p is null
     if(node == nullptr)
@@ -573,7 +1786,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
         return;
     }
 
-    AVLNode<Key, Value>* parent = node->getParent();
+    AVLNode<Key, Value, Augment>* parent = node->getParent();
 
     int ndiff = 0;
     if(parent != nullptr)
@@ -590,7 +1803,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
         //Case 1 - balance becomes -2
         if(newBalance == -2)
         {
-            AVLNode<Key, Value>* c = node->getLeft();
+            AVLNode<Key, Value, Augment>* c = node->getLeft();
 
             //subcase 1a - Zig-Zig (left-left)
             if(c != nullptr && c->getBalance() == -1)
@@ -616,7 +1829,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
             //subcase 1c - Zig-Zag (left-right)
             else if(c != nullptr && c->getBalance() == 1)
             {
-                AVLNode<Key, Value>* g = c->getRight();
+                AVLNode<Key, Value, Augment>* g = c->getRight();
 
                 rotateLeft(c);
                 rotateRight(node);
@@ -679,7 +1892,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
         //Case 1 - balance becomes 2
         if(newBalance == 2)
         {
-            AVLNode<Key, Value>* c = node->getRight();
+            AVLNode<Key, Value, Augment>* c = node->getRight();
 
             //subcase 1a - Zig-Zig (right-right)
             if(c != nullptr && c->getBalance() == 1)
@@ -705,7 +1918,7 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
             //subcase 1c - Zig-Zag (right-left)
             else if(c != nullptr && c->getBalance() == -1)
             {
-                AVLNode<Key, Value>* g = c->getLeft();
+                AVLNode<Key, Value, Augment>* g = c->getLeft();
 
                 rotateRight(c);
                 rotateLeft(node);
@@ -762,13 +1975,33 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* node, int diff)
 
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::nodeSwap( AVLNode<Key, Value, Augment>* n1, AVLNode<Key, Value, Augment>* n2)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    BinarySearchTree<Key, Value, Compare, Alloc>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
+
+    //like the balance, the augmentation belongs to the position in the tree
+    std::swap(static_cast<Augment&>(*n1), static_cast<Augment&>(*n2));
+}
+
+/*
+ * Walks up from node after a change below it. Skipped entirely for an
+ * augmentation that does not aggregate, which has nothing to refresh.
+ */
+template<class Key, class Value, class Compare, class Alloc, class Augment>
+void AVLTree<Key, Value, Compare, Alloc, Augment>::refreshToRoot(AVLNode<Key, Value, Augment>* node)
+{
+    if(!Augment::aggregates)
+    {
+        return;
+    }
+    for(; node != nullptr; node = node->getParent())
+    {
+        node->refreshAugment();
+    }
 }
 
 
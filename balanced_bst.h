@@ -0,0 +1,862 @@
+#ifndef BALANCED_BST_H
+#define BALANCED_BST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include "bst.h"
+#include "avlbst.h"
+
+/**
+* A node of a BalancedBST: a plain Node plus one small number, its rank,
+* whose meaning is up to the balancing policy (a colour, a rank, a priority).
+*/
+template <typename Key, typename Value, typename Rank>
+class BalancedNode : public Node<Key, Value>
+{
+public:
+    BalancedNode(const Key& key, const Value& value, BalancedNode<Key, Value, Rank>* parent);
+    template<typename... Args>
+    explicit BalancedNode(BalancedNode<Key, Value, Rank>* parent, Args&&... itemArgs);
+
+    Rank getRank() const;
+    void setRank(Rank rank);
+    void copyMetadata(const BalancedNode<Key, Value, Rank>& other);
+
+    // Hide the Node versions, as in AVLNode.
+    BalancedNode<Key, Value, Rank>* getParent() const;
+    BalancedNode<Key, Value, Rank>* getLeft() const;
+    BalancedNode<Key, Value, Rank>* getRight() const;
+
+protected:
+    Rank rank_;
+};
+
+template<class Key, class Value, class Rank>
+BalancedNode<Key, Value, Rank>::BalancedNode(const Key& key, const Value& value, BalancedNode<Key, Value, Rank>* parent) :
+    Node<Key, Value>(key, value, parent), rank_()
+{
+
+}
+
+template<class Key, class Value, class Rank>
+template<typename... Args>
+BalancedNode<Key, Value, Rank>::BalancedNode(BalancedNode<Key, Value, Rank>* parent, Args&&... itemArgs) :
+    Node<Key, Value>(parent, std::forward<Args>(itemArgs)...), rank_()
+{
+
+}
+
+template<class Key, class Value, class Rank>
+Rank BalancedNode<Key, Value, Rank>::getRank() const
+{
+    return rank_;
+}
+
+template<class Key, class Value, class Rank>
+void BalancedNode<Key, Value, Rank>::setRank(Rank rank)
+{
+    rank_ = rank;
+}
+
+template<class Key, class Value, class Rank>
+void BalancedNode<Key, Value, Rank>::copyMetadata(const BalancedNode<Key, Value, Rank>& other)
+{
+    rank_ = other.rank_;
+}
+
+template<class Key, class Value, class Rank>
+BalancedNode<Key, Value, Rank>* BalancedNode<Key, Value, Rank>::getParent() const
+{
+    return static_cast<BalancedNode<Key, Value, Rank>*>(Node<Key, Value>::getParent());
+}
+
+template<class Key, class Value, class Rank>
+BalancedNode<Key, Value, Rank>* BalancedNode<Key, Value, Rank>::getLeft() const
+{
+    return static_cast<BalancedNode<Key, Value, Rank>*>(this->left_);
+}
+
+template<class Key, class Value, class Rank>
+BalancedNode<Key, Value, Rank>* BalancedNode<Key, Value, Rank>::getRight() const
+{
+    return static_cast<BalancedNode<Key, Value, Rank>*>(this->right_);
+}
+
+template <class Key, class Value, class Policy, class Compare, class Alloc>
+class BalancedBST;
+
+/**
+* Balancing policies, to be picked per table with BalancedTree below.
+*
+* AVLBalance is AVLTree itself: the strictest balance (height < 1.44 log n),
+* so the fastest lookups, but a remove may rotate at every level of its path.
+*
+* The others are rules for a BalancedBST. Such a policy has a Rank type,
+* kept in every node, and restores its invariant after every change:
+*     inserted(tree, node)       node has just been linked in as a leaf
+*     prepareRemove(tree, node)  leaves node with at most one child
+*     removed(tree, parent, child, wasLeft, rank)
+*                                a node with rank rank, which was the left
+*                                (wasLeft) or right child of parent, has been
+*                                replaced by its only child, or nullptr
+* using the tree's rotateLeft/rotateRight and swapWithPredecessor, which keep
+* every rank with its node, respectively with its position in the tree.
+*/
+struct AVLBalance
+{
+    template<class Key, class Value, class Compare, class Alloc>
+    using Tree = AVLTree<Key, Value, Compare, Alloc>;
+};
+
+/**
+* Red-black trees: height < 2 log n, at most 2 rotations per insert and 3 per
+* remove, though recolouring may still walk up the whole path.
+*/
+struct RedBlackBalance
+{
+    typedef std::uint8_t Rank;
+    enum Colour { RED, BLACK };
+
+    template<class Key, class Value, class Compare, class Alloc>
+    using Tree = BalancedBST<Key, Value, RedBlackBalance, Compare, Alloc>;
+
+    template<typename NodeType>
+    static bool isRed(const NodeType* node)
+    {
+        return node != nullptr && node->getRank() == RED;
+    }
+
+    template<typename BST, typename NodeType>
+    void inserted(BST& tree, NodeType* node)
+    {
+        node->setRank(RED);
+        NodeType* parent = node->getParent();
+        while(isRed(parent))
+        {
+            //a red node is never the root, so there is a grandparent
+            NodeType* grandparent = parent->getParent();
+            NodeType* uncle = (parent == grandparent->getLeft()) ? grandparent->getRight() : grandparent->getLeft();
+            //red uncle - recolour and go on two levels up
+            if(isRed(uncle))
+            {
+                parent->setRank(BLACK);
+                uncle->setRank(BLACK);
+                grandparent->setRank(RED);
+                node = grandparent;
+                parent = node->getParent();
+                continue;
+            }
+            //black uncle - one or two rotations end it
+            if(parent == grandparent->getLeft())
+            {
+                if(node == parent->getRight())
+                {
+                    tree.rotateLeft(parent);
+                    parent = node;
+                }
+                tree.rotateRight(grandparent);
+            }
+            else
+            {
+                if(node == parent->getLeft())
+                {
+                    tree.rotateRight(parent);
+                    parent = node;
+                }
+                tree.rotateLeft(grandparent);
+            }
+            parent->setRank(BLACK);
+            grandparent->setRank(RED);
+            return;
+        }
+        if(parent == nullptr)
+        {
+            node->setRank(BLACK);
+        }
+    }
+
+    template<typename BST, typename NodeType>
+    void prepareRemove(BST& tree, NodeType* node)
+    {
+        if(node->getLeft() != nullptr && node->getRight() != nullptr)
+        {
+            tree.swapWithPredecessor(node);
+        }
+    }
+
+    template<typename BST, typename NodeType>
+    void removed(BST& tree, NodeType* parent, NodeType* child, bool wasLeft, Rank colour)
+    {
+        if(colour == RED)
+        {
+            return;
+        }
+        if(isRed(child))
+        {
+            child->setRank(BLACK);
+            return;
+        }
+        //child is one black short, and so are all paths through it
+        bool isLeft = wasLeft;
+        while(parent != nullptr)
+        {
+            //the sibling has a black height of at least 1, so it exists
+            NodeType* sibling = isLeft ? parent->getRight() : parent->getLeft();
+            if(isRed(sibling))
+            {
+                sibling->setRank(BLACK);
+                parent->setRank(RED);
+                if(isLeft)
+                {
+                    tree.rotateLeft(parent);
+                }
+                else
+                {
+                    tree.rotateRight(parent);
+                }
+                sibling = isLeft ? parent->getRight() : parent->getLeft();
+            }
+            NodeType* near = isLeft ? sibling->getLeft() : sibling->getRight();
+            NodeType* far = isLeft ? sibling->getRight() : sibling->getLeft();
+            //both nephews black - take one black from the sibling's side as well
+            if(!isRed(near) && !isRed(far))
+            {
+                sibling->setRank(RED);
+                if(isRed(parent))
+                {
+                    parent->setRank(BLACK);
+                    return;
+                }
+                child = parent;
+                parent = child->getParent();
+                isLeft = (parent != nullptr && child == parent->getLeft());
+                continue;
+            }
+            //a red nephew - at most two more rotations end it
+            if(!isRed(far))
+            {
+                near->setRank(BLACK);
+                sibling->setRank(RED);
+                if(isLeft)
+                {
+                    tree.rotateRight(sibling);
+                }
+                else
+                {
+                    tree.rotateLeft(sibling);
+                }
+                far = sibling;
+                sibling = near;
+            }
+            sibling->setRank(parent->getRank());
+            parent->setRank(BLACK);
+            far->setRank(BLACK);
+            if(isLeft)
+            {
+                tree.rotateLeft(parent);
+            }
+            else
+            {
+                tree.rotateRight(parent);
+            }
+            return;
+        }
+    }
+};
+
+/**
+* Weak AVL trees (Haeupler, Sen and Tarjan): every node has a rank, a child's
+* rank is 1 or 2 less than its parent's (a missing child counting as -1), and
+* leaves have rank 0. Built by inserts only, a WAVL tree is an AVL tree;
+* removes only ever loosen it, to height < 2 log n. An insert rotates at most
+* twice, and so does a remove, which is the point of it for remove-heavy use.
+*/
+struct WAVLBalance
+{
+    typedef std::int8_t Rank;
+
+    template<class Key, class Value, class Compare, class Alloc>
+    using Tree = BalancedBST<Key, Value, WAVLBalance, Compare, Alloc>;
+
+    template<typename NodeType>
+    static int rankOf(const NodeType* node)
+    {
+        return (node != nullptr) ? node->getRank() : -1;
+    }
+
+    template<typename NodeType>
+    static void promote(NodeType* node, int by = 1)
+    {
+        node->setRank(static_cast<Rank>(node->getRank() + by));
+    }
+
+    template<typename BST, typename NodeType>
+    void inserted(BST& tree, NodeType* node)
+    {
+        node->setRank(0);
+        NodeType* parent = node->getParent();
+        //while node is a 0-child of parent
+        while(parent != nullptr && rankOf(parent) == rankOf(node))
+        {
+            const bool isLeft = (node == parent->getLeft());
+            NodeType* sibling = isLeft ? parent->getRight() : parent->getLeft();
+            //case 1 - the sibling is a 1-child: promote the parent and go on up
+            if(rankOf(parent) - rankOf(sibling) == 1)
+            {
+                promote(parent);
+                node = parent;
+                parent = node->getParent();
+                continue;
+            }
+            //case 2 - the sibling is a 2-child: one or two rotations end it
+            NodeType* inner = isLeft ? node->getRight() : node->getLeft();
+            if(rankOf(node) - rankOf(inner) == 2)
+            {
+                if(isLeft)
+                {
+                    tree.rotateRight(parent);
+                }
+                else
+                {
+                    tree.rotateLeft(parent);
+                }
+                promote(parent, -1);
+            }
+            else
+            {
+                if(isLeft)
+                {
+                    tree.rotateLeft(node);
+                    tree.rotateRight(parent);
+                }
+                else
+                {
+                    tree.rotateRight(node);
+                    tree.rotateLeft(parent);
+                }
+                promote(inner);
+                promote(node, -1);
+                promote(parent, -1);
+            }
+            return;
+        }
+    }
+
+    template<typename BST, typename NodeType>
+    void prepareRemove(BST& tree, NodeType* node)
+    {
+        if(node->getLeft() != nullptr && node->getRight() != nullptr)
+        {
+            tree.swapWithPredecessor(node);
+        }
+    }
+
+    template<typename BST, typename NodeType>
+    void removed(BST& tree, NodeType* parent, NodeType* child, bool wasLeft, Rank)
+    {
+        if(parent == nullptr)
+        {
+            return;
+        }
+        bool isLeft = wasLeft;
+        //a leaf of rank 1 (a 2,2-leaf) is demoted, which may make it a 3-child
+        if(parent->getLeft() == nullptr && parent->getRight() == nullptr && parent->getRank() == 1)
+        {
+            promote(parent, -1);
+            child = parent;
+            parent = child->getParent();
+            isLeft = (parent != nullptr && child == parent->getLeft());
+        }
+        //while child is a 3-child of parent
+        while(parent != nullptr && rankOf(parent) - rankOf(child) == 3)
+        {
+            //parent has rank 2 or more, so the sibling exists
+            NodeType* sibling = isLeft ? parent->getRight() : parent->getLeft();
+            NodeType* near = isLeft ? sibling->getLeft() : sibling->getRight();
+            NodeType* far = isLeft ? sibling->getRight() : sibling->getLeft();
+            //case 1 - the sibling is a 2-child, or a 2,2 1-child: demote and go on up
+            if(rankOf(parent) - rankOf(sibling) == 2)
+            {
+                promote(parent, -1);
+            }
+            else if(rankOf(sibling) - rankOf(near) == 2 && rankOf(sibling) - rankOf(far) == 2)
+            {
+                promote(parent, -1);
+                promote(sibling, -1);
+            }
+            //case 2 - the far nephew is a 1-child: a single rotation ends it
+            else if(rankOf(sibling) - rankOf(far) == 1)
+            {
+                if(isLeft)
+                {
+                    tree.rotateLeft(parent);
+                }
+                else
+                {
+                    tree.rotateRight(parent);
+                }
+                promote(sibling);
+                promote(parent, -1);
+                //parent would be a 2,2-leaf
+                if(parent->getLeft() == nullptr && parent->getRight() == nullptr)
+                {
+                    promote(parent, -1);
+                }
+                return;
+            }
+            //case 3 - only the near nephew is a 1-child: a double rotation ends it
+            else
+            {
+                if(isLeft)
+                {
+                    tree.rotateRight(sibling);
+                    tree.rotateLeft(parent);
+                }
+                else
+                {
+                    tree.rotateLeft(sibling);
+                    tree.rotateRight(parent);
+                }
+                promote(near, 2);
+                promote(sibling, -1);
+                promote(parent, -2);
+                return;
+            }
+            child = parent;
+            parent = child->getParent();
+            isLeft = (parent != nullptr && child == parent->getLeft());
+        }
+    }
+};
+
+/**
+* Treaps: every node gets a random priority, and the tree is kept a heap on
+* them, so its shape is that of a random BST whatever the order of the keys:
+* expected height about 3 log n, with no guarantee. An insert rotates the new
+* leaf up, 2 times on average; a remove rotates its node down to a leaf first.
+* The priorities come from a per-tree splitmix64 sequence, seeded from the
+* policy's address, so that different trees get different shapes.
+*/
+struct TreapBalance
+{
+    typedef std::uint32_t Rank;
+
+    template<class Key, class Value, class Compare, class Alloc>
+    using Tree = BalancedBST<Key, Value, TreapBalance, Compare, Alloc>;
+
+    TreapBalance() : state_(reinterpret_cast<std::uintptr_t>(this))
+    {
+
+    }
+
+    Rank nextPriority()
+    {
+        std::uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return static_cast<Rank>((z ^ (z >> 31)) >> 32);
+    }
+
+    template<typename BST, typename NodeType>
+    void inserted(BST& tree, NodeType* node)
+    {
+        node->setRank(nextPriority());
+        NodeType* parent = node->getParent();
+        while(parent != nullptr && parent->getRank() < node->getRank())
+        {
+            if(node == parent->getLeft())
+            {
+                tree.rotateRight(parent);
+            }
+            else
+            {
+                tree.rotateLeft(parent);
+            }
+            parent = node->getParent();
+        }
+    }
+
+    template<typename BST, typename NodeType>
+    void prepareRemove(BST& tree, NodeType* node)
+    {
+        //rotate the child with the higher priority above node
+        while(node->getLeft() != nullptr && node->getRight() != nullptr)
+        {
+            if(node->getLeft()->getRank() > node->getRight()->getRank())
+            {
+                tree.rotateRight(node);
+            }
+            else
+            {
+                tree.rotateLeft(node);
+            }
+        }
+    }
+
+    template<typename BST, typename NodeType>
+    void removed(BST&, NodeType*, NodeType*, bool, Rank)
+    {
+
+    }
+
+    std::uint64_t state_;
+};
+
+/**
+* A binary search tree balanced by Policy, one of the BalancedBST policies
+* above. It has the BinarySearchTree interface, like AVLTree, but none of
+* AVLTree's extras (bulk loading, join/split, freeze, relayout).
+*/
+template <class Key, class Value, class Policy, class Compare = std::less<Key>,
+          class Alloc = std::allocator<std::pair<const Key, Value> > >
+class BalancedBST : public BinarySearchTree<Key, Value, Compare, Alloc>
+{
+public:
+    BalancedBST();
+    explicit BalancedBST(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit BalancedBST(const Alloc& alloc);
+    // Inserts [first, last), which need not be sorted.
+    template<typename InputIt>
+    BalancedBST(InputIt first, InputIt last, const Compare& comp = Compare(), const Alloc& alloc = Alloc());
+    BalancedBST(const BalancedBST<Key, Value, Policy, Compare, Alloc>& other);
+    BalancedBST(BalancedBST<Key, Value, Policy, Compare, Alloc>&& other) noexcept;
+    virtual ~BalancedBST();
+    BalancedBST<Key, Value, Policy, Compare, Alloc>& operator=(const BalancedBST<Key, Value, Policy, Compare, Alloc>& other);
+    BalancedBST<Key, Value, Policy, Compare, Alloc>& operator=(BalancedBST<Key, Value, Policy, Compare, Alloc>&& other)
+        noexcept(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value);
+
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator iterator;
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator const_iterator;
+
+    virtual std::pair<iterator, bool> insert(const std::pair<const Key, Value>& new_item);
+    virtual std::pair<iterator, bool> insert(std::pair<const Key, Value>&& new_item);
+    virtual iterator insert(const_iterator hint, const std::pair<const Key, Value>& new_item);
+    virtual iterator insert(const_iterator hint, std::pair<const Key, Value>&& new_item);
+
+    // Same as in BinarySearchTree, building BalancedNodes.
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value);
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, V&& value);
+
+protected:
+    friend Policy;
+    typedef BalancedNode<Key, Value, typename Policy::Rank> NodeType;
+
+    virtual void nodeSwap(NodeType* n1, NodeType* n2);
+    virtual void attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft);
+    virtual void eraseNode(Node<Key, Value>* node);
+    virtual void destroyAllNodes();
+    virtual Node<Key, Value>* cloneNodes(const Node<Key, Value>* root);
+
+    // for the policy: rotations keep the ranks with their nodes, while
+    // swapWithPredecessor leaves them with their positions
+    void rotateLeft(NodeType* node);
+    void rotateRight(NodeType* node);
+    void swapWithPredecessor(NodeType* node);
+
+    Policy policy_;
+};
+
+/**
+* A tree of the given balancing policy, e.g.
+*     BalancedTree<int, std::string, WAVLBalance> table;
+* See "./bst-bench policies" for how they compare.
+*/
+template <class Key, class Value, class Policy, class Compare = std::less<Key>,
+          class Alloc = std::allocator<std::pair<const Key, Value> > >
+using BalancedTree = typename Policy::template Tree<Key, Value, Compare, Alloc>;
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::BalancedBST()
+{
+
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::BalancedBST(const Compare& comp, const Alloc& alloc) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp, alloc)
+{
+
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::BalancedBST(const Alloc& alloc) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(alloc)
+{
+
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+template<typename InputIt>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::BalancedBST(InputIt first, InputIt last, const Compare& comp, const Alloc& alloc) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp, alloc)
+{
+    for(; first != last; ++first)
+    {
+        insert(*first);
+    }
+}
+
+/*
+ * Clones the nodes of other, ranks included; see the AVLTree copy constructor.
+ */
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::BalancedBST(const BalancedBST<Key, Value, Policy, Compare, Alloc>& other) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(other.comp_,
+        std::allocator_traits<Alloc>::select_on_container_copy_construction(other.alloc_))
+{
+    this->root_ = this->cloneSubtree(static_cast<const NodeType*>(other.root_));
+    this->refreshBounds();
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::BalancedBST(BalancedBST<Key, Value, Policy, Compare, Alloc>&& other) noexcept :
+    BinarySearchTree<Key, Value, Compare, Alloc>(std::move(other))
+{
+
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::~BalancedBST()
+{
+    this->clear();
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+BalancedBST<Key, Value, Policy, Compare, Alloc>&
+BalancedBST<Key, Value, Policy, Compare, Alloc>::operator=(const BalancedBST<Key, Value, Policy, Compare, Alloc>& other)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+BalancedBST<Key, Value, Policy, Compare, Alloc>&
+BalancedBST<Key, Value, Policy, Compare, Alloc>::operator=(BalancedBST<Key, Value, Policy, Compare, Alloc>&& other)
+    noexcept(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::operator=(std::move(other));
+    return *this;
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+void BalancedBST<Key, Value, Policy, Compare, Alloc>::destroyAllNodes()
+{
+    this->destroySubtree(static_cast<NodeType*>(this->root_));
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+Node<Key, Value>* BalancedBST<Key, Value, Policy, Compare, Alloc>::cloneNodes(const Node<Key, Value>* root)
+{
+    return this->cloneSubtree(static_cast<const NodeType*>(root));
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+std::pair<typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator, bool>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::insert(const std::pair<const Key, Value>& new_item)
+{
+    return this->template insertOrAssignNode<NodeType>(new_item.first, new_item.second);
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+std::pair<typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator, bool>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::insert(std::pair<const Key, Value>&& new_item)
+{
+    return this->template insertOrAssignNode<NodeType>(new_item.first, std::move(new_item.second));
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator
+BalancedBST<Key, Value, Policy, Compare, Alloc>::insert(const_iterator hint, const std::pair<const Key, Value>& new_item)
+{
+    return this->template insertOrAssignNode<NodeType>(new_item.first, new_item.second,
+                                                       this->findFinger(hint, new_item.first)).first;
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator
+BalancedBST<Key, Value, Policy, Compare, Alloc>::insert(const_iterator hint, std::pair<const Key, Value>&& new_item)
+{
+    return this->template insertOrAssignNode<NodeType>(new_item.first, std::move(new_item.second),
+                                                       this->findFinger(hint, new_item.first)).first;
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator, bool>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::emplace(Args&&... args)
+{
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::template EmplacesKeyValue<Args...> KeyValueArgs;
+    return this->template emplaceNode<NodeType>(KeyValueArgs(), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator, bool>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::try_emplace(const Key& key, Args&&... args)
+{
+    return this->template tryEmplaceNode<NodeType>(key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator, bool>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::try_emplace(Key&& key, Args&&... args)
+{
+    return this->template tryEmplaceNode<NodeType>(std::move(key), std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+template<typename V>
+std::pair<typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator, bool>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::insert_or_assign(const Key& key, V&& value)
+{
+    return this->template insertOrAssignNode<NodeType>(key, std::forward<V>(value));
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+template<typename V>
+std::pair<typename BalancedBST<Key, Value, Policy, Compare, Alloc>::iterator, bool>
+BalancedBST<Key, Value, Policy, Compare, Alloc>::insert_or_assign(Key&& key, V&& value)
+{
+    return this->template insertOrAssignNode<NodeType>(std::move(key), std::forward<V>(value));
+}
+
+/*
+ * Links a new leaf in as a plain BST does, then lets the policy rebalance.
+ */
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+void BalancedBST<Key, Value, Policy, Compare, Alloc>::attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::attachNode(node, parent, isLeft);
+    policy_.inserted(*this, static_cast<NodeType*>(node));
+}
+
+/*
+ * The policy first makes sure the node has at most one child, which then
+ * takes its place; the policy rebalances from its parent.
+ */
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+void BalancedBST<Key, Value, Policy, Compare, Alloc>::eraseNode(Node<Key, Value>* node)
+{
+    NodeType* removeNode = static_cast<NodeType*>(node);
+    policy_.prepareRemove(*this, removeNode);
+    this->nodeDetaching(removeNode);
+
+    NodeType* parent = removeNode->getParent();
+    NodeType* child = (removeNode->getLeft() != nullptr) ? removeNode->getLeft() : removeNode->getRight();
+    const bool wasLeft = (parent != nullptr && removeNode == parent->getLeft());
+    if(parent == nullptr)
+    {
+        this->root_ = child;
+    }
+    else if(wasLeft)
+    {
+        parent->setLeft(child);
+    }
+    else
+    {
+        parent->setRight(child);
+    }
+    if(child != nullptr)
+    {
+        child->setParent(parent);
+    }
+
+    const typename Policy::Rank rank = removeNode->getRank();
+    this->destroyNode(removeNode);
+    policy_.removed(*this, parent, child, wasLeft, rank);
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+void BalancedBST<Key, Value, Policy, Compare, Alloc>::nodeSwap(NodeType* n1, NodeType* n2)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::nodeSwap(n1, n2);
+    const typename Policy::Rank rank = n1->getRank();
+    n1->setRank(n2->getRank());
+    n2->setRank(rank);
+}
+
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+void BalancedBST<Key, Value, Policy, Compare, Alloc>::swapWithPredecessor(NodeType* node)
+{
+    nodeSwap(node, static_cast<NodeType*>(this->predecessor(node)));
+}
+
+/*
+ * The right child of node takes its place, node becoming its left child.
+ */
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+void BalancedBST<Key, Value, Policy, Compare, Alloc>::rotateLeft(NodeType* node)
+{
+    NodeType* rightChild = node->getRight();
+    NodeType* parent = node->getParent();
+
+    node->setRight(rightChild->getLeft());
+    if(rightChild->getLeft() != nullptr)
+    {
+        rightChild->getLeft()->setParent(node);
+    }
+
+    rightChild->setParent(parent);
+    if(parent == nullptr)
+    {
+        this->root_ = rightChild;
+    }
+    else if(node == parent->getLeft())
+    {
+        parent->setLeft(rightChild);
+    }
+    else
+    {
+        parent->setRight(rightChild);
+    }
+
+    rightChild->setLeft(node);
+    node->setParent(rightChild);
+}
+
+/*
+ * The mirror image of rotateLeft.
+ */
+template<class Key, class Value, class Policy, class Compare, class Alloc>
+void BalancedBST<Key, Value, Policy, Compare, Alloc>::rotateRight(NodeType* node)
+{
+    NodeType* leftChild = node->getLeft();
+    NodeType* parent = node->getParent();
+
+    node->setLeft(leftChild->getRight());
+    if(leftChild->getRight() != nullptr)
+    {
+        leftChild->getRight()->setParent(node);
+    }
+
+    leftChild->setParent(parent);
+    if(parent == nullptr)
+    {
+        this->root_ = leftChild;
+    }
+    else if(node == parent->getLeft())
+    {
+        parent->setLeft(leftChild);
+    }
+    else
+    {
+        parent->setRight(leftChild);
+    }
+
+    leftChild->setRight(node);
+    node->setParent(leftChild);
+}
+
+#endif
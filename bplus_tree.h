@@ -0,0 +1,1612 @@
+#ifndef BPLUS_TREE_H
+#define BPLUS_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "bst.h"
+
+/**
+* How an inner node of a BPlusTree picks the child to descend into: the
+* number of its keys that are not greater than the key sought. In general
+* this is a binary search through Compare.
+*/
+template<typename Key, typename Compare, typename Enable = void>
+struct NodeKeySearch
+{
+    typedef std::false_type linear;
+
+    static int countNotGreater(const Key* keys, int count, const Key& key, const Compare& comp)
+    {
+        int low = 0;
+        int high = count;
+        while(low < high)
+        {
+            const int mid = (low + high) / 2;
+            if(comp(key, keys[mid]))
+            {
+                high = mid;
+            }
+            else
+            {
+                low = mid + 1;
+            }
+        }
+        return low;
+    }
+};
+
+/**
+* Integral keys under std::less are compared with all the keys of a node at
+* once instead: with SIMD where the target has it (AVX2 for 32 and 64-bit
+* keys, SSE2 for 32-bit and SSE4.2 for 64-bit ones), otherwise with a
+* branch free count. Either way no branch depends on the key.
+*
+* The SIMD loads read whole blocks of keys, up to three (seven) slots past
+* the last key in use; the node layout makes sure those bytes are part of
+* the node.
+*/
+template<typename Key>
+struct NodeKeySearch<Key, std::less<Key>, typename std::enable_if<std::is_integral<Key>::value>::type>
+{
+    typedef std::true_type linear;
+
+    static int countNotGreater(const Key* keys, int count, const Key& key, const std::less<Key>&)
+    {
+        return count - countGreater(keys, count, key, std::integral_constant<std::size_t, sizeof(Key)>());
+    }
+
+    template<typename Width>
+    static int countGreater(const Key* keys, int count, Key key, Width)
+    {
+        int greater = 0;
+        for(int i = 0; i < count; ++i)
+        {
+            greater += static_cast<int>(key < keys[i]);
+        }
+        return greater;
+    }
+
+#if (defined(__AVX2__) || defined(__SSE4_2__)) && (defined(__GNUC__) || defined(__clang__))
+    static int countGreater(const Key* keys, int count, Key key, std::integral_constant<std::size_t, 8>)
+    {
+        //the instructions compare signed lanes; flipping the sign bit orders unsigned keys the same way
+        const std::int64_t flip = std::is_signed<Key>::value ? 0 : std::numeric_limits<std::int64_t>::min();
+        int greater = 0;
+#if defined(__AVX2__)
+        const __m256i bias = _mm256_set1_epi64x(flip);
+        const __m256i probe = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<std::int64_t>(key)), bias);
+        for(int i = 0; i < count; i += 4)
+        {
+            const __m256i block = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bias);
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(block, probe))));
+            if(count - i < 4)
+            {
+                mask &= (1u << (count - i)) - 1;
+            }
+            greater += __builtin_popcount(mask);
+        }
+#else
+        const __m128i bias = _mm_set1_epi64x(flip);
+        const __m128i probe = _mm_xor_si128(_mm_set1_epi64x(static_cast<std::int64_t>(key)), bias);
+        for(int i = 0; i < count; i += 2)
+        {
+            const __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bias);
+            unsigned mask = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(block, probe))));
+            if(count - i < 2)
+            {
+                mask &= 1u;
+            }
+            greater += __builtin_popcount(mask);
+        }
+#endif
+        return greater;
+    }
+#endif
+
+#if (defined(__AVX2__) || defined(__SSE2__)) && (defined(__GNUC__) || defined(__clang__))
+    static int countGreater(const Key* keys, int count, Key key, std::integral_constant<std::size_t, 4>)
+    {
+        const std::int32_t flip = std::is_signed<Key>::value ? 0 : std::numeric_limits<std::int32_t>::min();
+        int greater = 0;
+#if defined(__AVX2__)
+        const __m256i bias = _mm256_set1_epi32(flip);
+        const __m256i probe = _mm256_xor_si256(_mm256_set1_epi32(static_cast<std::int32_t>(key)), bias);
+        for(int i = 0; i < count; i += 8)
+        {
+            const __m256i block = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), bias);
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(block, probe))));
+            if(count - i < 8)
+            {
+                mask &= (1u << (count - i)) - 1;
+            }
+            greater += __builtin_popcount(mask);
+        }
+#else
+        const __m128i bias = _mm_set1_epi32(flip);
+        const __m128i probe = _mm_xor_si128(_mm_set1_epi32(static_cast<std::int32_t>(key)), bias);
+        for(int i = 0; i < count; i += 4)
+        {
+            const __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), bias);
+            unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(block, probe))));
+            if(count - i < 4)
+            {
+                mask &= (1u << (count - i)) - 1;
+            }
+            greater += __builtin_popcount(mask);
+        }
+#endif
+        return greater;
+    }
+#endif
+};
+
+/**
+* A B+-tree with the interface of BinarySearchTree (insert, remove, find,
+* operator[], bidirectional iterators, lower_bound/upper_bound, clear), for
+* large maps where a lookup in a binary tree would be a cache miss per level.
+*
+* Every node is one block of about NodeBytes bytes (eight cache lines by
+* default, which measured best; see "./bst-bench bplus"). An inner node holds up to InnerCapacity keys side by side and
+* one more child pointer; the entries live in the leaves only, sorted, and
+* the leaves are linked both ways, so a scan walks arrays instead of
+* chasing a pointer per entry. With 64-bit keys and values the fanout is
+* 32 and a leaf holds 30 entries, so a tree of 200M entries is six levels
+* deep instead of about 28. The child to descend into is picked by
+* NodeKeySearch, with SIMD for integral keys, and the lines of the child
+* are prefetched before its keys are compared.
+*
+* Inserting or removing moves entries inside and between leaves, so both
+* invalidate iterators, and relocating an entry copies its key and moves
+* its value; those are assumed not to throw. Key must be copy assignable.
+* Inserting at the end of the last leaf splits it unevenly, so that keys
+* inserted in ascending order (and copies) fill every leaf completely.
+*/
+template <class Key, class Value, class Compare = std::less<Key>,
+          class Alloc = std::allocator<std::pair<const Key, Value> >, std::size_t NodeBytes = 512>
+class BPlusTree
+{
+protected:
+    typedef std::pair<const Key, Value> Item;
+
+    struct BaseNode
+    {
+        std::uint16_t count;    // keys of an inner node, entries of a leaf
+        bool leaf;
+    };
+
+public:
+    static const std::size_t InnerCapacity =
+        (NodeBytes > 2 * sizeof(void*) + 3 * (sizeof(Key) + sizeof(void*)))
+            ? (NodeBytes - 2 * sizeof(void*)) / (sizeof(Key) + sizeof(void*)) : 3;
+    static const std::size_t LeafCapacity =
+        (NodeBytes > 3 * sizeof(void*) + 4 * sizeof(Item)) ? (NodeBytes - 3 * sizeof(void*)) / sizeof(Item) : 4;
+
+    BPlusTree();
+    explicit BPlusTree(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit BPlusTree(const Alloc& alloc);
+    BPlusTree(const BPlusTree& other);
+    BPlusTree(BPlusTree&& other) noexcept;
+    ~BPlusTree();
+    BPlusTree& operator=(const BPlusTree& other);
+    BPlusTree& operator=(BPlusTree&& other) noexcept(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value);
+
+    class const_iterator;
+
+    /**
+    * A bidirectional iterator over the entries in key order: a leaf and a
+    * slot in it. Decrementing end() gives the largest entry.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BPlusTree<Key, Value, Compare, Alloc, NodeBytes>;
+        friend class const_iterator;
+        iterator(const BPlusTree<Key, Value, Compare, Alloc, NodeBytes>* tree, BaseNode* leaf, int slot);
+        const BPlusTree<Key, Value, Compare, Alloc, NodeBytes>* tree_;
+        BaseNode* leaf_;
+        int slot_;
+    };
+
+    /**
+    * The same over a const tree. An iterator converts to a const_iterator.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& other);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs)
+        {
+            return lhs.leaf_ == rhs.leaf_ && lhs.slot_ == rhs.slot_;
+        }
+        friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs)
+        {
+            return !(lhs == rhs);
+        }
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    protected:
+        friend class BPlusTree<Key, Value, Compare, Alloc, NodeBytes>;
+        const_iterator(const BPlusTree<Key, Value, Compare, Alloc, NodeBytes>* tree, BaseNode* leaf, int slot);
+        const BPlusTree<Key, Value, Compare, Alloc, NodeBytes>* tree_;
+        BaseNode* leaf_;
+        int slot_;
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    // Inserting an existing key overwrites its value. The iterator points at
+    // the key's entry; the bool is true iff a new entry was created.
+    std::pair<iterator, bool> insert(const std::pair<const Key, Value>& keyValuePair);
+    std::pair<iterator, bool> insert(std::pair<const Key, Value>&& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+    Compare key_comp() const;
+
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin();
+    const_reverse_iterator rbegin() const;
+    reverse_iterator rend();
+    const_reverse_iterator rend() const;
+
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key);
+    const_iterator upper_bound(const Key& key) const;
+
+protected:
+    struct InnerNode : BaseNode
+    {
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keys[InnerCapacity];
+        // also the slack read past the last key by NodeKeySearch
+        BaseNode* children[InnerCapacity + 1];
+
+        Key* keyData() { return reinterpret_cast<Key*>(keys); }
+        const Key* keyData() const { return reinterpret_cast<const Key*>(keys); }
+        Key& key(int i) { return keyData()[i]; }
+        const Key& key(int i) const { return keyData()[i]; }
+    };
+
+    struct LeafNode : BaseNode
+    {
+        LeafNode* prev;
+        LeafNode* next;
+        typename std::aligned_storage<sizeof(Item), alignof(Item)>::type items[LeafCapacity];
+
+        Item& item(int i) { return *reinterpret_cast<Item*>(&items[i]); }
+        const Item& item(int i) const { return *reinterpret_cast<const Item*>(&items[i]); }
+    };
+
+    // Both kinds of node are carved from blocks of one size, so that a
+    // PoolAllocator serves them from a single pool.
+    static const std::size_t BlockBytes = (sizeof(InnerNode) > sizeof(LeafNode)) ? sizeof(InnerNode) : sizeof(LeafNode);
+    static const std::size_t BlockAlign = (alignof(InnerNode) > alignof(LeafNode)) ? alignof(InnerNode) : alignof(LeafNode);
+    typedef typename std::aligned_storage<BlockBytes, BlockAlign>::type NodeBlock;
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<NodeBlock> BlockAlloc;
+    typedef std::allocator_traits<BlockAlloc> BlockTraits;
+    typedef NodeKeySearch<Key, Compare> KeySearch;
+
+    // no node has fewer entries, except the root and the last node of a level
+    static const int MinInner = static_cast<int>((InnerCapacity - 1) / 2);
+    static const int MinLeaf = static_cast<int>(LeafCapacity / 2);
+    // every inner node has at least two children, so this covers any size_t count
+    static const int MaxDepth = 64;
+
+    static_assert(LeafCapacity < 65536 && InnerCapacity < 65536, "node counts are 16 bits wide");
+
+    // A root to leaf path: the inner nodes and the child taken in each.
+    struct Path
+    {
+        InnerNode* nodes[MaxDepth];
+        int children[MaxDepth];
+        int depth;
+    };
+
+    template<typename ItemArg>
+    std::pair<iterator, bool> insertItem(ItemArg&& item);
+    template<typename ItemArg>
+    void insertIntoLeaf(LeafNode* leaf, int slot, ItemArg&& item);
+    void insertIntoInner(InnerNode* node, int slot, Key&& key, BaseNode* child);
+    void splitAndPropagate(Path& path, LeafNode* right, bool append, BaseNode** spares);
+    void eraseFromLeaf(LeafNode* leaf, int slot);
+    void eraseFromInner(InnerNode* node, int slot);
+    bool rebalanceLeaf(LeafNode* leaf, InnerNode* parent, int index);
+    bool rebalanceInner(InnerNode* node, InnerNode* parent, int index);
+
+    LeafNode* descend(const Key& key, Path* path) const;
+    int childIndex(const InnerNode* node, const Key& key) const;
+    int leafBound(const LeafNode* leaf, const Key& key, bool strict) const;
+    int leafBound(const LeafNode* leaf, const Key& key, bool strict, std::true_type) const;
+    int leafBound(const LeafNode* leaf, const Key& key, bool strict, std::false_type) const;
+    BaseNode* findEntry(const Key& key, int& slot) const;
+    BaseNode* boundEntry(const Key& key, bool strict, int& slot) const;
+    static void prefetchNode(const BaseNode* node);
+
+    LeafNode* createLeaf();
+    InnerNode* createInner();
+    void freeNode(BaseNode* node);
+    void destroySubtree(BaseNode* node);
+    void copyFrom(const BPlusTree& other);
+    void stealFrom(BPlusTree& other);
+    void swapContents(BPlusTree& other);
+
+    static void relocate(Item* from, Item* to);
+    static void relocate(Key* from, Key* to);
+
+protected:
+    BaseNode* root_;
+    LeafNode* head_;    // the leftmost and rightmost leaf
+    LeafNode* tail_;
+    std::size_t size_;
+    Compare comp_;
+    Alloc alloc_;
+};
+
+template <class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+const std::size_t BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::InnerCapacity;
+template <class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+const std::size_t BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::LeafCapacity;
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the BPlusTree::iterator class.
+  ---------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::iterator() : tree_(nullptr), leaf_(nullptr), slot_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::iterator(
+    const BPlusTree<Key, Value, Compare, Alloc, NodeBytes>* tree, BaseNode* leaf, int slot) :
+    tree_(tree), leaf_(leaf), slot_(slot)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+std::pair<const Key,Value>& BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::operator*() const
+{
+    return static_cast<LeafNode*>(leaf_)->item(slot_);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+std::pair<const Key,Value>* BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::operator->() const
+{
+    return &(static_cast<LeafNode*>(leaf_)->item(slot_));
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && slot_ == rhs.slot_;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator&
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::operator++()
+{
+    if(leaf_ != nullptr && ++slot_ == leaf_->count)
+    {
+        leaf_ = static_cast<LeafNode*>(leaf_)->next;
+        slot_ = 0;
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++*this;
+    return old;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator&
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::operator--()
+{
+    if(leaf_ == nullptr)
+    {
+        leaf_ = tree_->tail_;
+        slot_ = leaf_->count - 1;
+    }
+    else if(slot_ == 0)
+    {
+        leaf_ = static_cast<LeafNode*>(leaf_)->prev;
+        slot_ = leaf_->count - 1;
+    }
+    else
+    {
+        --slot_;
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --*this;
+    return old;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the BPlusTree::iterator class.
+  -------------------------------------------------
+*/
+
+/*
+  ---------------------------------------------------------
+  Begin implementations for the BPlusTree::const_iterator class.
+  ---------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::const_iterator() : tree_(nullptr), leaf_(nullptr), slot_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::const_iterator(const iterator& other) :
+    tree_(other.tree_), leaf_(other.leaf_), slot_(other.slot_)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::const_iterator(
+    const BPlusTree<Key, Value, Compare, Alloc, NodeBytes>* tree, BaseNode* leaf, int slot) :
+    tree_(tree), leaf_(leaf), slot_(slot)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+const std::pair<const Key,Value>& BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::operator*() const
+{
+    return static_cast<const LeafNode*>(leaf_)->item(slot_);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+const std::pair<const Key,Value>* BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::operator->() const
+{
+    return &(static_cast<const LeafNode*>(leaf_)->item(slot_));
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator&
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::operator++()
+{
+    iterator step(tree_, leaf_, slot_);
+    ++step;
+    leaf_ = step.leaf_;
+    slot_ = step.slot_;
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++*this;
+    return old;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator&
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::operator--()
+{
+    iterator step(tree_, leaf_, slot_);
+    --step;
+    leaf_ = step.leaf_;
+    slot_ = step.slot_;
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --*this;
+    return old;
+}
+
+/*
+  -------------------------------------------------------
+  End implementations for the BPlusTree::const_iterator class.
+  -------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------
+  Begin implementations for the BPlusTree class.
+  ------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::BPlusTree() :
+    root_(nullptr), head_(nullptr), tail_(nullptr), size_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::BPlusTree(const Compare& comp, const Alloc& alloc) :
+    root_(nullptr), head_(nullptr), tail_(nullptr), size_(0), comp_(comp), alloc_(alloc)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::BPlusTree(const Alloc& alloc) :
+    root_(nullptr), head_(nullptr), tail_(nullptr), size_(0), alloc_(alloc)
+{
+
+}
+
+/**
+* Copies the entries of other in key order. Every insert lands at the end of
+* the last leaf, so the copy takes O(n) and its leaves are full.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::BPlusTree(const BPlusTree& other) :
+    root_(nullptr), head_(nullptr), tail_(nullptr), size_(0), comp_(other.comp_),
+    alloc_(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.alloc_))
+{
+    copyFrom(other);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::BPlusTree(BPlusTree&& other) noexcept :
+    root_(nullptr), head_(nullptr), tail_(nullptr), size_(0), comp_(std::move(other.comp_)), alloc_(std::move(other.alloc_))
+{
+    stealFrom(other);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::~BPlusTree()
+{
+    clear();
+}
+
+/**
+* Copy assignment. The copy is built before the old contents are freed, so
+* the tree is left unchanged if copying throws.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>&
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::operator=(const BPlusTree& other)
+{
+    if(this == &other)
+    {
+        return *this;
+    }
+    BPlusTree copy(other.comp_, std::allocator_traits<Alloc>::propagate_on_container_copy_assignment::value ? other.alloc_ : alloc_);
+    copy.copyFrom(other);
+    swapContents(copy);
+    return *this;
+}
+
+/**
+* Move assignment: frees the old contents and takes over the nodes of other
+* in O(1). Only when the allocator does not propagate and the two allocators
+* differ are the entries moved one by one instead.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>&
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::operator=(BPlusTree&& other)
+    noexcept(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+{
+    if(this == &other)
+    {
+        return *this;
+    }
+    clear();
+    comp_ = other.comp_;
+    if(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+    {
+        alloc_ = std::move(other.alloc_);
+        stealFrom(other);
+    }
+    else if(alloc_ == other.alloc_)
+    {
+        stealFrom(other);
+    }
+    else
+    {
+        for(iterator it = other.begin(); it != other.end(); ++it)
+        {
+            insert(std::move(*it));
+        }
+        other.clear();
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+std::pair<typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator, bool>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    return insertItem(keyValuePair);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+std::pair<typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator, bool>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::insert(std::pair<const Key, Value>&& keyValuePair)
+{
+    return insertItem(std::move(keyValuePair));
+}
+
+/**
+* Removes the entry with the given key, if there is one. A leaf left with
+* fewer than MinLeaf entries borrows one from a sibling, or is merged with
+* it when the sibling has none to spare; a merge takes a key out of the
+* parent, which may in turn borrow or merge, up to the root.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::remove(const Key& key)
+{
+    if(root_ == nullptr)
+    {
+        return;
+    }
+    Path path;
+    LeafNode* leaf = descend(key, &path);
+    const int slot = leafBound(leaf, key, false);
+    if(slot == leaf->count || comp_(key, leaf->item(slot).first))
+    {
+        return;
+    }
+    eraseFromLeaf(leaf, slot);
+    --size_;
+
+    if(path.depth == 0)
+    {
+        if(leaf->count == 0)
+        {
+            freeNode(leaf);
+            root_ = head_ = tail_ = nullptr;
+        }
+        return;
+    }
+    if(leaf->count >= MinLeaf)
+    {
+        return;
+    }
+    int level = path.depth - 1;
+    bool merged = rebalanceLeaf(leaf, path.nodes[level], path.children[level]);
+    //a merge took a key out of path.nodes[level]
+    while(merged && level > 0 && path.nodes[level]->count < MinInner)
+    {
+        merged = rebalanceInner(path.nodes[level], path.nodes[level - 1], path.children[level - 1]);
+        --level;
+    }
+    InnerNode* root = static_cast<InnerNode*>(root_);
+    if(root->count == 0)
+    {
+        root_ = root->children[0];
+        freeNode(root);
+    }
+}
+
+/**
+* Destroys every entry and frees every node.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::clear()
+{
+    if(root_ != nullptr)
+    {
+        destroySubtree(root_);
+    }
+    root_ = nullptr;
+    head_ = nullptr;
+    tail_ = nullptr;
+    size_ = 0;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::empty() const
+{
+    return size_ == 0;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+std::size_t BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+Compare BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::key_comp() const
+{
+    return comp_;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::begin()
+{
+    return iterator(this, head_, 0);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::begin() const
+{
+    return const_iterator(this, head_, 0);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::cbegin() const
+{
+    return begin();
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::end()
+{
+    return iterator(this, nullptr, 0);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::end() const
+{
+    return const_iterator(this, nullptr, 0);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::cend() const
+{
+    return end();
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::reverse_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_reverse_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::reverse_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_reverse_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::find(const Key& key)
+{
+    int slot;
+    BaseNode* leaf = findEntry(key, slot);
+    return iterator(this, leaf, slot);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::find(const Key& key) const
+{
+    int slot;
+    BaseNode* leaf = findEntry(key, slot);
+    return const_iterator(this, leaf, slot);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+Value& BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::operator[](const Key& key)
+{
+    int slot;
+    BaseNode* leaf = findEntry(key, slot);
+    if(leaf == nullptr) throw std::out_of_range("Invalid key");
+    return static_cast<LeafNode*>(leaf)->item(slot).second;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+Value const & BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::operator[](const Key& key) const
+{
+    int slot;
+    BaseNode* leaf = findEntry(key, slot);
+    if(leaf == nullptr) throw std::out_of_range("Invalid key");
+    return static_cast<const LeafNode*>(leaf)->item(slot).second;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::lower_bound(const Key& key)
+{
+    int slot;
+    BaseNode* leaf = boundEntry(key, false, slot);
+    return iterator(this, leaf, slot);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::lower_bound(const Key& key) const
+{
+    int slot;
+    BaseNode* leaf = boundEntry(key, false, slot);
+    return const_iterator(this, leaf, slot);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::upper_bound(const Key& key)
+{
+    int slot;
+    BaseNode* leaf = boundEntry(key, true, slot);
+    return iterator(this, leaf, slot);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::const_iterator
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::upper_bound(const Key& key) const
+{
+    int slot;
+    BaseNode* leaf = boundEntry(key, true, slot);
+    return const_iterator(this, leaf, slot);
+}
+
+/**
+* The insert behind both overloads. A full leaf is split, and the first key
+* of its new right half goes up into the parent, which may split in turn,
+* up to the root. The nodes a split may need are allocated before anything
+* is changed, so that running out of memory leaves the tree as it was.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+template<typename ItemArg>
+std::pair<typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::iterator, bool>
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::insertItem(ItemArg&& item)
+{
+    if(root_ == nullptr)
+    {
+        LeafNode* leaf = createLeaf();
+        try
+        {
+            insertIntoLeaf(leaf, 0, std::forward<ItemArg>(item));
+        }
+        catch(...)
+        {
+            freeNode(leaf);
+            throw;
+        }
+        root_ = head_ = tail_ = leaf;
+        size_ = 1;
+        return std::make_pair(iterator(this, leaf, 0), true);
+    }
+
+    Path path;
+    LeafNode* leaf = descend(item.first, &path);
+    int slot = leafBound(leaf, item.first, false);
+    if(slot < leaf->count && !comp_(item.first, leaf->item(slot).first))
+    {
+        leaf->item(slot).second = std::forward<ItemArg>(item).second;
+        return std::make_pair(iterator(this, leaf, slot), false);
+    }
+    if(leaf->count < LeafCapacity)
+    {
+        insertIntoLeaf(leaf, slot, std::forward<ItemArg>(item));
+        ++size_;
+        return std::make_pair(iterator(this, leaf, slot), true);
+    }
+
+    //one new node per full level on the path, plus a new root if they all are
+    BaseNode* spares[MaxDepth + 2];
+    int needed = 1;
+    for(int level = path.depth - 1; level >= 0 && path.nodes[level]->count == InnerCapacity; --level)
+    {
+        ++needed;
+    }
+    if(needed == path.depth + 1)
+    {
+        ++needed;
+    }
+    int allocated = 0;
+    try
+    {
+        for(; allocated < needed; ++allocated)
+        {
+            spares[allocated] = (allocated == 0) ? static_cast<BaseNode*>(createLeaf()) : createInner();
+        }
+    }
+    catch(...)
+    {
+        while(allocated > 0)
+        {
+            freeNode(spares[--allocated]);
+        }
+        throw;
+    }
+
+    LeafNode* right = static_cast<LeafNode*>(spares[0]);
+    LeafNode* target;
+    const bool append = (leaf == tail_ && slot == leaf->count);
+    if(append)
+    {
+        //ascending inserts: leave the full leaf as it is
+        try
+        {
+            insertIntoLeaf(right, 0, std::forward<ItemArg>(item));
+        }
+        catch(...)
+        {
+            for(int i = 0; i < needed; ++i)
+            {
+                freeNode(spares[i]);
+            }
+            throw;
+        }
+        target = right;
+        slot = 0;
+    }
+    else
+    {
+        const int keep = static_cast<int>(LeafCapacity / 2);
+        for(int i = keep; i < leaf->count; ++i)
+        {
+            relocate(&leaf->item(i), &right->item(i - keep));
+        }
+        right->count = static_cast<std::uint16_t>(leaf->count - keep);
+        leaf->count = static_cast<std::uint16_t>(keep);
+        target = (slot > keep) ? right : leaf;
+        slot = (slot > keep) ? slot - keep : slot;
+    }
+    right->prev = leaf;
+    right->next = leaf->next;
+    if(leaf->next != nullptr)
+    {
+        leaf->next->prev = right;
+    }
+    else
+    {
+        tail_ = right;
+    }
+    leaf->next = right;
+    splitAndPropagate(path, right, append, spares + 1);
+
+    if(!append)
+    {
+        //the tree is whole again, so a throwing copy of item only loses the insert
+        insertIntoLeaf(target, slot, std::forward<ItemArg>(item));
+    }
+    ++size_;
+    return std::make_pair(iterator(this, target, slot), true);
+}
+
+/**
+* Constructs item at slot, moving the entries from slot on one place right.
+* If constructing throws, they are moved back.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+template<typename ItemArg>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::insertIntoLeaf(LeafNode* leaf, int slot, ItemArg&& item)
+{
+    for(int i = leaf->count; i > slot; --i)
+    {
+        relocate(&leaf->item(i - 1), &leaf->item(i));
+    }
+    try
+    {
+        ::new (static_cast<void*>(&leaf->item(slot))) Item(std::forward<ItemArg>(item));
+    }
+    catch(...)
+    {
+        for(int i = slot; i < leaf->count; ++i)
+        {
+            relocate(&leaf->item(i + 1), &leaf->item(i));
+        }
+        throw;
+    }
+    ++leaf->count;
+}
+
+/**
+* Puts key at slot of an inner node that has room, with child to its right.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::insertIntoInner(InnerNode* node, int slot, Key&& key, BaseNode* child)
+{
+    for(int i = node->count; i > slot; --i)
+    {
+        relocate(&node->key(i - 1), &node->key(i));
+        node->children[i + 1] = node->children[i];
+    }
+    ::new (static_cast<void*>(&node->key(slot))) Key(std::move(key));
+    node->children[slot + 1] = child;
+    ++node->count;
+}
+
+/**
+* Hangs the new leaf right, just split off, into the tree: its first key
+* goes into the parent, splitting full inner nodes on the way up, whose
+* middle keys go up in turn. spares holds a new inner node for each of
+* those splits and one for a new root, if it comes to that. When the leaf
+* split was an append, the inner nodes split keep all but one key on the
+* left too, so that ascending inserts leave full nodes behind.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::splitAndPropagate(Path& path, LeafNode* right, bool append, BaseNode** spares)
+{
+    Key carry(right->item(0).first);
+    BaseNode* child = right;
+    for(int level = path.depth - 1; level >= 0; --level)
+    {
+        InnerNode* node = path.nodes[level];
+        const int slot = path.children[level];
+        if(node->count < InnerCapacity)
+        {
+            insertIntoInner(node, slot, std::move(carry), child);
+            return;
+        }
+
+        //node keeps the keys before mid, mid goes up, sibling takes the rest
+        InnerNode* sibling = static_cast<InnerNode*>(*spares++);
+        const int mid = append ? static_cast<int>(InnerCapacity) - 1 : static_cast<int>(InnerCapacity / 2);
+        for(int i = mid + 1; i < node->count; ++i)
+        {
+            relocate(&node->key(i), &sibling->key(i - mid - 1));
+        }
+        for(int i = mid + 1; i <= node->count; ++i)
+        {
+            sibling->children[i - mid - 1] = node->children[i];
+        }
+        sibling->count = static_cast<std::uint16_t>(node->count - mid - 1);
+        Key up(std::move(node->key(mid)));
+        node->key(mid).~Key();
+        node->count = static_cast<std::uint16_t>(mid);
+
+        if(slot <= mid)
+        {
+            insertIntoInner(node, slot, std::move(carry), child);
+        }
+        else
+        {
+            insertIntoInner(sibling, slot - mid - 1, std::move(carry), child);
+        }
+        carry = std::move(up);
+        child = sibling;
+    }
+
+    InnerNode* root = static_cast<InnerNode*>(*spares);
+    ::new (static_cast<void*>(&root->key(0))) Key(std::move(carry));
+    root->children[0] = root_;
+    root->children[1] = child;
+    root->count = 1;
+    root_ = root;
+}
+
+/**
+* Destroys the entry at slot and closes the gap.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::eraseFromLeaf(LeafNode* leaf, int slot)
+{
+    leaf->item(slot).~Item();
+    for(int i = slot + 1; i < leaf->count; ++i)
+    {
+        relocate(&leaf->item(i), &leaf->item(i - 1));
+    }
+    --leaf->count;
+}
+
+/**
+* Destroys the key at slot and drops the child to its right.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::eraseFromInner(InnerNode* node, int slot)
+{
+    node->key(slot).~Key();
+    for(int i = slot + 1; i < node->count; ++i)
+    {
+        relocate(&node->key(i), &node->key(i - 1));
+        node->children[i] = node->children[i + 1];
+    }
+    --node->count;
+}
+
+/**
+* Refills a leaf that dropped below MinLeaf, the child at index of parent:
+* borrows an entry from a sibling with more than MinLeaf, or else merges
+* with one. Returns true if it merged, taking a key out of parent.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::rebalanceLeaf(LeafNode* leaf, InnerNode* parent, int index)
+{
+    LeafNode* left = (index > 0) ? static_cast<LeafNode*>(parent->children[index - 1]) : nullptr;
+    LeafNode* right = (index < parent->count) ? static_cast<LeafNode*>(parent->children[index + 1]) : nullptr;
+    if(left != nullptr && left->count > MinLeaf)
+    {
+        for(int i = leaf->count; i > 0; --i)
+        {
+            relocate(&leaf->item(i - 1), &leaf->item(i));
+        }
+        relocate(&left->item(left->count - 1), &leaf->item(0));
+        --left->count;
+        ++leaf->count;
+        parent->key(index - 1) = leaf->item(0).first;
+        return false;
+    }
+    if(right != nullptr && right->count > MinLeaf)
+    {
+        relocate(&right->item(0), &leaf->item(leaf->count));
+        ++leaf->count;
+        for(int i = 1; i < right->count; ++i)
+        {
+            relocate(&right->item(i), &right->item(i - 1));
+        }
+        --right->count;
+        parent->key(index) = right->item(0).first;
+        return false;
+    }
+
+    //merge the right one of the pair into the left one
+    if(left == nullptr)
+    {
+        left = leaf;
+        ++index;
+    }
+    else
+    {
+        right = leaf;
+    }
+    for(int i = 0; i < right->count; ++i)
+    {
+        relocate(&right->item(i), &left->item(left->count + i));
+    }
+    left->count = static_cast<std::uint16_t>(left->count + right->count);
+    left->next = right->next;
+    if(right->next != nullptr)
+    {
+        right->next->prev = left;
+    }
+    else
+    {
+        tail_ = left;
+    }
+    freeNode(right);
+    eraseFromInner(parent, index - 1);
+    return true;
+}
+
+/**
+* The same for an inner node that dropped below MinInner keys. Borrowing
+* rotates a key through the parent; merging pulls the parent's key between
+* the two nodes down into the merged one.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::rebalanceInner(InnerNode* node, InnerNode* parent, int index)
+{
+    InnerNode* left = (index > 0) ? static_cast<InnerNode*>(parent->children[index - 1]) : nullptr;
+    InnerNode* right = (index < parent->count) ? static_cast<InnerNode*>(parent->children[index + 1]) : nullptr;
+    if(left != nullptr && left->count > MinInner)
+    {
+        node->children[node->count + 1] = node->children[node->count];
+        for(int i = node->count; i > 0; --i)
+        {
+            relocate(&node->key(i - 1), &node->key(i));
+            node->children[i] = node->children[i - 1];
+        }
+        ::new (static_cast<void*>(&node->key(0))) Key(std::move(parent->key(index - 1)));
+        node->children[0] = left->children[left->count];
+        ++node->count;
+        parent->key(index - 1) = std::move(left->key(left->count - 1));
+        left->key(left->count - 1).~Key();
+        --left->count;
+        return false;
+    }
+    if(right != nullptr && right->count > MinInner)
+    {
+        ::new (static_cast<void*>(&node->key(node->count))) Key(std::move(parent->key(index)));
+        node->children[node->count + 1] = right->children[0];
+        ++node->count;
+        parent->key(index) = std::move(right->key(0));
+        right->key(0).~Key();
+        right->children[0] = right->children[1];
+        for(int i = 1; i < right->count; ++i)
+        {
+            relocate(&right->key(i), &right->key(i - 1));
+            right->children[i] = right->children[i + 1];
+        }
+        --right->count;
+        return false;
+    }
+
+    if(left == nullptr)
+    {
+        left = node;
+        ++index;
+    }
+    else
+    {
+        right = node;
+    }
+    ::new (static_cast<void*>(&left->key(left->count))) Key(std::move(parent->key(index - 1)));
+    for(int i = 0; i < right->count; ++i)
+    {
+        relocate(&right->key(i), &left->key(left->count + 1 + i));
+    }
+    for(int i = 0; i <= right->count; ++i)
+    {
+        left->children[left->count + 1 + i] = right->children[i];
+    }
+    left->count = static_cast<std::uint16_t>(left->count + 1 + right->count);
+    freeNode(right);
+    eraseFromInner(parent, index - 1);
+    return true;
+}
+
+/**
+* Walks from the root to the leaf where key is or would be, recording the
+* inner nodes on the way in path (when given). The tree must not be empty.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::LeafNode*
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::descend(const Key& key, Path* path) const
+{
+    BaseNode* node = root_;
+    int depth = 0;
+    while(!node->leaf)
+    {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        const int index = childIndex(inner, key);
+        if(path != nullptr)
+        {
+            path->nodes[depth] = inner;
+            path->children[depth] = index;
+        }
+        ++depth;
+        node = inner->children[index];
+        prefetchNode(node);
+    }
+    if(path != nullptr)
+    {
+        path->depth = depth;
+    }
+    return static_cast<LeafNode*>(node);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+int BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::childIndex(const InnerNode* node, const Key& key) const
+{
+    return KeySearch::countNotGreater(node->keyData(), node->count, key, comp_);
+}
+
+/**
+* The first slot of leaf whose key is not less than key (greater than key
+* if strict), or leaf->count if there is none.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+int BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::leafBound(const LeafNode* leaf, const Key& key, bool strict) const
+{
+    return leafBound(leaf, key, strict, typename KeySearch::linear());
+}
+
+// cheap comparisons: count the smaller keys without branching
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+int BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::leafBound(const LeafNode* leaf, const Key& key, bool strict, std::true_type) const
+{
+    int bound = 0;
+    if(strict)
+    {
+        for(int i = 0; i < leaf->count; ++i)
+        {
+            bound += static_cast<int>(!comp_(key, leaf->item(i).first));
+        }
+    }
+    else
+    {
+        for(int i = 0; i < leaf->count; ++i)
+        {
+            bound += static_cast<int>(comp_(leaf->item(i).first, key));
+        }
+    }
+    return bound;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+int BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::leafBound(const LeafNode* leaf, const Key& key, bool strict, std::false_type) const
+{
+    int low = 0;
+    int high = leaf->count;
+    while(low < high)
+    {
+        const int mid = (low + high) / 2;
+        const Key& probe = leaf->item(mid).first;
+        if(strict ? !comp_(key, probe) : comp_(probe, key))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+* The leaf and slot holding key, or nullptr if it is not in the tree.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::BaseNode*
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::findEntry(const Key& key, int& slot) const
+{
+    slot = 0;
+    if(root_ == nullptr)
+    {
+        return nullptr;
+    }
+    LeafNode* leaf = descend(key, nullptr);
+    const int bound = leafBound(leaf, key, false);
+    if(bound == leaf->count || comp_(key, leaf->item(bound).first))
+    {
+        return nullptr;
+    }
+    slot = bound;
+    return leaf;
+}
+
+/**
+* The leaf and slot of the first entry not less than key (greater than key
+* if strict), or nullptr at the end. It is in the next leaf when every key
+* of the leaf reached is smaller.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::BaseNode*
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::boundEntry(const Key& key, bool strict, int& slot) const
+{
+    slot = 0;
+    if(root_ == nullptr)
+    {
+        return nullptr;
+    }
+    LeafNode* leaf = descend(key, nullptr);
+    const int bound = leafBound(leaf, key, strict);
+    if(bound == leaf->count)
+    {
+        return leaf->next;
+    }
+    slot = bound;
+    return leaf;
+}
+
+/**
+* Asks for every cache line of a node, so that they load in parallel
+* rather than one by one as its keys are compared.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::prefetchNode(const BaseNode* node)
+{
+    const char* bytes = reinterpret_cast<const char*>(node);
+    for(std::size_t offset = 0; offset < BlockBytes; offset += 64)
+    {
+        prefetchForRead(bytes + offset);
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::LeafNode*
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::createLeaf()
+{
+    BlockAlloc blockAlloc(alloc_);
+    LeafNode* leaf = ::new (static_cast<void*>(BlockTraits::allocate(blockAlloc, 1))) LeafNode;
+    leaf->count = 0;
+    leaf->leaf = true;
+    leaf->prev = nullptr;
+    leaf->next = nullptr;
+    return leaf;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::InnerNode*
+BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::createInner()
+{
+    BlockAlloc blockAlloc(alloc_);
+    InnerNode* node = ::new (static_cast<void*>(BlockTraits::allocate(blockAlloc, 1))) InnerNode;
+    node->count = 0;
+    node->leaf = false;
+    return node;
+}
+
+/**
+* Hands the block of a node back to the allocator; its keys or entries
+* must have been destroyed or moved out already.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::freeNode(BaseNode* node)
+{
+    BlockAlloc blockAlloc(alloc_);
+    BlockTraits::deallocate(blockAlloc, reinterpret_cast<NodeBlock*>(node), 1);
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::destroySubtree(BaseNode* node)
+{
+    if(node->leaf)
+    {
+        LeafNode* leaf = static_cast<LeafNode*>(node);
+        for(int i = 0; i < leaf->count; ++i)
+        {
+            leaf->item(i).~Item();
+        }
+    }
+    else
+    {
+        InnerNode* inner = static_cast<InnerNode*>(node);
+        for(int i = 0; i < inner->count; ++i)
+        {
+            inner->key(i).~Key();
+        }
+        for(int i = 0; i <= inner->count; ++i)
+        {
+            destroySubtree(inner->children[i]);
+        }
+    }
+    freeNode(node);
+}
+
+/**
+* Appends the entries of other to this (empty) tree; on an exception the
+* tree is emptied again.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::copyFrom(const BPlusTree& other)
+{
+    try
+    {
+        for(const_iterator it = other.begin(); it != other.end(); ++it)
+        {
+            insert(*it);
+        }
+    }
+    catch(...)
+    {
+        clear();
+        throw;
+    }
+}
+
+/**
+* Takes over the nodes of other, leaving it empty. The allocators must be equal.
+*/
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::stealFrom(BPlusTree& other)
+{
+    root_ = other.root_;
+    head_ = other.head_;
+    tail_ = other.tail_;
+    size_ = other.size_;
+    other.root_ = nullptr;
+    other.head_ = nullptr;
+    other.tail_ = nullptr;
+    other.size_ = 0;
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::swapContents(BPlusTree& other)
+{
+    std::swap(root_, other.root_);
+    std::swap(head_, other.head_);
+    std::swap(tail_, other.tail_);
+    std::swap(size_, other.size_);
+    std::swap(comp_, other.comp_);
+    std::swap(alloc_, other.alloc_);
+}
+
+//the key is const in the item, so it is copied rather than moved
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::relocate(Item* from, Item* to)
+{
+    ::new (static_cast<void*>(to)) Item(from->first, std::move(from->second));
+    from->~Item();
+}
+
+template<class Key, class Value, class Compare, class Alloc, std::size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, Alloc, NodeBytes>::relocate(Key* from, Key* to)
+{
+    ::new (static_cast<void*>(to)) Key(std::move(*from));
+    from->~Key();
+}
+
+/*
+  ----------------------------------------
+  End implementations for the BPlusTree class.
+  ----------------------------------------
+*/
+
+#endif
@@ -0,0 +1,1902 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <queue>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <thread>
+#if __cplusplus >= 201703L
+#include <string_view>
+#include <shared_mutex>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "bst.h"
+#include "avlbst.h"
+#include "pool_alloc.h"
+#include "indexed_avlbst.h"
+#include "ranked_avlbst.h"
+#include "aggregate_avlbst.h"
+#include "frozen_map.h"
+#include "bplus_tree.h"
+#include "balanced_bst.h"
+#include "splay_bst.h"
+#include "weighted_avlbst.h"
+#include "concurrent_avlbst.h"
+
+using namespace std;
+
+/*
+ * Micro benchmarks for the search trees.
+ * Usage: ./bst-bench <benchmark> [n]
+ * Run without arguments to list the benchmarks.
+ */
+
+// wall clock timer, reports seconds since construction
+class BenchTimer
+{
+public:
+    BenchTimer() : start_(chrono::steady_clock::now()) { }
+    double seconds() const
+    {
+        return chrono::duration<double>(chrono::steady_clock::now() - start_).count();
+    }
+private:
+    chrono::steady_clock::time_point start_;
+};
+
+// n distinct keys in random order
+vector<uint64_t> shuffledKeys(size_t n, unsigned seed = 104)
+{
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        keys[i] = i * 2 + 1;   // odd keys, so even keys are guaranteed misses
+    }
+    mt19937_64 rng(seed);
+    shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+void report(const string& name, size_t ops, double secs)
+{
+    cout << left << setw(40) << name << right << setw(10) << fixed << setprecision(3) << secs << " s  "
+         << setw(10) << setprecision(2) << (ops / secs / 1e6) << " Mops/s" << endl;
+}
+
+// guards results so the optimizer cannot drop the measured loops
+volatile uint64_t benchSink;
+
+/*
+  ---------------------------------------------------------
+  Node layout: the old virtual node against the current one
+  ---------------------------------------------------------
+*/
+
+// A copy of the node layout before Node lost its vtable: virtual
+// destructor and virtual getters, overridden by the AVL node.
+struct LegacyNode
+{
+    LegacyNode(uint64_t k, uint64_t v) : item(k, v), parent(NULL), left(NULL), right(NULL) { }
+    virtual ~LegacyNode() { }
+    virtual LegacyNode* getParent() const { return parent; }
+    virtual LegacyNode* getLeft() const { return left; }
+    virtual LegacyNode* getRight() const { return right; }
+    pair<const uint64_t, uint64_t> item;
+    LegacyNode* parent;
+    LegacyNode* left;
+    LegacyNode* right;
+};
+
+struct LegacyAVLNode : public LegacyNode
+{
+    LegacyAVLNode(uint64_t k, uint64_t v) : LegacyNode(k, v), balance(0) { }
+    virtual LegacyAVLNode* getParent() const override { return static_cast<LegacyAVLNode*>(parent); }
+    virtual LegacyAVLNode* getLeft() const override { return static_cast<LegacyAVLNode*>(left); }
+    virtual LegacyAVLNode* getRight() const override { return static_cast<LegacyAVLNode*>(right); }
+    int8_t balance;
+};
+
+// clones the shape of an AVL subtree into legacy nodes
+LegacyNode* cloneLegacy(Node<uint64_t, uint64_t>* n, LegacyNode* parent)
+{
+    if(n == NULL)
+    {
+        return NULL;
+    }
+    LegacyNode* copy = new LegacyAVLNode(n->getKey(), n->getValue());
+    copy->parent = parent;
+    copy->left = cloneLegacy(n->getLeft(), copy);
+    copy->right = cloneLegacy(n->getRight(), copy);
+    return copy;
+}
+
+void freeLegacy(LegacyNode* n)
+{
+    if(n == NULL)
+    {
+        return;
+    }
+    freeLegacy(n->getLeft());
+    freeLegacy(n->getRight());
+    delete n;
+}
+
+LegacyNode* legacyFind(LegacyNode* current, uint64_t key)
+{
+    while(current != NULL)
+    {
+        if(key < current->item.first)
+        {
+            current = current->getLeft();
+        }
+        else if(key > current->item.first)
+        {
+            current = current->getRight();
+        }
+        else
+        {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+// exposes the root of an AVLTree to the benchmarks
+template<class Key, class Value, class Compare = std::less<Key>, class Alloc = std::allocator<std::pair<const Key, Value> > >
+class BenchAVLTree : public AVLTree<Key, Value, Compare, Alloc>
+{
+public:
+    Node<Key, Value>* root() const { return this->root_; }
+};
+
+typedef PoolAllocator<pair<const uint64_t, uint64_t> > BenchPool;
+
+void benchNodeLayout(size_t n)
+{
+    cout << "bytes per node (key/value = uint64_t):" << endl;
+    cout << "  legacy Node     " << sizeof(LegacyNode) << endl;
+    cout << "  legacy AVLNode  " << sizeof(LegacyAVLNode) << endl;
+    cout << "  Node            " << sizeof(Node<uint64_t, uint64_t>) << endl;
+    cout << "  AVLNode         " << sizeof(AVLNode<uint64_t, uint64_t>) << endl;
+
+    vector<uint64_t> keys = shuffledKeys(n);
+    BenchAVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    LegacyNode* legacyRoot = cloneLegacy(tree.root(), NULL);
+
+    // look the keys up in a different random order than they were inserted
+    shuffle(keys.begin(), keys.end(), mt19937_64(7));
+
+    uint64_t sum = 0;
+    BenchTimer legacyTimer;
+    for(size_t i = 0; i < n; ++i)
+    {
+        sum += legacyFind(legacyRoot, keys[i])->item.second;
+    }
+    report("find, legacy virtual node", n, legacyTimer.seconds());
+
+    BenchTimer timer;
+    for(size_t i = 0; i < n; ++i)
+    {
+        sum += tree.find(keys[i])->second;
+    }
+    report("find, AVLTree", n, timer.seconds());
+
+    benchSink = sum;
+    freeLegacy(legacyRoot);
+}
+
+/*
+  ----------------------------------------------------------
+  Node allocation: default heap against the NodePool slabs
+  ----------------------------------------------------------
+*/
+
+// fills the tree, then keeps its size constant while replacing keys,
+// and finally tears it down
+template<class Tree>
+void churn(const string& name, Tree& tree, size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(2 * n);
+
+    BenchTimer insertTimer;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    report(name + " insert", n, insertTimer.seconds());
+
+    // remove the oldest key and insert a new one: the tree size stays at n
+    BenchTimer churnTimer;
+    for(size_t i = n; i < 2 * n; ++i)
+    {
+        tree.remove(keys[i - n]);
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    report(name + " remove+insert", n, churnTimer.seconds());
+
+    // duplicate keys only overwrite values
+    BenchTimer updateTimer;
+    for(size_t i = n; i < 2 * n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i] + 1));
+    }
+    report(name + " insert existing key", n, updateTimer.seconds());
+
+    BenchTimer clearTimer;
+    tree.clear();
+    report(name + " clear", n, clearTimer.seconds());
+}
+
+void benchAlloc(size_t n)
+{
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        churn("heap", tree, n);
+    }
+    {
+        AVLTree<uint64_t, uint64_t, less<uint64_t>, BenchPool> tree;
+        churn("pool", tree, n);
+    }
+}
+
+/*
+  ------------------------------------------------------------------
+  Memory footprint of the node layout this binary was built with.
+  bst-bench-compact is the same benchmark built with AVL_COMPACT_NODES.
+  ------------------------------------------------------------------
+*/
+
+// bytes currently handed out by malloc, including its chunk overhead
+size_t heapInUse()
+{
+#ifdef __GLIBC__
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+void benchFootprint(size_t n)
+{
+#ifdef AVL_COMPACT_NODES
+    cout << "layout: compact, balance in the parent link" << endl;
+#else
+    cout << "layout: default, separate balance member" << endl;
+#endif
+    cout << "  AVLNode<uint64_t,uint64_t>     " << sizeof(AVLNode<uint64_t, uint64_t>) << " bytes" << endl;
+
+    vector<uint64_t> keys = shuffledKeys(n);
+    {
+        size_t before = heapInUse();
+        AVLTree<uint64_t, uint64_t> tree;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        size_t after = heapInUse();
+        if(after > before)
+        {
+            cout << "  heap bytes per entry           " << fixed << setprecision(1)
+                 << double(after - before) / n << endl;
+        }
+    }
+    {
+        BenchPool alloc;
+        AVLTree<uint64_t, uint64_t, less<uint64_t>, BenchPool> tree(alloc);
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        const NodePool& pool = alloc.pool();
+        cout << "  pool bytes per entry           " << fixed << setprecision(1)
+             << double(pool.slabCount() * pool.slabBytes()) / n << endl;
+    }
+}
+
+/*
+  -----------------------------------------------------------------
+  Pointer-linked AVLTree against the index-linked IndexedAVLTree.
+  For cache misses, run under e.g. perf stat -e cache-misses.
+  -----------------------------------------------------------------
+*/
+
+template<class Tree>
+void treeWorkload(const string& name, Tree& tree, const vector<uint64_t>& keys, const vector<uint64_t>& lookups)
+{
+    const size_t n = keys.size();
+
+    BenchTimer insertTimer;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    report(name + " insert", n, insertTimer.seconds());
+
+    uint64_t sum = 0;
+    BenchTimer findTimer;
+    for(size_t i = 0; i < n; ++i)
+    {
+        sum += tree.find(lookups[i])->second;
+    }
+    report(name + " find", n, findTimer.seconds());
+
+    BenchTimer scanTimer;
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it)
+    {
+        sum += it->second;
+    }
+    report(name + " full scan", n, scanTimer.seconds());
+
+    BenchTimer removeTimer;
+    for(size_t i = 0; i < n; i += 2)
+    {
+        tree.remove(lookups[i]);
+    }
+    report(name + " remove half", n / 2, removeTimer.seconds());
+
+    benchSink = sum;
+}
+
+// exposes the size of an IndexedAVLTree slot to the benchmarks
+template<class Key, class Value>
+class BenchIndexedTree : public IndexedAVLTree<Key, Value>
+{
+public:
+    static size_t nodeBytes() { return sizeof(typename IndexedAVLTree<Key, Value>::IndexNode); }
+};
+
+void benchIndexed(size_t n)
+{
+    cout << "bytes per node (key/value = uint64_t):" << endl;
+    cout << "  AVLNode          " << sizeof(AVLNode<uint64_t, uint64_t>) << endl;
+    cout << "  IndexedAVLTree   " << BenchIndexedTree<uint64_t, uint64_t>::nodeBytes() << endl;
+
+    vector<uint64_t> keys = shuffledKeys(n);
+    vector<uint64_t> lookups = keys;
+    shuffle(lookups.begin(), lookups.end(), mt19937_64(7));
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        treeWorkload("AVLTree", tree, keys, lookups);
+    }
+    {
+        IndexedAVLTree<uint64_t, uint64_t> tree;
+        treeWorkload("IndexedAVLTree", tree, keys, lookups);
+    }
+}
+
+/*
+  ---------------------------------------------------------------
+  Large string values: copying insert against the move/emplace API
+  ---------------------------------------------------------------
+*/
+
+void benchEmplace(size_t n)
+{
+    const string payload(1024, 'v');
+    vector<uint64_t> keys = shuffledKeys(n);
+
+    {
+        AVLTree<uint64_t, string> tree;
+        BenchTimer insertTimer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(keys[i], payload));
+        }
+        report("insert(pair), new keys", n, insertTimer.seconds());
+
+        BenchTimer updateTimer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(keys[i], payload));
+        }
+        report("insert(pair), existing keys", n, updateTimer.seconds());
+    }
+    {
+        AVLTree<uint64_t, string> tree;
+        BenchTimer insertTimer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.try_emplace(keys[i], payload.size(), 'v');
+        }
+        report("try_emplace, new keys", n, insertTimer.seconds());
+
+        BenchTimer updateTimer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            string value(payload);
+            tree.insert_or_assign(keys[i], std::move(value));
+        }
+        report("insert_or_assign(move), existing keys", n, updateTimer.seconds());
+
+        // an update that only needs to happen for absent keys: no node, no copy
+        BenchTimer tryTimer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.try_emplace(keys[i], payload.size(), 'v');
+        }
+        report("try_emplace, existing keys", n, tryTimer.seconds());
+    }
+}
+
+/*
+  ---------------------------------------------------------------
+  String keys: two comparisons per level against one three-way
+  comparison, and lookups that do or do not build a temporary key
+  ---------------------------------------------------------------
+*/
+
+// comparisons made by the comparators below
+uint64_t stringComparisons;
+
+// a plain less-than: every level of a search costs two string comparisons
+struct TwoWayStringLess
+{
+    bool operator()(const string& a, const string& b) const
+    {
+        ++stringComparisons;
+        return a < b;
+    }
+};
+
+// the same order through a three-way compare(): one comparison per level
+struct ThreeWayStringCompare
+{
+    bool operator()(const string& a, const string& b) const { return a < b; }
+    int compare(const string& a, const string& b) const
+    {
+        ++stringComparisons;
+        return a.compare(b);
+    }
+};
+
+// a borrowed key, like std::string_view
+struct KeyRef
+{
+    KeyRef(const string& s) : data(s.data()), size(s.size()) { }
+    // lets a tree without transparent lookup find a KeyRef, through a temporary string
+    operator string() const { return string(data, size); }
+    const char* data;
+    size_t size;
+};
+
+// three-way and transparent: finds a KeyRef without building a string
+struct TransparentStringCompare
+{
+    typedef void is_transparent;
+    bool operator()(const string& a, const string& b) const { return a < b; }
+    int compare(const string& a, const string& b) const { return a.compare(b); }
+    int compare(const KeyRef& a, const string& b) const { return -b.compare(0, string::npos, a.data, a.size); }
+};
+
+// keys sharing a long prefix, as paths or composite keys do
+vector<string> stringKeys(size_t n)
+{
+    vector<uint64_t> numbers = shuffledKeys(n);
+    vector<string> keys(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "customers/eu-west/accounts/%012llu", (unsigned long long)numbers[i]);
+        keys[i] = buffer;
+    }
+    return keys;
+}
+
+template<class Tree, class Probe>
+void stringWorkload(const string& name, const vector<string>& keys, const vector<Probe>& lookups)
+{
+    const size_t n = keys.size();
+    const size_t rounds = 5;
+    Tree tree;
+
+    BenchTimer insertTimer;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], (uint64_t)i));
+    }
+    report(name + " insert", n, insertTimer.seconds());
+
+    uint64_t sum = 0;
+    stringComparisons = 0;
+    BenchTimer findTimer;
+    for(size_t round = 0; round < rounds; ++round)
+    {
+        for(size_t i = 0; i < n; ++i)
+        {
+            sum += tree.find(lookups[i])->second;
+        }
+    }
+    report(name + " find", n * rounds, findTimer.seconds());
+    if(stringComparisons != 0)
+    {
+        cout << "  comparisons per find: " << setprecision(1) << (double)stringComparisons / (n * rounds) << endl;
+    }
+    benchSink = sum;
+}
+
+void benchStrings(size_t n)
+{
+    vector<string> keys = stringKeys(n);
+    vector<string> lookups = keys;
+    shuffle(lookups.begin(), lookups.end(), mt19937_64(7));
+    vector<KeyRef> refLookups(lookups.begin(), lookups.end());
+
+    stringWorkload<AVLTree<string, uint64_t, TwoWayStringLess> >("two-way Compare", keys, lookups);
+    stringWorkload<AVLTree<string, uint64_t, ThreeWayStringCompare> >("three-way Compare", keys, lookups);
+    stringWorkload<AVLTree<string, uint64_t> >("std::less", keys, lookups);
+    stringWorkload<AVLTree<string, uint64_t> >("std::less, find(KeyRef)", keys, refLookups);
+    stringWorkload<AVLTree<string, uint64_t, TransparentStringCompare> >("transparent, find(KeyRef)", keys, refLookups);
+#if __cplusplus >= 201703L
+    vector<string_view> viewLookups(lookups.begin(), lookups.end());
+    stringWorkload<AVLTree<string, uint64_t, less<> > >("less<>, find(string_view)", keys, viewLookups);
+#endif
+}
+
+/*
+  ----------------------------------------------------------
+  Cold start from a sorted snapshot: inserts against bulkLoad
+  ----------------------------------------------------------
+*/
+
+void benchBulkLoad(size_t n)
+{
+    vector<pair<uint64_t, uint64_t> > snapshot(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        snapshot[i] = make_pair(i * 2 + 1, i);
+    }
+
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(snapshot[i]);
+        }
+        report("insert, sorted input", n, timer.seconds());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        tree.bulkLoad(snapshot.begin(), snapshot.end());
+        report("bulkLoad", n, timer.seconds());
+    }
+    {
+        BenchPool alloc;
+        AVLTree<uint64_t, uint64_t, less<uint64_t>, BenchPool> tree(alloc);
+        BenchTimer timer;
+        tree.bulkLoad(snapshot.begin(), snapshot.end());
+        report("bulkLoad, PoolAllocator", n, timer.seconds());
+    }
+}
+
+/*
+  -----------------------------------------------------------------
+  Teardown: clear() against removing the root key until it is empty
+  -----------------------------------------------------------------
+*/
+
+void benchTeardown(size_t n)
+{
+    vector<pair<uint64_t, uint64_t> > snapshot(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        snapshot[i] = make_pair(i * 2 + 1, i);
+    }
+
+    {
+        BenchAVLTree<uint64_t, uint64_t> tree;
+        tree.bulkLoad(snapshot.begin(), snapshot.end());
+        // what clear() used to do
+        BenchTimer timer;
+        while(tree.root() != NULL)
+        {
+            tree.remove(tree.root()->getKey());
+        }
+        report("remove(root key) until empty", n, timer.seconds());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        tree.bulkLoad(snapshot.begin(), snapshot.end());
+        BenchTimer timer;
+        tree.clear();
+        report("clear()", n, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        {
+            AVLTree<uint64_t, uint64_t> tree(snapshot.begin(), snapshot.end());
+            timer = BenchTimer();
+        }
+        report("destructor", n, timer.seconds());
+    }
+}
+
+/*
+  ------------------------------------------------------------
+  Snapshots: re-inserting every entry against the copy/move API
+  ------------------------------------------------------------
+*/
+
+void benchCopy(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    AVLTree<uint64_t, uint64_t> source;
+    for(size_t i = 0; i < n; ++i)
+    {
+        source.insert(make_pair(keys[i], keys[i]));
+    }
+
+    {
+        BenchTimer timer;
+        AVLTree<uint64_t, uint64_t> copy;
+        for(AVLTree<uint64_t, uint64_t>::iterator it = source.begin(); it != source.end(); ++it)
+        {
+            copy.insert(*it);
+        }
+        report("copy by re-inserting", n, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        AVLTree<uint64_t, uint64_t> copy(source);
+        report("copy constructor", n, timer.seconds());
+
+        BenchTimer moveTimer;
+        AVLTree<uint64_t, uint64_t> moved(std::move(copy));
+        report("move constructor", 1, moveTimer.seconds());
+    }
+}
+
+/*
+  ----------------------------------------------------------------
+  Merging a delta into a base tree: insert loop against unionWith
+  ----------------------------------------------------------------
+*/
+
+// a base of n odd keys, and a delta of m keys, about half of them new
+void setOpsRound(size_t n, size_t m)
+{
+    vector<pair<uint64_t, uint64_t> > base(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        base[i] = make_pair(i * 2 + 1, i);
+    }
+    mt19937_64 rng(m);
+    vector<uint64_t> delta(m);
+    for(size_t i = 0; i < m; ++i)
+    {
+        delta[i] = rng() % (2 * n);
+    }
+
+    ostringstream label;
+    label << "n = " << n << ", m = " << m << ": ";
+    {
+        AVLTree<uint64_t, uint64_t> tree(base.begin(), base.end());
+        AVLTree<uint64_t, uint64_t> other;
+        for(size_t i = 0; i < m; ++i)
+        {
+            other.insert(make_pair(delta[i], delta[i]));
+        }
+        BenchTimer timer;
+        for(AVLTree<uint64_t, uint64_t>::iterator it = other.begin(); it != other.end(); ++it)
+        {
+            tree.insert(*it);
+        }
+        report(label.str() + "insert loop", m, timer.seconds());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree(base.begin(), base.end());
+        AVLTree<uint64_t, uint64_t> other;
+        for(size_t i = 0; i < m; ++i)
+        {
+            other.insert(make_pair(delta[i], delta[i]));
+        }
+        BenchTimer timer;
+        tree.unionWith(std::move(other));
+        report(label.str() + "unionWith", m, timer.seconds());
+    }
+}
+
+void benchSetOps(size_t n)
+{
+    setOpsRound(n, n / 1000);
+    setOpsRound(n, n / 10);
+    setOpsRound(n, n);
+}
+
+/*
+  ---------------------------------------------------------------
+  Order statistics: the cost of keeping subtree sizes, and select
+  against walking an iterator to the same position
+  ---------------------------------------------------------------
+*/
+
+void benchRanked(size_t n)
+{
+    cout << "bytes per node (key/value = uint64_t):" << endl;
+    cout << "  AVLNode          " << sizeof(AVLNode<uint64_t, uint64_t>) << endl;
+    cout << "  RankedAVLTree    " << sizeof(AVLNode<uint64_t, uint64_t, SubtreeSize>) << endl;
+
+    vector<uint64_t> keys = shuffledKeys(n);
+    vector<uint64_t> lookups = keys;
+    shuffle(lookups.begin(), lookups.end(), mt19937_64(7));
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        treeWorkload("AVLTree", tree, keys, lookups);
+    }
+
+    RankedAVLTree<uint64_t, uint64_t> tree;
+    treeWorkload("RankedAVLTree", tree, keys, lookups);
+
+    //positional queries on what is left: n/2 entries
+    const size_t size = tree.size();
+    const size_t walks = 100;
+    mt19937_64 rng(11);
+    uint64_t sum = 0;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < walks; ++i)
+        {
+            RankedAVLTree<uint64_t, uint64_t>::iterator it = tree.begin();
+            for(size_t steps = rng() % size; steps > 0; --steps)
+            {
+                ++it;
+            }
+            sum += it->first;
+        }
+        report("k-th entry by iterator walk", walks, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            sum += tree.select(rng() % size)->first;
+        }
+        report("k-th entry by select", n, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            sum += tree.rank(lookups[i]);
+        }
+        report("rank", n, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            sum += tree.countInRange(lookups[i], lookups[i] + 2000);
+        }
+        report("countInRange", n, timer.seconds());
+    }
+    benchSink = sum;
+}
+
+/*
+  ---------------------------------------------------------------
+  Range queries: filtering a full scan against forEachInRange and
+  lower_bound
+  ---------------------------------------------------------------
+*/
+
+void rangeScanRound(const AVLTree<uint64_t, uint64_t>& tree, size_t n, size_t width, size_t queries)
+{
+    mt19937_64 rng(width);
+    vector<uint64_t> lows(queries);
+    for(size_t i = 0; i < queries; ++i)
+    {
+        lows[i] = rng() % (2 * n);
+    }
+
+    //keys are odd, so a span of 2 * width holds width of them
+    ostringstream label;
+    label << "width " << width << ": ";
+    uint64_t sum = 0;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < queries; ++i)
+        {
+            const uint64_t high = lows[i] + 2 * width;
+            for(AVLTree<uint64_t, uint64_t>::const_iterator it = tree.begin(); it != tree.end(); ++it)
+            {
+                if(it->first >= lows[i] && it->first <= high)
+                {
+                    sum += it->second;
+                }
+            }
+        }
+        report(label.str() + "filtered full scan", queries, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < queries; ++i)
+        {
+            tree.forEachInRange(lows[i], lows[i] + 2 * width,
+                                [&sum](const pair<const uint64_t, uint64_t>& item) { sum += item.second; });
+        }
+        report(label.str() + "forEachInRange", queries, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < queries; ++i)
+        {
+            AVLTree<uint64_t, uint64_t>::const_iterator end = tree.upper_bound(lows[i] + 2 * width);
+            for(AVLTree<uint64_t, uint64_t>::const_iterator it = tree.lower_bound(lows[i]); it != end; ++it)
+            {
+                sum += it->second;
+            }
+        }
+        report(label.str() + "lower_bound/upper_bound", queries, timer.seconds());
+    }
+    benchSink = sum;
+}
+
+void benchRangeScan(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    AVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    rangeScanRound(tree, n, 10, 20);
+    rangeScanRound(tree, n, 1000, 20);
+    rangeScanRound(tree, n, n / 10, 20);
+}
+
+/*
+  -----------------------------------------------------------------
+  Range sums: summing a forEachInRange scan against the aggregates
+  kept by AggregateAVLTree, and what keeping them costs
+  -----------------------------------------------------------------
+*/
+
+void benchAggregate(size_t n)
+{
+    cout << "bytes per node (key/value = uint64_t):" << endl;
+    cout << "  AVLNode            " << sizeof(AVLNode<uint64_t, uint64_t>) << endl;
+    cout << "  AggregateAVLTree   " << sizeof(AVLNode<uint64_t, uint64_t, SubtreeAggregate<SumAggregate<uint64_t> > >) << endl;
+
+    vector<uint64_t> keys = shuffledKeys(n);
+    vector<uint64_t> lookups = keys;
+    shuffle(lookups.begin(), lookups.end(), mt19937_64(7));
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        treeWorkload("AVLTree", tree, keys, lookups);
+    }
+    AggregateAVLTree<uint64_t, uint64_t> tree;
+    treeWorkload("AggregateAVLTree", tree, keys, lookups);
+
+    uint64_t sum = 0;
+    {
+        BenchTimer timer;
+        for(size_t i = 1; i < n; i += 2)
+        {
+            tree.setValue(lookups[i], i);
+        }
+        report("setValue", n / 2, timer.seconds());
+    }
+
+    const size_t widths[] = { 10, 1000, n / 10 };
+    const size_t queries = 1000;
+    for(size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+    {
+        ostringstream label;
+        label << "width " << widths[w] << ": ";
+        {
+            BenchTimer timer;
+            for(size_t i = 0; i < queries; ++i)
+            {
+                tree.forEachInRange(lookups[i], lookups[i] + 2 * widths[w],
+                                    [&sum](const pair<const uint64_t, uint64_t>& item) { sum += item.second; });
+            }
+            report(label.str() + "forEachInRange sum", queries, timer.seconds());
+        }
+        {
+            BenchTimer timer;
+            for(size_t i = 0; i < queries; ++i)
+            {
+                sum += tree.aggregate(lookups[i], lookups[i] + 2 * widths[w]);
+            }
+            report(label.str() + "aggregate", queries, timer.seconds());
+        }
+    }
+    benchSink = sum;
+}
+
+/*
+  ---------------------------------------------------------------
+  The latest N entries: copying the tree into a vector to walk it
+  backwards against a reverse_iterator
+  ---------------------------------------------------------------
+*/
+
+void benchReverse(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    AVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    const AVLTree<uint64_t, uint64_t>& constTree = tree;
+
+    const size_t latest = 100;
+    const size_t queries = 20;
+    uint64_t sum = 0;
+    {
+        BenchTimer timer;
+        for(size_t q = 0; q < queries; ++q)
+        {
+            vector<pair<uint64_t, uint64_t> > copy(constTree.begin(), constTree.end());
+            for(size_t i = 0; i < latest; ++i)
+            {
+                sum += copy[copy.size() - 1 - i].second;
+            }
+        }
+        report("latest 100 via a vector copy", queries, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t q = 0; q < queries; ++q)
+        {
+            AVLTree<uint64_t, uint64_t>::const_reverse_iterator it = constTree.rbegin();
+            for(size_t i = 0; i < latest; ++i, ++it)
+            {
+                sum += it->second;
+            }
+        }
+        report("latest 100 via rbegin()", queries, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(AVLTree<uint64_t, uint64_t>::const_reverse_iterator it = constTree.rbegin(); it != constTree.rend(); ++it)
+        {
+            sum += it->second;
+        }
+        report("full reverse scan", n, timer.seconds());
+    }
+    benchSink = sum;
+}
+
+/*
+  ------------------------------------------------------------------
+  Full scans: the successor walk against threaded in-order links.
+  Run "make scan" to get both layouts.
+  ------------------------------------------------------------------
+*/
+
+void benchScan(size_t n)
+{
+#ifdef BST_THREADED_NODES
+    cout << "layout: threaded, next/prev links in every node" << endl;
+#else
+    cout << "layout: default, successor walk" << endl;
+#endif
+    cout << "  AVLNode<uint64_t,uint64_t>     " << sizeof(AVLNode<uint64_t, uint64_t>) << " bytes" << endl;
+
+    vector<uint64_t> keys = shuffledKeys(n);
+    AVLTree<uint64_t, uint64_t> tree;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        report("insert", n, timer.seconds());
+    }
+    const AVLTree<uint64_t, uint64_t>& constTree = tree;
+
+    const size_t rounds = 10;
+    uint64_t sum = 0;
+    {
+        BenchTimer timer;
+        for(size_t r = 0; r < rounds; ++r)
+        {
+            for(AVLTree<uint64_t, uint64_t>::const_iterator it = constTree.begin(); it != constTree.end(); ++it)
+            {
+                sum += it->second;
+            }
+        }
+        report("forward scan x10", n * rounds, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t r = 0; r < rounds; ++r)
+        {
+            for(AVLTree<uint64_t, uint64_t>::const_reverse_iterator it = constTree.rbegin(); it != constTree.rend(); ++it)
+            {
+                sum += it->second;
+            }
+        }
+        report("reverse scan x10", n * rounds, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t r = 0; r < rounds; ++r)
+        {
+            constTree.forEachInRange(0, 2 * n, [&sum](const pair<const uint64_t, uint64_t>& item) { sum += item.second; });
+        }
+        report("forEachInRange over all keys x10", n * rounds, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.remove(keys[i]);
+        }
+        report("remove", n, timer.seconds());
+    }
+    benchSink = sum;
+}
+
+/*
+  ----------------------------------------------------------------
+  A deadline queue: pop the earliest deadline, schedule a new one.
+  std::priority_queue against the tree with and without popMin().
+  ----------------------------------------------------------------
+*/
+
+// deadline in the high bits, a sequence number below to keep keys distinct
+uint64_t deadlineKey(uint64_t deadline, uint64_t seq)
+{
+    return (deadline << 24) | (seq & 0xffffff);
+}
+
+void benchDeadlines(size_t n)
+{
+    const size_t ops = 1000000;
+    mt19937_64 rng(16);
+    vector<uint64_t> delays(n + ops);
+    for(size_t i = 0; i < delays.size(); ++i)
+    {
+        delays[i] = 1 + rng() % 1000000;
+    }
+
+    uint64_t sum = 0;
+    {
+        priority_queue<uint64_t, vector<uint64_t>, greater<uint64_t> > queue;
+        for(size_t i = 0; i < n; ++i)
+        {
+            queue.push(deadlineKey(delays[i], i));
+        }
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i)
+        {
+            uint64_t now = queue.top() >> 24;
+            queue.pop();
+            sum += now;
+            queue.push(deadlineKey(now + delays[n + i], n + i));
+        }
+        report("std::priority_queue", ops, timer.seconds());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(deadlineKey(delays[i], i), i));
+        }
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i)
+        {
+            //a walk down to the smallest key, then remove() finds it again
+            uint64_t key = tree.lower_bound(0)->first;
+            tree.remove(key);
+            uint64_t now = key >> 24;
+            sum += now;
+            tree.insert(make_pair(deadlineKey(now + delays[n + i], n + i), i));
+        }
+        report("AVLTree: lower_bound(0) + remove(key)", ops, timer.seconds());
+    }
+    {
+        //a scheduler polls the earliest deadline far more often than it pops it
+        AVLTree<uint64_t, uint64_t> tree;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(deadlineKey(delays[i], i), i));
+        }
+        BenchTimer walk;
+        for(size_t i = 0; i < ops; ++i)
+        {
+            sum += tree.lower_bound(0)->second;
+        }
+        report("peek: lower_bound(0)", ops, walk.seconds());
+        BenchTimer cached;
+        for(size_t i = 0; i < ops; ++i)
+        {
+            sum += tree.front().second;
+        }
+        report("peek: front()", ops, cached.seconds());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(deadlineKey(delays[i], i), i));
+        }
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i)
+        {
+            uint64_t now = tree.popMin().first >> 24;
+            sum += now;
+            tree.insert(make_pair(deadlineKey(now + delays[n + i], n + i), i));
+        }
+        report("AVLTree: popMin()", ops, timer.seconds());
+    }
+    benchSink = sum;
+}
+
+/*
+  ---------------------------------------------------------------
+  Nearly sorted ingest: insert from the root against insert with
+  end() or the last inserted entry as the hint
+  ---------------------------------------------------------------
+*/
+
+void hintedRound(const string& stream, const vector<uint64_t>& keys)
+{
+    const size_t n = keys.size();
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        report(stream + ": insert(kv)", n, timer.seconds());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(tree.end(), make_pair(keys[i], keys[i]));
+        }
+        report(stream + ": insert(end(), kv)", n, timer.seconds());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        AVLTree<uint64_t, uint64_t>::iterator last = tree.end();
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            last = tree.insert(last, make_pair(keys[i], keys[i]));
+        }
+        report(stream + ": insert(last, kv)", n, timer.seconds());
+    }
+}
+
+void benchHinted(size_t n)
+{
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        keys[i] = i * 256;
+    }
+    hintedRound("monotonic", keys);
+
+    //timestamps that arrive up to ~8 positions out of order
+    mt19937_64 rng(17);
+    for(size_t i = 0; i < n; ++i)
+    {
+        keys[i] = i * 256 + rng() % 2048;
+    }
+    hintedRound("jittered", keys);
+
+    hintedRound("random", shuffledKeys(n));
+}
+
+/*
+  ---------------------------------------------------------------
+  Batched lookups: a loop of find() against findBatch, 256 keys per
+  request, on a tree far larger than the last level cache
+  ---------------------------------------------------------------
+*/
+
+void benchBatch(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    AVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    const AVLTree<uint64_t, uint64_t>& constTree = tree;
+
+    //half hits, half misses, in random order
+    const size_t queries = 2000000;
+    const size_t batch = 256;
+    mt19937_64 rng(18);
+    vector<uint64_t> lookups(queries);
+    for(size_t i = 0; i < queries; ++i)
+    {
+        lookups[i] = rng() % (2 * n);
+    }
+
+    vector<AVLTree<uint64_t, uint64_t>::const_iterator> results(batch);
+    uint64_t found = 0;
+    {
+        BenchTimer timer;
+        for(size_t q = 0; q + batch <= queries; q += batch)
+        {
+            for(size_t i = 0; i < batch; ++i)
+            {
+                results[i] = constTree.find(lookups[q + i]);
+            }
+            for(size_t i = 0; i < batch; ++i)
+            {
+                found += (results[i] != constTree.end());
+            }
+        }
+        report("find() loop", queries, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t q = 0; q + batch <= queries; q += batch)
+        {
+            constTree.findBatch(lookups.begin() + q, lookups.begin() + q + batch, results.begin());
+            for(size_t i = 0; i < batch; ++i)
+            {
+                found += (results[i] != constTree.end());
+            }
+        }
+        report("findBatch", queries, timer.seconds());
+    }
+    benchSink = found;
+}
+
+/*
+  ------------------------------------------------------------------
+  Read-only data: the live AVLTree and std::map against its frozen,
+  Eytzinger laid out FrozenMap. Try n up to 100M where memory allows.
+  ------------------------------------------------------------------
+*/
+
+void benchFrozen(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    AVLTree<uint64_t, uint64_t> tree;
+    map<uint64_t, uint64_t> stdMap;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+        stdMap.insert(make_pair(keys[i], keys[i]));
+    }
+    BenchTimer freezeTimer;
+    FrozenMap<uint64_t, uint64_t> frozen = tree.freeze();
+    report("freeze()", n, freezeTimer.seconds());
+    const AVLTree<uint64_t, uint64_t>& constTree = tree;
+
+    const size_t points = 1000000;
+    const size_t ranges = 100000;
+    const uint64_t width = 200;     // about 100 keys per range
+    mt19937_64 rng(19);
+    vector<uint64_t> lookups(points);
+    for(size_t i = 0; i < points; ++i)
+    {
+        lookups[i] = rng() % (2 * n);
+    }
+
+    uint64_t sum = 0;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < points; ++i)
+        {
+            sum += (constTree.find(lookups[i]) != constTree.end());
+        }
+        report("point: AVLTree::find", points, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < points; ++i)
+        {
+            sum += (stdMap.find(lookups[i]) != stdMap.end());
+        }
+        report("point: std::map::find", points, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < points; ++i)
+        {
+            sum += (frozen.find(lookups[i]) != frozen.end());
+        }
+        report("point: FrozenMap::find", points, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < ranges; ++i)
+        {
+            constTree.forEachInRange(lookups[i], lookups[i] + width,
+                                     [&sum](const pair<const uint64_t, uint64_t>& item) { sum += item.second; });
+        }
+        report("range: AVLTree::forEachInRange", ranges, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < ranges; ++i)
+        {
+            for(map<uint64_t, uint64_t>::const_iterator it = stdMap.lower_bound(lookups[i]);
+                it != stdMap.end() && it->first <= lookups[i] + width; ++it)
+            {
+                sum += it->second;
+            }
+        }
+        report("range: std::map::lower_bound", ranges, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < ranges; ++i)
+        {
+            frozen.forEachInRange(lookups[i], lookups[i] + width, [&sum](const uint64_t&, const uint64_t& value) { sum += value; });
+        }
+        report("range: FrozenMap::forEachInRange", ranges, timer.seconds());
+    }
+    benchSink = sum;
+}
+
+/*
+  -----------------------------------------------------------------
+  Node layout after churn: random lookups on a tree whose nodes have
+  been scattered by removes and re-inserts, before and after relayout()
+  -----------------------------------------------------------------
+*/
+
+void benchRelayout(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    AVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i)
+    {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+
+    //2n removes and re-inserts, in batches so that freed nodes come back in a different order
+    mt19937_64 rng(20);
+    const size_t batch = 1024;
+    vector<uint64_t> evicted(batch);
+    for(size_t done = 0; done < 2 * n; done += batch)
+    {
+        for(size_t i = 0; i < batch; ++i)
+        {
+            evicted[i] = keys[rng() % n];
+            tree.remove(evicted[i]);
+        }
+        shuffle(evicted.begin(), evicted.end(), rng);
+        for(size_t i = 0; i < batch; ++i)
+        {
+            tree.insert(make_pair(evicted[i], evicted[i]));
+        }
+    }
+    const AVLTree<uint64_t, uint64_t>& constTree = tree;
+
+    const size_t queries = 1000000;
+    vector<uint64_t> lookups(queries);
+    for(size_t i = 0; i < queries; ++i)
+    {
+        lookups[i] = rng() % (2 * n);
+    }
+
+    uint64_t found = 0;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < queries; ++i)
+        {
+            found += (constTree.find(lookups[i]) != constTree.end());
+        }
+        report("find() after churn", queries, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        tree.relayout();
+        report("relayout()", n, timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < queries; ++i)
+        {
+            found += (constTree.find(lookups[i]) != constTree.end());
+        }
+        report("find() after relayout()", queries, timer.seconds());
+    }
+    benchSink = found;
+}
+
+/*
+  ---------------------------------------------------------------
+  B+-tree against AVL tree: random inserts, lookups (half of them
+  misses), a full scan and random removes, on the same keys
+  ---------------------------------------------------------------
+*/
+
+template<typename Tree>
+void bplusRound(const string& name, const vector<uint64_t>& keys, const vector<uint64_t>& lookups)
+{
+    Tree tree;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < keys.size(); ++i)
+        {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        report(name + ": insert", keys.size(), timer.seconds());
+    }
+    const Tree& constTree = tree;
+    uint64_t sum = 0;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < lookups.size(); ++i)
+        {
+            sum += (constTree.find(lookups[i]) != constTree.end());
+        }
+        report(name + ": find", lookups.size(), timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(typename Tree::const_iterator it = constTree.begin(); it != constTree.end(); ++it)
+        {
+            sum += it->second;
+        }
+        report(name + ": scan", keys.size(), timer.seconds());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < keys.size(); i += 2)
+        {
+            tree.remove(keys[i]);
+        }
+        report(name + ": remove half", keys.size() / 2, timer.seconds());
+    }
+    benchSink = sum;
+}
+
+void benchBPlus(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    const size_t queries = 2000000;
+    mt19937_64 rng(21);
+    vector<uint64_t> lookups(queries);
+    for(size_t i = 0; i < queries; ++i)
+    {
+        lookups[i] = rng() % (2 * n);
+    }
+    bplusRound<AVLTree<uint64_t, uint64_t> >("AVLTree", keys, lookups);
+    bplusRound<BPlusTree<uint64_t, uint64_t> >("BPlusTree", keys, lookups);
+    bplusRound<BPlusTree<uint64_t, uint64_t, less<uint64_t>, allocator<pair<const uint64_t, uint64_t> >, 256> >("BPlusTree, 256 byte nodes", keys, lookups);
+}
+
+/*
+  ------------------------------------------------------------
+  Balancing policies: building a tree, then a lookup-heavy and
+  a remove-heavy mix of operations on it, at a constant size
+  ------------------------------------------------------------
+*/
+
+template<typename Tree>
+void policyRound(const string& name, const vector<uint64_t>& keys, const vector<uint64_t>& probes)
+{
+    const size_t n = keys.size();
+    Tree tree;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i)
+        {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        report(name + ": insert", n, timer.seconds());
+    }
+    //the tree holds keys[live, live + n) of the keys cycled through
+    size_t live = 0;
+    uint64_t found = 0;
+    {
+        //per 20 operations: 18 finds, one remove of the oldest key and one insert of a new one
+        BenchTimer timer;
+        for(size_t i = 0; i < probes.size(); ++i)
+        {
+            if(i % 20 < 18)
+            {
+                found += (tree.find(probes[i]) != tree.end());
+            }
+            else if(i % 20 == 18)
+            {
+                tree.remove(keys[live % n] + 2 * n * (live / n));
+            }
+            else
+            {
+                const uint64_t key = keys[live % n] + 2 * n * (live / n + 1);
+                tree.insert(make_pair(key, key));
+                ++live;
+            }
+        }
+        report(name + ": 90% find", probes.size(), timer.seconds());
+    }
+    {
+        //every other operation a remove, the others inserts
+        BenchTimer timer;
+        for(size_t i = 0; i < probes.size(); i += 2)
+        {
+            tree.remove(keys[live % n] + 2 * n * (live / n));
+            const uint64_t key = keys[live % n] + 2 * n * (live / n + 1);
+            tree.insert(make_pair(key, key));
+            ++live;
+        }
+        report(name + ": 50% remove", probes.size(), timer.seconds());
+    }
+    benchSink = found;
+}
+
+void benchPolicies(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    const size_t ops = 2000000;
+    mt19937_64 rng(22);
+    vector<uint64_t> probes(ops);
+    for(size_t i = 0; i < ops; ++i)
+    {
+        probes[i] = rng() % (2 * n);
+    }
+    policyRound<BalancedTree<uint64_t, uint64_t, AVLBalance> >("AVL", keys, probes);
+    policyRound<BalancedTree<uint64_t, uint64_t, RedBlackBalance> >("red-black", keys, probes);
+    policyRound<BalancedTree<uint64_t, uint64_t, WAVLBalance> >("WAVL", keys, probes);
+    policyRound<BalancedTree<uint64_t, uint64_t, TreapBalance> >("treap", keys, probes);
+}
+
+/*
+  ----------------------------------------------------------
+  Skewed lookups: Zipfian key popularity with a few exponents,
+  AVLTree against SplayTree with its splaying settings
+  ----------------------------------------------------------
+*/
+
+// count draws from keys, keys[i] with a probability proportional to 1 / (i + 1)^skew
+vector<uint64_t> zipfianDraws(const vector<uint64_t>& keys, double skew, size_t count, unsigned seed)
+{
+    vector<double> cdf(keys.size());
+    double total = 0;
+    for(size_t i = 0; i < keys.size(); ++i)
+    {
+        total += 1.0 / pow(double(i + 1), skew);
+        cdf[i] = total;
+    }
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> uniform(0, total);
+    vector<uint64_t> draws(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        const size_t rank = lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+        draws[i] = keys[min(rank, keys.size() - 1)];
+    }
+    return draws;
+}
+
+template<typename Tree>
+void skewedRound(const string& name, Tree& tree, const vector<uint64_t>& lookups)
+{
+    uint64_t sum = 0;
+    BenchTimer timer;
+    for(size_t i = 0; i < lookups.size(); ++i)
+    {
+        sum += tree.find(lookups[i])->second;
+    }
+    report(name, lookups.size(), timer.seconds());
+    benchSink = sum;
+}
+
+void benchSplay(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    AVLTree<uint64_t, uint64_t> avl;
+    SplayTree<uint64_t, uint64_t> splay;
+    for(size_t i = 0; i < n; ++i)
+    {
+        avl.insert(make_pair(keys[i], keys[i]));
+        splay.insert(make_pair(keys[i], keys[i]));
+    }
+    vector<uint64_t> hottest(keys.begin(), keys.begin() + min<size_t>(4096, n));
+    sort(hottest.begin(), hottest.end());
+    const double skews[] = { 0.6, 0.9, 1.1, 1.3 };
+    for(size_t s = 0; s < sizeof(skews) / sizeof(skews[0]); ++s)
+    {
+        vector<uint64_t> lookups = zipfianDraws(keys, skews[s], 2000000, 23);
+        //how much of the traffic the 4096 most popular keys get
+        size_t hot = 0;
+        for(size_t i = 0; i < lookups.size(); ++i)
+        {
+            hot += binary_search(hottest.begin(), hottest.end(), lookups[i]);
+        }
+        ostringstream title;
+        title << "skew " << skews[s] << ", " << (100 * hot / lookups.size()) << "% of lookups on 4096 keys";
+        cout << title.str() << endl;
+
+        skewedRound("  AVLTree", avl, lookups);
+        splay.setSplaying(SplayMode::FULL);
+        skewedRound("  SplayTree", splay, lookups);
+        splay.setSplaying(SplayMode::SEMI);
+        skewedRound("  SplayTree, semi-splaying", splay, lookups);
+        splay.setSplaying(SplayMode::FULL, 8);
+        skewedRound("  SplayTree, every 8th lookup", splay, lookups);
+    }
+}
+
+/*
+  -----------------------------------------------------------
+  Access-weighted reshaping: lookups at several Zipfian skews
+  before and after optimizeForAccessPattern, and what the
+  first write after it costs
+  -----------------------------------------------------------
+*/
+
+void benchWeighted(size_t n)
+{
+    vector<uint64_t> keys = shuffledKeys(n);
+    const double skews[] = { 0.9, 1.1, 1.3 };
+    for(size_t s = 0; s < sizeof(skews) / sizeof(skews[0]); ++s)
+    {
+        cout << "skew " << skews[s] << endl;
+        vector<uint64_t> training = zipfianDraws(keys, skews[s], 2000000, 24);
+        vector<uint64_t> lookups = zipfianDraws(keys, skews[s], 2000000, 25);
+        AVLTree<uint64_t, uint64_t> plain;
+        WeightedAVLTree<uint64_t, uint64_t> weighted;
+        for(size_t i = 0; i < n; ++i)
+        {
+            plain.insert(make_pair(keys[i], keys[i]));
+            weighted.insert(make_pair(keys[i], keys[i]));
+        }
+        skewedRound("  AVLTree find()", plain, lookups);
+        skewedRound("  WeightedAVLTree find(), counting", weighted, training);
+        AccessPatternReport expected;
+        {
+            BenchTimer timer;
+            expected = weighted.optimizeForAccessPattern();
+            report("  optimizeForAccessPattern()", n, timer.seconds());
+        }
+        cout << "  expected depth " << setprecision(2) << expected.expectedDepthBefore << " -> "
+             << expected.expectedDepthAfter << endl;
+        skewedRound("  WeightedAVLTree find(), optimized", weighted, lookups);
+        {
+            BenchTimer timer;
+            weighted.insert(make_pair(2 * n + 1, 0));
+            report("  first insert after it", 1, timer.seconds());
+        }
+    }
+}
+
+/*
+  ---------------------------------------------------------------
+  Concurrent access: lookup-only, lookup-heavy and write-heavy
+  mixes on 1 to 64 threads, AVLTree behind a lock against
+  ConcurrentAVLTree. Scaling needs as many cores as threads.
+  ---------------------------------------------------------------
+*/
+
+// what each entry of a thread's op list does, in its low two bits
+enum ConcurrentOp { OP_FIND = 0, OP_INSERT = 1, OP_REMOVE = 2 };
+
+// total ops split over the threads: readPercent% finds, the rest half
+// inserts and half removes, of random keys below keySpace
+vector<vector<uint64_t> > concurrentOps(size_t threads, size_t total, uint64_t keySpace, unsigned readPercent, unsigned seed)
+{
+    mt19937_64 rng(seed);
+    vector<vector<uint64_t> > ops(threads);
+    for(size_t t = 0; t < threads; ++t)
+    {
+        ops[t].resize(total / threads);
+        for(size_t i = 0; i < ops[t].size(); ++i)
+        {
+            const uint64_t key = rng() % keySpace;
+            const unsigned roll = rng() % 100;
+            const uint64_t op = (roll < readPercent) ? OP_FIND : (roll % 2 == 0 ? OP_INSERT : OP_REMOVE);
+            ops[t][i] = (key << 2) | op;
+        }
+    }
+    return ops;
+}
+
+// runs worker(t) on one thread per op list and reports the wall time
+template<typename Worker>
+void concurrentRound(const string& name, const vector<vector<uint64_t> >& ops, Worker worker)
+{
+    vector<thread> threads;
+    BenchTimer timer;
+    for(size_t t = 0; t < ops.size(); ++t)
+    {
+        threads.push_back(thread(worker, t));
+    }
+    for(size_t t = 0; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+    report(name, ops.size() * ops[0].size(), timer.seconds());
+}
+
+void benchConcurrent(size_t n)
+{
+    cout << "hardware threads: " << thread::hardware_concurrency() << endl;
+    vector<uint64_t> keys = shuffledKeys(2 * n);
+    const unsigned readPercents[] = { 100, 90, 50 };
+    const size_t threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    for(size_t m = 0; m < sizeof(readPercents) / sizeof(readPercents[0]); ++m)
+    {
+        cout << readPercents[m] << "% finds, " << n << " ops" << endl;
+        AVLTree<uint64_t, uint64_t> avl;
+        ConcurrentAVLTree<uint64_t, uint64_t> concurrent;
+        for(size_t i = 0; i < n; ++i)
+        {
+            avl.insert(make_pair(keys[i], keys[i]));
+            concurrent.insert(make_pair(keys[i], keys[i]));
+        }
+        for(size_t c = 0; c < sizeof(threadCounts) / sizeof(threadCounts[0]); ++c)
+        {
+            const vector<vector<uint64_t> > ops = concurrentOps(threadCounts[c], n, 2 * n, readPercents[m], 26 + c);
+            vector<uint64_t> sums(ops.size(), 0);
+            ostringstream threadsLabel;
+            threadsLabel << ", " << ops.size() << (ops.size() == 1 ? " thread" : " threads");
+
+            mutex avlLock;
+            concurrentRound("  AVLTree, std::mutex" + threadsLabel.str(), ops, [&](size_t t) {
+                uint64_t sum = 0;
+                for(size_t i = 0; i < ops[t].size(); ++i)
+                {
+                    const uint64_t key = ops[t][i] >> 2;
+                    lock_guard<mutex> guard(avlLock);
+                    switch(ops[t][i] & 3)
+                    {
+                    case OP_FIND:
+                    {
+                        AVLTree<uint64_t, uint64_t>::iterator it = avl.find(key);
+                        sum += (it != avl.end()) ? it->second : 0;
+                        break;
+                    }
+                    case OP_INSERT:
+                        avl.insert(make_pair(key, key));
+                        break;
+                    default:
+                        avl.remove(key);
+                    }
+                }
+                sums[t] += sum;
+            });
+
+#if __cplusplus >= 201703L
+            shared_mutex avlSharedLock;
+            concurrentRound("  AVLTree, std::shared_mutex" + threadsLabel.str(), ops, [&](size_t t) {
+                uint64_t sum = 0;
+                for(size_t i = 0; i < ops[t].size(); ++i)
+                {
+                    const uint64_t key = ops[t][i] >> 2;
+                    if((ops[t][i] & 3) == OP_FIND)
+                    {
+                        shared_lock<shared_mutex> guard(avlSharedLock);
+                        AVLTree<uint64_t, uint64_t>::iterator it = avl.find(key);
+                        sum += (it != avl.end()) ? it->second : 0;
+                        continue;
+                    }
+                    lock_guard<shared_mutex> guard(avlSharedLock);
+                    if((ops[t][i] & 3) == OP_INSERT)
+                    {
+                        avl.insert(make_pair(key, key));
+                    }
+                    else
+                    {
+                        avl.remove(key);
+                    }
+                }
+                sums[t] += sum;
+            });
+#endif
+
+            concurrentRound("  ConcurrentAVLTree" + threadsLabel.str(), ops, [&](size_t t) {
+                uint64_t sum = 0;
+                uint64_t value;
+                for(size_t i = 0; i < ops[t].size(); ++i)
+                {
+                    const uint64_t key = ops[t][i] >> 2;
+                    switch(ops[t][i] & 3)
+                    {
+                    case OP_FIND:
+                        sum += concurrent.find(key, value) ? value : 0;
+                        break;
+                    case OP_INSERT:
+                        concurrent.insert(make_pair(key, key));
+                        break;
+                    default:
+                        concurrent.remove(key);
+                    }
+                }
+                sums[t] += sum;
+            });
+            concurrent.reclaim();
+
+            for(size_t t = 0; t < sums.size(); ++t)
+            {
+                benchSink += sums[t];
+            }
+        }
+    }
+}
+
+/*
+  ---------------------------
+  Benchmark table and driver.
+  ---------------------------
+*/
+
+struct Benchmark
+{
+    const char* name;
+    void (*run)(size_t n);
+    size_t defaultSize;
+    const char* description;
+};
+
+const Benchmark benchmarks[] = {
+    { "node-layout", benchNodeLayout, 10000000, "node sizes and find() against the legacy virtual node" },
+    { "alloc",       benchAlloc,       1000000,  "insert/remove churn, default heap against PoolAllocator" },
+    { "footprint",   benchFootprint,   1000000,  "bytes per entry of AVLTree<uint64_t,uint64_t>" },
+    { "indexed",     benchIndexed,     1000000,  "AVLTree against the 32-bit index based IndexedAVLTree" },
+    { "emplace",     benchEmplace,     200000,   "1 KiB string values: insert(pair) against try_emplace/insert_or_assign" },
+    { "strings",     benchStrings,     500000,   "string keys: two-way against three-way Compare, transparent find" },
+    { "bulkload",    benchBulkLoad,    5000000,  "building from sorted input: one insert per key against bulkLoad" },
+    { "teardown",    benchTeardown,    10000000, "freeing a tree: clear() and the destructor against per-key remove()" },
+    { "copy",        benchCopy,        2000000,  "snapshots: re-inserting every entry against the copy constructor" },
+    { "setops",      benchSetOps,      1000000,  "merging a delta of n/1000, n/10 and n keys: insert loop against unionWith" },
+    { "rangescan",   benchRangeScan,   1000000,  "range queries of 10, 1000 and n/10 keys: filtered scan against forEachInRange" },
+    { "aggregate",   benchAggregate,   1000000,  "range sums: forEachInRange against AggregateAVLTree::aggregate, and its upkeep" },
+    { "reverse",     benchReverse,     1000000,  "the latest 100 entries: copying into a vector against rbegin()" },
+    { "scan",        benchScan,        1000000,  "full forward/reverse scans and their upkeep; compare with bst-bench-threaded" },
+    { "deadlines",   benchDeadlines,   100000,   "n pending deadlines, 1M pop+push: std::priority_queue against AVLTree" },
+    { "hinted",      benchHinted,      1000000,  "monotonic, jittered and random keys: insert(kv) against insert(hint, kv)" },
+    { "batch",       benchBatch,       8000000,  "2M lookups in batches of 256: a find() loop against findBatch" },
+    { "frozen",      benchFrozen,      1000000,  "point and range lookups: AVLTree and std::map against FrozenMap" },
+    { "relayout",    benchRelayout,    1000000,  "1M random lookups after 2n removes/re-inserts, before and after relayout()" },
+    { "bplus",       benchBPlus,       4000000,  "insert, 2M finds, scan and remove: AVLTree against BPlusTree" },
+    { "policies",    benchPolicies,    1000000,  "AVL, red-black, WAVL and treap: inserts, then 2M ops at 90% finds and at 50% removes" },
+    { "splay",       benchSplay,       1000000,  "2M Zipfian lookups at several skews: AVLTree against SplayTree settings" },
+    { "weighted",    benchWeighted,    1000000,  "Zipfian lookups before/after WeightedAVLTree::optimizeForAccessPattern" },
+    { "concurrent",  benchConcurrent,  1000000,  "0%, 10% and 50% writes on 1 to 64 threads: AVLTree behind a lock against ConcurrentAVLTree" },
+    { "ranked",      benchRanked,      1000000,  "subtree size upkeep in RankedAVLTree, select/rank against an iterator walk" },
+};
+
+int main(int argc, char *argv[])
+{
+    const size_t numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    if(argc < 2)
+    {
+        cout << "usage: " << argv[0] << " <benchmark> [n]" << endl;
+        for(size_t i = 0; i < numBenchmarks; ++i)
+        {
+            cout << "  " << left << setw(20) << benchmarks[i].name << benchmarks[i].description
+                 << " (default n = " << benchmarks[i].defaultSize << ")" << endl;
+        }
+        return 1;
+    }
+    for(size_t i = 0; i < numBenchmarks; ++i)
+    {
+        if(strcmp(argv[1], benchmarks[i].name) == 0)
+        {
+            size_t n = (argc > 2) ? strtoull(argv[2], NULL, 10) : benchmarks[i].defaultSize;
+            cout << benchmarks[i].name << ", n = " << n << endl;
+            benchmarks[i].run(n);
+            return 0;
+        }
+    }
+    cout << "unknown benchmark " << argv[1] << endl;
+    return 1;
+}
@@ -1,10 +1,41 @@
 #include <iostream>
 #include <map>
+#include <string>
+#include <stdexcept>
+#include <thread>
 #include "bst.h"
 #include "avlbst.h"
+#include "pool_alloc.h"
+#include "indexed_avlbst.h"
+#include "ranked_avlbst.h"
+#include "aggregate_avlbst.h"
+#include "frozen_map.h"
+#include "bplus_tree.h"
+#include "balanced_bst.h"
+#include "splay_bst.h"
+#include "weighted_avlbst.h"
+#include "concurrent_avlbst.h"
 
 using namespace std;
 
+// A key whose copy constructor throws once copiesLeft reaches 0 (-1: never)
+struct FragileKey
+{
+    static int copiesLeft;
+    int id;
+    FragileKey(int i) : id(i) { }
+    FragileKey(const FragileKey& other) : id(other.id)
+    {
+        if(copiesLeft == 0) {
+            throw std::runtime_error("key copy failed");
+        }
+        if(copiesLeft > 0) {
+            --copiesLeft;
+        }
+    }
+    bool operator<(const FragileKey& rhs) const { return id < rhs.id; }
+};
+int FragileKey::copiesLeft = -1;
 
 int main(int argc, char *argv[])
 {
@@ -44,5 +75,254 @@ int main(int argc, char *argv[])
     cout << "Erasing b" << endl;
     at.remove('b');
 
+    // In place insertion
+    AVLTree<int,std::string> st;
+    st.try_emplace(1, 3, 'x');
+    st.insert_or_assign(2, std::string("two"));
+    std::pair<AVLTree<int,std::string>::iterator, bool> res = st.emplace(1, "not inserted");
+    cout << "\nemplace existing key 1: inserted = " << res.second << ", value = " << res.first->second << endl;
+    res = st.insert_or_assign(1, "one");
+    cout << "insert_or_assign key 1: inserted = " << res.second << ", value = " << res.first->second << endl;
+
+    // AVL Tree with pooled nodes
+    AVLTree<char,int,std::less<char>,PoolAllocator<std::pair<const char,int> > > pt;
+    for(char c = 'a'; c <= 'e'; ++c) {
+        pt.insert(std::make_pair(c, c - 'a'));
+    }
+    pt.remove('c');
+    cout << "\nPooled AVLTree contents:" << endl;
+    for(AVLTree<char,int,std::less<char>,PoolAllocator<std::pair<const char,int> > >::iterator it = pt.begin(); it != pt.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+
+    // AVL Tree with a custom Compare: keys in descending order
+    AVLTree<std::string,int,std::greater<std::string> > gt;
+    gt.insert(std::make_pair(std::string("apple"), 1));
+    gt.insert(std::make_pair(std::string("cherry"), 3));
+    gt.insert(std::make_pair(std::string("banana"), 2));
+    cout << "\nDescending AVLTree contents:" << endl;
+    for(AVLTree<std::string,int,std::greater<std::string> >::iterator iter = gt.begin(); iter != gt.end(); ++iter) {
+        cout << iter->first << " " << iter->second << endl;
+    }
+    cout << "cherry -> " << gt["cherry"] << endl;
+
+    // AVL Tree built from sorted input in one pass
+    std::pair<int,int> sorted[] = { std::make_pair(1, 10), std::make_pair(2, 20), std::make_pair(2, 21),
+                                    std::make_pair(3, 30), std::make_pair(4, 40) };
+    AVLTree<int,int> lt(sorted, sorted + 5);
+    cout << "\nBulk loaded AVLTree:" << endl;
+    lt.print();
+
+    // Copies are independent of the original
+    AVLTree<int,int> ct(lt);
+    ct.remove(1);
+    cout << "\nCopy without key 1, original still has " << lt[1] << endl;
+
+    // Set operations
+    AVLTree<int,int> delta;
+    delta.insert(std::make_pair(3, 300));
+    delta.insert(std::make_pair(7, 700));
+    ct.unionWith(delta);
+    AVLTree<int,int> upper = ct.split(4);
+    cout << "\nUnion with {3, 7}, split at 4:" << endl;
+    for(AVLTree<int,int>::iterator iter = ct.begin(); iter != ct.end(); ++iter) {
+        cout << iter->first << " " << iter->second << endl;
+    }
+    cout << "--" << endl;
+    for(AVLTree<int,int>::iterator iter = upper.begin(); iter != upper.end(); ++iter) {
+        cout << iter->first << " " << iter->second << endl;
+    }
+
+    // Order statistics
+    RankedAVLTree<int,int> rt;
+    for(int i = 10; i >= 1; --i) {
+        rt.insert(std::make_pair(i * 10, i));
+    }
+    rt.remove(50);
+    cout << "\nRankedAVLTree of " << rt.size() << " keys: rank(55) = " << rt.rank(55)
+         << ", select(4) = " << rt.select(4)->first << ", keys in [20, 70] = " << rt.countInRange(20, 70)
+         << ", median = " << rt.median()->first << ", 90th percentile = " << rt.percentile(0.9)->first << endl;
+
+    // Range queries
+    cout << "\nKeys in [25, 75]:";
+    rt.forEachInRange(25, 75, [](const std::pair<const int,int>& item) { cout << " " << item.first; });
+    cout << endl << "lower_bound(50) = " << rt.lower_bound(50)->first
+         << ", upper_bound(60) = " << rt.upper_bound(60)->first << endl;
+
+    // Walking backwards
+    cout << "\nRankedAVLTree in reverse:";
+    for(RankedAVLTree<int,int>::reverse_iterator iter = rt.rbegin(); iter != rt.rend(); ++iter) {
+        cout << " " << iter->first;
+    }
+    cout << endl << "largest key: " << std::prev(rt.end())->first << endl;
+
+    // Range aggregates
+    AggregateAVLTree<int,int> sums;
+    for(int i = 1; i <= 10; ++i) {
+        sums.insert(std::make_pair(i, i * i));
+    }
+    sums[4] = 0;
+    cout << "\nSum of squares over [3, 6] with 4 set to 0: " << sums.aggregate(3, 6)
+         << ", over all: " << sums.aggregate() << endl;
+    sums[1] = sums[3];
+    sums[2] += 6;
+    cout << "[1] set to [3]: " << sums[1] << ", [2] += 6: " << sums[2] << ", over all: " << sums.aggregate() << endl;
+
+    // Smallest and largest entries
+    AVLTree<int,std::string> deadlines;
+    deadlines.insert(std::make_pair(30, "backup"));
+    deadlines.insert(std::make_pair(10, "flush"));
+    deadlines.insert(std::make_pair(20, "compact"));
+    cout << "\nNext deadline: " << deadlines.front().first << " " << deadlines.front().second
+         << ", last: " << deadlines.back().first << endl;
+    while(!deadlines.empty()) {
+        std::pair<int,std::string> next = deadlines.popMin();
+        cout << "ran " << next.second << " at " << next.first << endl;
+    }
+
+    // Hinted inserts of a nearly sorted stream
+    AVLTree<int,int> stream;
+    AVLTree<int,int>::iterator last = stream.end();
+    const int arrivals[] = { 1, 2, 4, 3, 5, 7, 6, 8 };
+    for(int i = 0; i < 8; ++i) {
+        last = stream.insert(last, std::make_pair(arrivals[i], i));
+    }
+    cout << "\nStream in order:";
+    for(AVLTree<int,int>::iterator iter = stream.begin(); iter != stream.end(); ++iter) {
+        cout << " " << iter->first;
+    }
+    cout << endl << "found 6 from the last insert: " << stream.find(last, 6)->second << endl;
+
+    // Batched lookups
+    const int wanted[] = { 3, 9, 6 };
+    AVLTree<int,int>::iterator hits[3];
+    stream.findBatch(wanted, wanted + 3, hits);
+    cout << "\nBatch lookup of 3 9 6:";
+    for(int i = 0; i < 3; ++i) {
+        cout << " " << (hits[i] != stream.end() ? "found" : "missing");
+    }
+    cout << endl;
+
+    // Frozen snapshot
+    FrozenMap<int,int> frozen = stream.freeze();
+    cout << "\nFrozen stream:";
+    for(FrozenMap<int,int>::const_iterator iter = frozen.begin(); iter != frozen.end(); ++iter) {
+        cout << " " << iter->first;
+    }
+    cout << endl << "first key from 5 on: " << frozen.lower_bound(5)->first << endl;
+
+    // Van Emde Boas relayout
+    stream.relayout();
+    cout << "Stream after relayout:";
+    for(AVLTree<int,int>::iterator iter = stream.begin(); iter != stream.end(); ++iter) {
+        cout << " " << iter->first;
+    }
+    cout << endl << "balanced: " << stream.isBalanced() << endl;
+
+    // B+-tree behind the same interface
+    BPlusTree<int,int> bplus;
+    for(int i = 40; i >= 1; --i) {
+        bplus.insert(std::make_pair(i, i * i));
+    }
+    bplus.remove(7);
+    cout << "\nBPlusTree: " << bplus.size() << " entries, [9] = " << bplus[9]
+         << ", first key from 7 on: " << bplus.lower_bound(7)->first << endl;
+
+    // The same table under another balancing policy
+    BalancedTree<int,int,WAVLBalance> wavl;
+    for(int i = 1; i <= 20; ++i) {
+        wavl.insert(std::make_pair(i, i * 10));
+    }
+    for(int i = 2; i <= 20; i += 2) {
+        wavl.remove(i);
+    }
+    BalancedTree<int,int,RedBlackBalance> redBlack(wavl.begin(), wavl.end());
+    cout << "\nWAVL tree without even keys:";
+    for(BalancedTree<int,int,WAVLBalance>::iterator iter = wavl.begin(); iter != wavl.end(); ++iter) {
+        cout << " " << iter->first;
+    }
+    cout << endl << "red-black copy, [13] = " << redBlack[13] << endl;
+
+    // Splay tree: lookups move their key to the root
+    SplayTree<int,int> splay;
+    for(int i = 1; i <= 10; ++i) {
+        splay.insert(std::make_pair(i, -i));
+    }
+    splay.find(4);
+    cout << "\nSplayTree after find(4):" << endl;
+    splay.print();
+    splay.setSplaying(SplayMode::SEMI, 2);
+    cout << "[7] = " << splay[7] << ", [2] = " << splay[2] << endl;
+
+    // Reshaping for a skewed access pattern
+    WeightedAVLTree<int,int> weighted;
+    for(int i = 1; i <= 15; ++i) {
+        weighted.insert(std::make_pair(i, i * i));
+    }
+    for(int i = 0; i < 20; ++i) {
+        weighted.find(13);
+    }
+    weighted.find(14);
+    AccessPatternReport report = weighted.optimizeForAccessPattern();
+    cout << "\nWeightedAVLTree after 20 lookups of 13: expected depth " << report.expectedDepthBefore
+         << " -> " << report.expectedDepthAfter << endl;
+    weighted.print();
+    weighted.insert(std::make_pair(16, 256));
+    cout << "balanced again after an insert: " << weighted.isBalanced() << endl;
+
+    // Several threads writing and reading at once
+    ConcurrentAVLTree<int,int> shared;
+    std::thread writers[4];
+    for(int w = 0; w < 4; ++w) {
+        writers[w] = std::thread([&shared, w]() {
+            for(int i = w; i < 1000; i += 4) {
+                shared.insert(std::make_pair(i, i * 2));
+            }
+            for(int i = w; i < 1000; i += 8) {
+                shared.remove(i);
+            }
+        });
+    }
+    for(int w = 0; w < 4; ++w) {
+        writers[w].join();
+    }
+    int doubled = 0;
+    cout << "\nConcurrentAVLTree after 4 writers: " << shared.size() << " keys, balanced: " << shared.isBalanced()
+         << ", has 8: " << shared.contains(8) << ", [13] found: " << shared.find(13, doubled) << " = " << doubled << endl;
+
+    // Index based AVL Tree
+    IndexedAVLTree<char,int> it;
+    for(char c = 'e'; c >= 'a'; --c) {
+        it.insert(std::make_pair(c, c - 'a'));
+    }
+    it.remove('b');
+    cout << "\nIndexedAVLTree contents:" << endl;
+    for(IndexedAVLTree<char,int>::iterator iter = it.begin(); iter != it.end(); ++iter) {
+        cout << iter->first << " " << iter->second << endl;
+    }
+
+
+    // A key copy that throws while the node array grows leaves the tree as it was
+    IndexedAVLTree<FragileKey,int> fragile;
+    for(int i = 1; i <= 16; ++i) {
+        fragile.insert(std::make_pair(FragileKey(i), i));
+    }
+    fragile.remove(FragileKey(4));
+    FragileKey::copiesLeft = 5;
+    try {
+        fragile.reserve(64);
+    }
+    catch(const std::runtime_error& e) {
+        cout << "\nIndexedAVLTree reserve threw: " << e.what() << endl;
+    }
+    FragileKey::copiesLeft = -1;
+    cout << "still " << fragile.size() << " keys:";
+    for(IndexedAVLTree<FragileKey,int>::iterator iter = fragile.begin(); iter != fragile.end(); ++iter) {
+        cout << " " << iter->second;
+    }
+    fragile.insert(std::make_pair(FragileKey(17), 17));
+    fragile.insert(std::make_pair(FragileKey(18), 18));
+    cout << endl << "17 reuses the free slot, 18 grows the array: " << fragile.size() << " keys" << endl;
+
     return 0;
 }
@@ -5,20 +5,46 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <functional>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * The getters for parent/left/right are deliberately NOT virtual:
+ * a node carries no vtable and every descent is plain pointer chasing.
+ * Node types for other kinds of search trees (AVL, Red Black, Splay, ...)
+ * derive from Node and hide these getters with versions that return
+ * their own node type, so the dispatch is resolved at compile time.
+ * Since the destructor is not virtual either, a derived node must always
+ * be deleted through a pointer to its own type.
+ *
+ * When AVL_COMPACT_NODES is defined, the parent link is kept as an integer
+ * whose low bits are free for derived nodes to use as tag bits (AVLNode
+ * keeps its balance there). getParent/setParent mask and preserve them.
+ *
+ * When BST_THREADED_NODES is defined, every node also links to its in-order
+ * neighbours, so the nodes of a tree double as a sorted doubly linked list
+ * and iterator steps are a single pointer load instead of a walk through
+ * the tree. It costs two pointers per node and some upkeep on every
+ * insert and remove.
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    template<typename... Args>
+    explicit Node(Node<Key, Value>* parent, Args&&... itemArgs);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,20 +52,42 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
+
+#ifdef BST_THREADED_NODES
+    Node<Key, Value>* getNext() const;
+    Node<Key, Value>* getPrev() const;
+    void setNext(Node<Key, Value>* next);
+    void setPrev(Node<Key, Value>* prev);
+#endif
+
+    // Copies what a node keeps besides its item and links (nothing, for a
+    // plain Node). Derived nodes hide it to copy their own bookkeeping.
+    void copyMetadata(const Node<Key, Value>& other);
 
 protected:
     std::pair<const Key, Value> item_;
+#ifdef AVL_COMPACT_NODES
+    // Nodes are at least pointer aligned, so these low bits of the parent link are free.
+    static const std::uintptr_t PARENT_TAG_MASK = alignof(void*) - 1;
+    std::uintptr_t parent_;
+#else
     Node<Key, Value>* parent_;
+#endif
     Node<Key, Value>* left_;
     Node<Key, Value>* right_;
+#ifdef BST_THREADED_NODES
+    Node<Key, Value>* next_;    // in-order neighbours
+    Node<Key, Value>* prev_;
+#endif
 };
 
 /*
@@ -54,9 +102,41 @@ protected:
 template<typename Key, typename Value>
 Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent) :
     item_(key, value),
+#ifdef AVL_COMPACT_NODES
+    parent_(reinterpret_cast<std::uintptr_t>(parent)),
+#else
+    parent_(parent),
+#endif
+    left_(NULL),
+    right_(NULL)
+#ifdef BST_THREADED_NODES
+    , next_(NULL),
+    prev_(NULL)
+#endif
+{
+
+}
+
+/**
+* A constructor that builds the item in place from itemArgs, which are
+* forwarded to the std::pair constructor (e.g. key and value, or
+* std::piecewise_construct and two tuples).
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+Node<Key, Value>::Node(Node<Key, Value>* parent, Args&&... itemArgs) :
+    item_(std::forward<Args>(itemArgs)...),
+#ifdef AVL_COMPACT_NODES
+    parent_(reinterpret_cast<std::uintptr_t>(parent)),
+#else
     parent_(parent),
+#endif
     left_(NULL),
     right_(NULL)
+#ifdef BST_THREADED_NODES
+    , next_(NULL),
+    prev_(NULL)
+#endif
 {
 
 }
@@ -118,16 +198,20 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
 {
+#ifdef AVL_COMPACT_NODES
+    return reinterpret_cast<Node<Key, Value>*>(parent_ & ~PARENT_TAG_MASK);
+#else
     return parent_;
+#endif
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -136,7 +220,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -146,11 +230,16 @@ Node<Key, Value>* Node<Key, Value>::getRight() const
 
 /**
 * A setter for setting the parent of a node.
+* In compact mode the tag bits stored alongside the parent are left untouched.
 */
 template<typename Key, typename Value>
 void Node<Key, Value>::setParent(Node<Key, Value>* parent)
 {
+#ifdef AVL_COMPACT_NODES
+    parent_ = reinterpret_cast<std::uintptr_t>(parent) | (parent_ & PARENT_TAG_MASK);
+#else
     parent_ = parent;
+#endif
 }
 
 /**
@@ -180,37 +269,195 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* A setter that moves the new value into the node.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
+#ifdef BST_THREADED_NODES
+template<typename Key, typename Value>
+Node<Key, Value>* Node<Key, Value>::getNext() const
+{
+    return next_;
+}
+
+template<typename Key, typename Value>
+Node<Key, Value>* Node<Key, Value>::getPrev() const
+{
+    return prev_;
+}
+
+template<typename Key, typename Value>
+void Node<Key, Value>::setNext(Node<Key, Value>* next)
+{
+    next_ = next;
+}
+
+template<typename Key, typename Value>
+void Node<Key, Value>::setPrev(Node<Key, Value>* prev)
+{
+    prev_ = prev;
+}
+#endif
+
+template<typename Key, typename Value>
+void Node<Key, Value>::copyMetadata(const Node<Key, Value>&)
+{
+
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+/**
+* Three-way key comparison: returns <0, 0 or >0 as a orders before, the
+* same as or after b under comp. Searches branch on its result, so each
+* level of a descent costs one comparison instead of two. In order of
+* preference it uses
+*  - comp.compare(a, b), for comparators that provide a three-way compare
+*    returning a signed integer;
+*  - a <=> b (C++20), when comp is std::less and the keys are arithmetic
+*    or standard strings;
+*  - a.compare(b), when comp is std::less and the key is a standard string
+*    (std::basic_string, std::basic_string_view);
+*  - comp(a, b), then comp(b, a), for any other strict weak ordering.
+* Other key types always go through std::less, so a specialization of it
+* for a user type is honoured.
+*/
+template<int N>
+struct CompareKeysRank : CompareKeysRank<N - 1> { };
+template<>
+struct CompareKeysRank<0> { };
+
+// Whether T is a standard string, whose compare() and <=> agree with operator<.
+template<typename T>
+struct IsStandardString : std::false_type { };
+template<typename Char, typename Traits, typename StringAlloc>
+struct IsStandardString<std::basic_string<Char, Traits, StringAlloc> > : std::true_type { };
+#if __cplusplus >= 201703L
+template<typename Char, typename Traits>
+struct IsStandardString<std::basic_string_view<Char, Traits> > : std::true_type { };
+#endif
+
+template<typename Compare, typename A, typename B>
+auto compareKeys(const Compare& comp, const A& a, const B& b, CompareKeysRank<3>)
+    -> typename std::enable_if<std::is_signed<decltype(comp.compare(a, b))>::value, int>::type
+{
+    return static_cast<int>(comp.compare(a, b));
+}
+
+#if defined(__cpp_impl_three_way_comparison) && defined(__cpp_lib_three_way_comparison)
+template<typename T, typename A, typename B>
+auto compareKeys(const std::less<T>&, const A& a, const B& b, CompareKeysRank<2>)
+    -> typename std::enable_if<IsStandardString<A>::value || (std::is_arithmetic<A>::value && std::is_arithmetic<B>::value),
+                               decltype((a <=> b) < 0, int())>::type
+{
+    const auto order = a <=> b;
+    return (order < 0) ? -1 : ((order > 0) ? 1 : 0);
+}
+#endif
+
+template<typename T, typename A, typename B>
+auto compareKeys(const std::less<T>&, const A& a, const B& b, CompareKeysRank<1>)
+    -> typename std::enable_if<IsStandardString<A>::value, decltype(static_cast<int>(a.compare(b)))>::type
+{
+    return static_cast<int>(a.compare(b));
+}
+
+template<typename Compare, typename A, typename B>
+int compareKeys(const Compare& comp, const A& a, const B& b, CompareKeysRank<0>)
+{
+    return comp(a, b) ? -1 : (comp(b, a) ? 1 : 0);
+}
+
+template<typename Compare, typename A, typename B>
+int compareKeys(const Compare& comp, const A& a, const B& b)
+{
+    return compareKeys(comp, a, b, CompareKeysRank<3>());
+}
+
+/**
+* Asks for the cache line at p ahead of its use, where the compiler
+* supports it; a hint only, so elsewhere it does nothing.
+*/
+inline void prefetchForRead(const void* p)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p, 0, 3);
+#else
+    (void)p;
+#endif
+}
+
 /**
 * A templated unbalanced binary search tree.
+* Nodes are obtained from Alloc, which is rebound to the node type of
+* the tree (like the allocator of std::map). See pool_alloc.h for a
+* slab/pool allocator suited to node-at-a-time allocation.
+* Keys are ordered by Compare, as in std::map; see compareKeys above for
+* how a comparator can offer a cheaper three-way comparison. When
+* Compare::is_transparent exists, find() accepts any type comparable
+* with Key, e.g. a std::string_view on a std::string-keyed tree.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key>, typename Alloc = std::allocator<std::pair<const Key, Value> > >
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    explicit BinarySearchTree(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit BinarySearchTree(const Alloc& alloc);
+    BinarySearchTree(const BinarySearchTree<Key, Value, Compare, Alloc>& other);
+    BinarySearchTree(BinarySearchTree<Key, Value, Compare, Alloc>&& other) noexcept;
     virtual ~BinarySearchTree(); //TODO
-    virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    BinarySearchTree<Key, Value, Compare, Alloc>& operator=(const BinarySearchTree<Key, Value, Compare, Alloc>& other);
+    BinarySearchTree<Key, Value, Compare, Alloc>& operator=(BinarySearchTree<Key, Value, Compare, Alloc>&& other)
+        noexcept(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value);
     virtual void remove(const Key& key); //TODO
     void clear(); //TODO
+
+    // The smallest and largest entries in O(1), as the tree keeps track of
+    // both ends. front/back throw std::out_of_range on an empty tree, and so
+    // do popMin/popMax, which remove that entry and return it.
+    std::pair<const Key, Value>& front();
+    const std::pair<const Key, Value>& front() const;
+    std::pair<const Key, Value>& back();
+    const std::pair<const Key, Value>& back() const;
+    std::pair<Key, Value> popMin();
+    std::pair<Key, Value> popMax();
+
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    Compare key_comp() const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
 public:
+    class const_iterator;
+
     /**
     * An internal iterator class for traversing the contents of the BST.
+    * It is bidirectional: stepping is O(1) amortized over a full traversal,
+    * and decrementing end() gives the largest entry, so std::prev and
+    * reverse_iterator work. Besides its node, an iterator knows its tree,
+    * for that last step.
     */
     class iterator  // TODO
     {
     public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
         iterator();
 
         std::pair<const Key,Value>& operator*() const;
@@ -220,24 +467,144 @@ public:
         bool operator!=(const iterator& rhs) const;
 
         iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BinarySearchTree<Key, Value, Compare, Alloc>;
+        friend class const_iterator;
+        iterator(const BinarySearchTree<Key, Value, Compare, Alloc>* tree, Node<Key,Value>* ptr);
+        const BinarySearchTree<Key, Value, Compare, Alloc>* tree_;
+        Node<Key, Value> *current_;
+    };
+
+    /**
+    * The same over a const tree: the items can be read but not modified.
+    * An iterator converts to a const_iterator, and the two compare equal
+    * when they are at the same entry.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& other);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        friend bool operator==(const const_iterator& lhs, const const_iterator& rhs)
+        {
+            return lhs.current_ == rhs.current_;
+        }
+        friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs)
+        {
+            return lhs.current_ != rhs.current_;
+        }
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        friend class BinarySearchTree<Key, Value, Compare, Alloc>;
+        const_iterator(const BinarySearchTree<Key, Value, Compare, Alloc>* tree, Node<Key,Value>* ptr);
+        const BinarySearchTree<Key, Value, Compare, Alloc>* tree_;
         Node<Key, Value> *current_;
     };
 
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
 public:
-    iterator begin() const;
-    iterator end() const;
-    iterator find(const Key& key) const;
+    // Inserting an existing key overwrites its value. The iterator points at
+    // the key's node; the bool is true iff a new node was created.
+    virtual std::pair<iterator, bool> insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    virtual std::pair<iterator, bool> insert(std::pair<const Key, Value>&& keyValuePair);
+    // Hinted insertion: the search for the key's slot starts at hint (see
+    // findFinger) instead of the root. Returns an iterator to the key.
+    virtual iterator insert(const_iterator hint, const std::pair<const Key, Value>& keyValuePair);
+    virtual iterator insert(const_iterator hint, std::pair<const Key, Value>&& keyValuePair);
+
+    // Like std::map: these leave an existing key's value untouched.
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value);
+    template<typename V>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, V&& value);
+
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator crbegin() const;
+    reverse_iterator rend();
+    const_reverse_iterator rend() const;
+    const_reverse_iterator crend() const;
+
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key);
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    const_iterator find(const K& key) const;
+    // Finger search: find(key), starting at hint.
+    iterator find(const_iterator hint, const Key& key);
+    const_iterator find(const_iterator hint, const Key& key) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
+    // Ordered lookups, as in std::map: the first key not less than key, the
+    // first key greater than key, and the range of keys equal to key.
+    iterator lower_bound(const Key& key);
+    const_iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key);
+    const_iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key);
+    std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+    // Calls fn(item) for every entry with low <= key <= high, in key order.
+    template<typename Fn>
+    void forEachInRange(const Key& low, const Key& high, Fn fn) const;
+    // Writes find(key) for each key in [first, last) to out[0], out[1], ...
+    // Both must be random access iterators. Much faster than a loop of
+    // find() on trees that do not fit in the cache; see findNodes.
+    template<typename RandomIt, typename OutIt>
+    void findBatch(RandomIt first, RandomIt last, OutIt out);
+    template<typename RandomIt, typename OutIt>
+    void findBatch(RandomIt first, RandomIt last, OutIt out) const;
+
 protected:
     // Mandatory helper functions
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    template<typename K>
+    Node<Key, Value>* findNode(const K& key) const;
+    // the first node whose key is not less than key (greater than key if strict)
+    Node<Key, Value>* boundNode(const Key& key, bool strict) const;
+    // calls emit(i, node) with the node of key first[i], or nullptr
+    template<typename RandomIt, typename Emit>
+    void findNodes(RandomIt first, RandomIt last, Emit emit) const;
     Node<Key, Value> *getSmallestNode() const;  // TODO
+    Node<Key, Value>* getLargestNode() const;
+    // lets derived trees hand out iterators to nodes they found themselves
+    iterator makeIterator(Node<Key, Value>* node);
+    const_iterator makeIterator(Node<Key, Value>* node) const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
@@ -251,10 +618,78 @@ protected:
     bool isBalancedHelper(Node<Key, Value>* root) const; //helper function for isBalanced
     int getHeight(Node<Key, Value>* root) const; //helper function for isBalanced
 
+    // Insertion searches first and only builds a node once its slot is known.
+    // findSlot returns the node holding key, or sets parent/isLeft to the empty
+    // slot where it belongs. attachNode links a new node into that slot; derived
+    // trees override it to rebalance. The *Node templates do the work of the
+    // public insert functions for a given node type, so that derived trees
+    // only have to name theirs.
+    // findSlot searches the subtree of start, or the whole tree if it is nullptr.
+    Node<Key, Value>* findSlot(const Key& key, Node<Key, Value>*& parent, bool& isLeft,
+                               Node<Key, Value>* start = nullptr) const;
+    // the subtree of the finger's ancestors that has to hold key
+    Node<Key, Value>* findFinger(const_iterator hint, const Key& key) const;
+    virtual void attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft);
+    // Unlinks and frees a node of the tree; remove() is a find plus this.
+    virtual void eraseNode(Node<Key, Value>* node);
+    // Bookkeeping that is the same for every tree: attachNode calls
+    // nodeAttached once the node is linked in, and eraseNode calls
+    // nodeDetaching before it unlinks the node. refreshBounds recomputes
+    // the cached ends after the tree was rebuilt wholesale.
+    void nodeAttached(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft);
+    void nodeDetaching(Node<Key, Value>* node);
+    void refreshBounds();
+    // called after the value of an existing node has been overwritten
+    virtual void valueChanged(Node<Key, Value>* node);
+    template<typename NodeType, typename K, typename V>
+    std::pair<iterator, bool> insertOrAssignNode(K&& key, V&& value, Node<Key, Value>* start = nullptr);
+    template<typename NodeType, typename K, typename... Args>
+    std::pair<iterator, bool> tryEmplaceNode(K&& key, Args&&... args);
+    template<typename NodeType, typename K, typename V>
+    std::pair<iterator, bool> emplaceNode(std::true_type, K&& key, V&& value);
+    template<typename NodeType, typename... Args>
+    std::pair<iterator, bool> emplaceNode(std::false_type, Args&&... args);
+
+    // true when the arguments of emplace() are a key and a value
+    template<typename... Args>
+    struct EmplacesKeyValue : std::false_type { };
+    template<typename K, typename V>
+    struct EmplacesKeyValue<K, V> : std::is_same<typename std::decay<K>::type, Key> { };
+
+    // node allocation through Alloc, rebound to the concrete node type
+    template<typename NodeType, typename... Args>
+    NodeType* createNode(Node<Key, Value>* parent, Args&&... itemArgs);
+    template<typename NodeType>
+    void destroyNode(NodeType* node);
+    template<typename NodeType>
+    void destroySubtree(NodeType* root);
+    // frees every node without rebalancing; derived trees override it to
+    // free their own node type
+    virtual void destroyAllNodes();
+    // copies a subtree, shape and node metadata included, in one pass
+    template<typename NodeType>
+    NodeType* cloneSubtree(const NodeType* root);
+    // cloneSubtree for the tree's own node type; used by the assignments
+    virtual Node<Key, Value>* cloneNodes(const Node<Key, Value>* root);
+    void releaseNodeMemory();
+
+    // Upkeep of the in-order threads (see Node); all of these do nothing
+    // unless BST_THREADED_NODES is defined. Subtree roots have no parent.
+    static void threadLeaf(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft);
+    static void unthread(Node<Key, Value>* node);
+    static void swapThreads(Node<Key, Value>* n1, Node<Key, Value>* n2);
+    static void threadSubtree(Node<Key, Value>* root);
+    static void joinThreads(Node<Key, Value>* leftRoot, Node<Key, Value>* middle, Node<Key, Value>* rightRoot);
+    static void cutThreads(Node<Key, Value>* leftRoot, Node<Key, Value>* rightRoot);
 
 
 protected:
     Node<Key, Value>* root_;
+    Compare comp_;
+    Alloc alloc_;
+    // the smallest and the largest node, nullptr when empty
+    Node<Key, Value>* leftmost_;
+    Node<Key, Value>* rightmost_;
     // You should not need other data members
 };
 
@@ -267,8 +702,10 @@ Begin implementations for the BinarySearchTree::iterator class.
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr) : current_(ptr)
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::iterator(
+    const BinarySearchTree<Key, Value, Compare, Alloc>* tree, Node<Key,Value> *ptr) :
+    tree_(tree), current_(ptr)
 {
     // TODO
 }
@@ -276,8 +713,8 @@ BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr) : current
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() : current_(nullptr)
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::iterator() : tree_(nullptr), current_(nullptr)
 {
     // TODO
 }
@@ -285,9 +722,9 @@ BinarySearchTree<Key, Value>::iterator::iterator() : current_(nullptr)
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -295,9 +732,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -306,10 +743,10 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::iterator& rhs) const
 {
     // TODO
     return current_ == rhs.current_;
@@ -319,10 +756,10 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare, Alloc>::iterator& rhs) const
 {
     // TODO
     return current_ != rhs.current_;
@@ -333,17 +770,53 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator++()
 {
     // TODO
     if(current_ != nullptr)
     {
-        current_ = BinarySearchTree<Key, Value>::successor(current_);
+        current_ = BinarySearchTree<Key, Value, Compare, Alloc>::successor(current_);
+    }
+    return *this;
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++*this;
+    return old;
+}
+
+/**
+* Moves back to the in-order predecessor; from end(), to the largest item.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator--()
+{
+    if(current_ == nullptr)
+    {
+        current_ = tree_->rightmost_;
+    }
+    else
+    {
+        current_ = BinarySearchTree<Key, Value, Compare, Alloc>::predecessor(current_);
     }
     return *this;
+}
 
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --*this;
+    return old;
 }
 
 
@@ -353,6 +826,97 @@ End implementations for the BinarySearchTree::iterator class.
 -------------------------------------------------------------
 */
 
+/*
+--------------------------------------------------------------------
+Begin implementations for the BinarySearchTree::const_iterator class.
+--------------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator(
+    const BinarySearchTree<Key, Value, Compare, Alloc>* tree, Node<Key,Value> *ptr) :
+    tree_(tree), current_(ptr)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator() : tree_(nullptr), current_(nullptr)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::const_iterator(const iterator& other) :
+    tree_(other.tree_), current_(other.current_)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+const std::pair<const Key,Value> &
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator*() const
+{
+    return current_->getItem();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+const std::pair<const Key,Value> *
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator->() const
+{
+    return &(current_->getItem());
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator++()
+{
+    if(current_ != nullptr)
+    {
+        current_ = BinarySearchTree<Key, Value, Compare, Alloc>::successor(current_);
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++*this;
+    return old;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator&
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator--()
+{
+    if(current_ == nullptr)
+    {
+        current_ = tree_->rightmost_;
+    }
+    else
+    {
+        current_ = BinarySearchTree<Key, Value, Compare, Alloc>::predecessor(current_);
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --*this;
+    return old;
+}
+
+/*
+------------------------------------------------------------------
+End implementations for the BinarySearchTree::const_iterator class.
+------------------------------------------------------------------
+*/
+
 /*
 -----------------------------------------------------
 Begin implementations for the BinarySearchTree class.
@@ -362,171 +926,843 @@ Begin implementations for the BinarySearchTree class.
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() : root_(nullptr)
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree() :
+    root_(nullptr), leftmost_(nullptr), rightmost_(nullptr)
 {
     // TODO
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* Constructs an empty tree whose nodes are allocated with a copy of alloc.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(const Alloc& alloc) :
+    root_(nullptr), alloc_(alloc), leftmost_(nullptr), rightmost_(nullptr)
 {
-    // TODO
-    clear();
 
 }
 
 /**
- * Returns true if tree is empty
+* Constructs an empty tree ordered by a copy of comp.
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(const Compare& comp, const Alloc& alloc) :
+    root_(nullptr), comp_(comp), alloc_(alloc), leftmost_(nullptr), rightmost_(nullptr)
 {
-    return root_ == NULL;
-}
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
-{
-    printRoot(root_);
-    std::cout << "\n";
 }
 
 /**
-* Returns an iterator to the "smallest" item in the tree
+* Copy constructor: clones the shape of other in O(n), without a single
+* comparison or rebalancing step.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(const BinarySearchTree<Key, Value, Compare, Alloc>& other) :
+    root_(nullptr), comp_(other.comp_),
+    alloc_(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.alloc_)),
+    leftmost_(nullptr), rightmost_(nullptr)
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
-    return begin;
+    root_ = cloneSubtree(other.root_);
+    refreshBounds();
 }
 
 /**
-* Returns an iterator whose value means INVALID
+* Move constructor: takes over the nodes of other in O(1), leaving it empty.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare, class Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::BinarySearchTree(BinarySearchTree<Key, Value, Compare, Alloc>&& other) noexcept :
+    root_(other.root_), comp_(std::move(other.comp_)), alloc_(std::move(other.alloc_)),
+    leftmost_(other.leftmost_), rightmost_(other.rightmost_)
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
-    return end;
+    other.root_ = nullptr;
+    other.leftmost_ = nullptr;
+    other.rightmost_ = nullptr;
 }
 
-/**
-* Returns an iterator to the item with the given key, k
-* or the end iterator if k does not exist in the tree
-*/
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>::~BinarySearchTree()
 {
-    Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
-    return it;
+    // TODO
+    clear();
+
 }
 
-/**
- * @precondition The key exists in the map
- * Returns the value associated with the key
- */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+// move assignment only replaces the allocator when it propagates
+template<typename A>
+void moveAllocator(A& to, A& from, std::true_type)
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    to = std::move(from);
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+
+template<typename A>
+void moveAllocator(A&, A&, std::false_type)
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+
 }
 
 /**
-* An insert method to insert into a Binary Search Tree.
-* The tree will not remain balanced when inserting.
-* Recall: If key is already in the tree, you should 
-* overwrite the current value with the updated value.
+* Copy assignment. The copy is built before the old contents are freed, so
+* the tree is left unchanged if copying throws (unless the allocator has to
+* be replaced first). Both trees must hold the same node type: assigning
+* through references to a base tree type is not supported.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<typename Key, typename Value, typename Compare, typename Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>&
+BinarySearchTree<Key, Value, Compare, Alloc>::operator=(const BinarySearchTree<Key, Value, Compare, Alloc>& other)
 {
-    // TODO
-    //if tree is empty
-    if(root_ == nullptr)
+    if(this == &other)
     {
-        root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
-        return;
+        return *this;
     }
-
-    //starting point is root
-    Node<Key, Value>* current = root_;
-    Node<Key, Value>* parent = nullptr;
-    
-    //traversing through tree to find the correct spot to insert
-    while(current != nullptr)
+    if(std::allocator_traits<Alloc>::propagate_on_container_copy_assignment::value && !(alloc_ == other.alloc_))
     {
-        parent = current; //each iteration, parent is current
-        if(keyValuePair.first < current->getKey())
-        {
-            //go left if key is less than current node's key
-            current = current->getLeft();
-        }
-        else if(keyValuePair.first > current->getKey())
-        {
-            //go right if key is greater than current node's key
-            current = current->getRight();
-        }
-        else
-        {
-            //if key is already in tree, overwrite with new value
-            current->setValue(keyValuePair.second);
-            return;
-        }
+        clear();
+        alloc_ = other.alloc_;
     }
+    Node<Key, Value>* copy = cloneNodes(other.root_);
+    clear();
+    root_ = copy;
+    refreshBounds();
+    comp_ = other.comp_;
+    return *this;
+}
 
-    //inserting new node at end
-    Node<Key, Value>* newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, parent);
-    //if key is less than parent's key, insert at left
-    if(keyValuePair.first < parent->getKey())
+/**
+* Move assignment: frees the old contents and takes over the nodes of other
+* in O(1). Only when the allocator does not propagate and the two allocators
+* differ are the nodes copied instead.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+BinarySearchTree<Key, Value, Compare, Alloc>&
+BinarySearchTree<Key, Value, Compare, Alloc>::operator=(BinarySearchTree<Key, Value, Compare, Alloc>&& other)
+    noexcept(std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+{
+    if(this == &other)
     {
-        parent->setLeft(newNode);
+        return *this;
     }
-    //if key is greater than parent's key, insert at right
-    else
+    if(!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value && !(alloc_ == other.alloc_))
     {
-        parent->setRight(newNode);
+        *this = static_cast<const BinarySearchTree<Key, Value, Compare, Alloc>&>(other);
+        other.clear();
+        return *this;
     }
- 
+    clear();
+    moveAllocator(alloc_, other.alloc_, typename std::allocator_traits<Alloc>::propagate_on_container_move_assignment());
+    root_ = other.root_;
+    leftmost_ = other.leftmost_;
+    rightmost_ = other.rightmost_;
+    comp_ = std::move(other.comp_);
+    other.root_ = nullptr;
+    other.leftmost_ = nullptr;
+    other.rightmost_ = nullptr;
+    return *this;
 }
 
+/**
+ * Returns true if tree is empty
+*/
+template<class Key, class Value, class Compare, class Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::empty() const
+{
+    return root_ == NULL;
+}
 
 /**
-* A remove method to remove a specific key from a Binary Search Tree.
-* Recall: The writeup specifies that if a node has 2 children you
-* should swap with the predecessor and then remove.
+* Returns a copy of the comparator that orders the keys.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<class Key, class Value, class Compare, class Alloc>
+Compare BinarySearchTree<Key, Value, Compare, Alloc>::key_comp() const
 {
-    // TODO
-    Node<Key, Value>* removeNode = internalFind(key);
+    return comp_;
+}
 
-    //node to remove does not exist in tree
-    if(removeNode == nullptr)
-    {
-        return;
-    }
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::print() const
+{
+    printRoot(root_);
+    std::cout << "\n";
+}
 
+/**
+* Returns an iterator to the "smallest" item in the tree
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::begin()
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator begin(this, leftmost_);
+    return begin;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::begin() const
+{
+    return const_iterator(this, leftmost_);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::cbegin() const
+{
+    return begin();
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::end()
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator end(this, NULL);
+    return end;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::end() const
+{
+    return const_iterator(this, NULL);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::cend() const
+{
+    return end();
+}
+
+/**
+* Reverse iteration starts from the largest item; see iterator::operator--.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rbegin()
+{
+    return reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::crbegin() const
+{
+    return rbegin();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rend()
+{
+    return reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::crend() const
+{
+    return rend();
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const Key & k)
+{
+    Node<Key, Value> *curr = internalFind(k);
+    BinarySearchTree<Key, Value, Compare, Alloc>::iterator it(this, curr);
+    return it;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const Key & k) const
+{
+    return const_iterator(this, internalFind(k));
+}
+
+/**
+* Finger search: find(k), but starting at hint instead of the root; see
+* findFinger for the cost.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const_iterator hint, const Key& k)
+{
+    Node<Key, Value>* parent;
+    bool isLeft;
+    return iterator(this, findSlot(k, parent, isLeft, findFinger(hint, k)));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const_iterator hint, const Key& k) const
+{
+    Node<Key, Value>* parent;
+    bool isLeft;
+    return const_iterator(this, findSlot(k, parent, isLeft, findFinger(hint, k)));
+}
+
+/**
+* Heterogeneous find, available when Compare is transparent: compares k
+* with the stored keys directly, without building a temporary Key.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const K& k)
+{
+    return iterator(this, findNode(k));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::find(const K& k) const
+{
+    return const_iterator(this, findNode(k));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::lower_bound(const Key& key)
+{
+    return iterator(this, boundNode(key, false));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::lower_bound(const Key& key) const
+{
+    return const_iterator(this, boundNode(key, false));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::upper_bound(const Key& key)
+{
+    return iterator(this, boundNode(key, true));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::upper_bound(const Key& key) const
+{
+    return const_iterator(this, boundNode(key, true));
+}
+
+/**
+* Keys are unique, so the range holds at most one entry: one descent
+* finds it, and its successor ends the range.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator,
+          typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator>
+BinarySearchTree<Key, Value, Compare, Alloc>::equal_range(const Key& key)
+{
+    std::pair<const_iterator, const_iterator> range = static_cast<const BinarySearchTree<Key, Value, Compare, Alloc>*>(this)->equal_range(key);
+    return std::make_pair(iterator(this, range.first.current_), iterator(this, range.second.current_));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator,
+          typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator>
+BinarySearchTree<Key, Value, Compare, Alloc>::equal_range(const Key& key) const
+{
+    Node<Key, Value>* first = boundNode(key, false);
+    Node<Key, Value>* last = first;
+    if(first != nullptr && compareKeys(comp_, key, first->getKey()) == 0)
+    {
+        last = successor(first);
+    }
+    return std::make_pair(const_iterator(this, first), const_iterator(this, last));
+}
+
+/**
+* One descent to the first key in range, then successor() steps until a
+* key passes high: O(log n + k) for k entries in range, instead of a scan
+* of the whole tree. fn must not insert into or remove from the tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename Fn>
+void BinarySearchTree<Key, Value, Compare, Alloc>::forEachInRange(const Key& low, const Key& high, Fn fn) const
+{
+    for(Node<Key, Value>* current = boundNode(low, false);
+        current != nullptr && compareKeys(comp_, high, current->getKey()) >= 0;
+        current = successor(current))
+    {
+        fn(current->getItem());
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename RandomIt, typename OutIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::findBatch(RandomIt first, RandomIt last, OutIt out)
+{
+    findNodes(first, last, [this, &out](std::size_t i, Node<Key, Value>* node) { out[i] = iterator(this, node); });
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename RandomIt, typename OutIt>
+void BinarySearchTree<Key, Value, Compare, Alloc>::findBatch(RandomIt first, RandomIt last, OutIt out) const
+{
+    findNodes(first, last, [this, &out](std::size_t i, Node<Key, Value>* node) { out[i] = const_iterator(this, node); });
+}
+
+/**
+* A single descent is a chain of cache misses, each node's address known
+* only once its parent has arrived. Here up to 16 descents are in flight
+* at once, AMAC style: every round takes each of them one level down and
+* prefetches the child it moves to, so by the time the round comes back
+* to it the child is (hopefully) in the cache, and the misses of the 16
+* overlap instead of adding up. A finished descent hands its slot to the
+* next key right away. Results are emitted in completion order, each
+* with the index of its key.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename RandomIt, typename Emit>
+void BinarySearchTree<Key, Value, Compare, Alloc>::findNodes(RandomIt first, RandomIt last, Emit emit) const
+{
+    struct Lookup
+    {
+        Node<Key, Value>* node;
+        std::size_t index;
+    };
+    const std::size_t maxInFlight = 16;
+    Lookup inFlight[maxInFlight];
+    const std::size_t count = static_cast<std::size_t>(last - first);
+    std::size_t next = 0;
+    std::size_t active = 0;
+    while(active < maxInFlight && next < count)
+    {
+        inFlight[active].node = root_;
+        inFlight[active].index = next++;
+        ++active;
+    }
+
+    while(active > 0)
+    {
+        for(std::size_t i = 0; i < active; )
+        {
+            Lookup& lookup = inFlight[i];
+            Node<Key, Value>* node = lookup.node;
+            int order = 0;
+            if(node != nullptr)
+            {
+                order = compareKeys(comp_, first[lookup.index], node->getKey());
+                if(order != 0)
+                {
+                    Node<Key, Value>* child = (order < 0) ? node->getLeft() : node->getRight();
+                    if(child != nullptr)
+                    {
+                        prefetchForRead(child);
+                        lookup.node = child;
+                        ++i;
+                        continue;
+                    }
+                }
+            }
+
+            //this descent is done: found, or fell off the tree
+            emit(lookup.index, (order == 0) ? node : nullptr);
+            if(next < count)
+            {
+                lookup.node = root_;
+                lookup.index = next++;
+                ++i;
+            }
+            else
+            {
+                lookup = inFlight[--active];
+            }
+        }
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::makeIterator(Node<Key, Value>* node)
+{
+    return iterator(this, node);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::makeIterator(Node<Key, Value>* node) const
+{
+    return const_iterator(this, node);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Value& BinarySearchTree<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+template<class Key, class Value, class Compare, class Alloc>
+Value const & BinarySearchTree<Key, Value, Compare, Alloc>::operator[](const Key& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* An insert method to insert into a Binary Search Tree.
+* The tree will not remain balanced when inserting.
+* Recall: If key is already in the tree, you should 
+* overwrite the current value with the updated value.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    // TODO
+    return insertOrAssignNode<Node<Key, Value> >(keyValuePair.first, keyValuePair.second);
+}
+
+/**
+* Same as above, but moves the value into the tree. (The key of a
+* std::pair<const Key, Value> can only be copied.)
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::insert(std::pair<const Key, Value>&& keyValuePair)
+{
+    return insertOrAssignNode<Node<Key, Value> >(keyValuePair.first, std::move(keyValuePair.second));
+}
+
+/**
+* Same as insert(keyValuePair), with the search starting at hint; see
+* findFinger. end() is the natural hint for keys that arrive in order.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::insert(const_iterator hint, const std::pair<const Key, Value>& keyValuePair)
+{
+    return insertOrAssignNode<Node<Key, Value> >(keyValuePair.first, keyValuePair.second,
+                                                 findFinger(hint, keyValuePair.first)).first;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator
+BinarySearchTree<Key, Value, Compare, Alloc>::insert(const_iterator hint, std::pair<const Key, Value>&& keyValuePair)
+{
+    return insertOrAssignNode<Node<Key, Value> >(keyValuePair.first, std::move(keyValuePair.second),
+                                                 findFinger(hint, keyValuePair.first)).first;
+}
+
+/**
+* Builds the item from args. If the arguments are a key and a value, the
+* key is looked up first, as in try_emplace. Otherwise the node has to be
+* built before its key is known, and is thrown away if the key exists.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::emplace(Args&&... args)
+{
+    return emplaceNode<Node<Key, Value> >(EmplacesKeyValue<Args...>(), std::forward<Args>(args)...);
+}
+
+/**
+* Inserts key with a value built in place from args, unless key exists.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::try_emplace(const Key& key, Args&&... args)
+{
+    return tryEmplaceNode<Node<Key, Value> >(key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::try_emplace(Key&& key, Args&&... args)
+{
+    return tryEmplaceNode<Node<Key, Value> >(std::move(key), std::forward<Args>(args)...);
+}
+
+/**
+* Inserts key with value, or assigns value to key if it exists.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::insert_or_assign(const Key& key, V&& value)
+{
+    return insertOrAssignNode<Node<Key, Value> >(key, std::forward<V>(value));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::insert_or_assign(Key&& key, V&& value)
+{
+    return insertOrAssignNode<Node<Key, Value> >(std::move(key), std::forward<V>(value));
+}
+
+/**
+* Descends from the root to key. Returns its node if it is in the tree.
+* Otherwise returns nullptr, with parent set to the node under which key
+* belongs (nullptr for an empty tree) and isLeft telling on which side.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::findSlot(const Key& key, Node<Key, Value>*& parent, bool& isLeft,
+                                                                        Node<Key, Value>* start) const
+{
+    Node<Key, Value>* current = (start != nullptr) ? start : root_;
+    parent = nullptr;
+    isLeft = false;
+
+    //traversing through tree to find the correct spot to insert
+    while(current != nullptr)
+    {
+        const int order = compareKeys(comp_, key, current->getKey());
+        if(order < 0)
+        {
+            //go left if key is less than current node's key
+            parent = current;
+            isLeft = true;
+            current = current->getLeft();
+        }
+        else if(order > 0)
+        {
+            //go right if key is greater than current node's key
+            parent = current;
+            isLeft = false;
+            current = current->getRight();
+        }
+        else
+        {
+            //key is already in tree
+            return current;
+        }
+    }
+    return nullptr;
+}
+
+/**
+* Finger search: starting at the node of hint (the largest node for end()),
+* climbs to the first ancestor whose subtree is bounded on both sides by
+* keys around key, so that key, or its slot, must be inside it.
+*
+* A key beyond either end of the tree would climb all the way up, so it
+* is checked against the cached ends first: appending to a sorted stream,
+* with end() or the iterator returned by the last insert as the hint,
+* finds the slot in O(1). A near-sorted stream mostly stays in small
+* subtrees around the hint, so its searches are cheap amortized over the
+* stream; a single key can still be close to the hint in order but far
+* from it in the tree (the root's successor, hinted with its predecessor),
+* and then the climb and the descent both cost O(log n).
+* hint must belong to this tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::findFinger(const_iterator hint, const Key& key) const
+{
+    Node<Key, Value>* current = (hint.current_ != nullptr) ? hint.current_ : rightmost_;
+    if(current == nullptr)
+    {
+        return root_;
+    }
+    const int order = compareKeys(comp_, key, current->getKey());
+    if(order == 0)
+    {
+        return current;
+    }
+    if(order > 0 && compareKeys(comp_, rightmost_->getKey(), key) < 0)
+    {
+        return rightmost_;
+    }
+    if(order < 0 && compareKeys(comp_, key, leftmost_->getKey()) < 0)
+    {
+        return leftmost_;
+    }
+
+    //the keys in current's subtree are on one side of key, so only an
+    //ancestor we reach from the other side can bound it
+    while(current->getParent() != nullptr)
+    {
+        Node<Key, Value>* parent = current->getParent();
+        const bool fromLeft = (parent->getLeft() == current);
+        if(fromLeft == (order > 0))
+        {
+            const int parentOrder = compareKeys(comp_, key, parent->getKey());
+            if(parentOrder == 0)
+            {
+                return parent;
+            }
+            if((parentOrder < 0) == (order > 0))
+            {
+                return current;
+            }
+        }
+        current = parent;
+    }
+    return current;
+}
+
+/**
+* Links a new leaf into the slot found by findSlot.
+* The plain BST does not rebalance.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft)
+{
+    node->setParent(parent);
+    //if tree is empty
+    if(parent == nullptr)
+    {
+        root_ = node;
+    }
+    else if(isLeft)
+    {
+        parent->setLeft(node);
+    }
+    else
+    {
+        parent->setRight(node);
+    }
+    nodeAttached(node, parent, isLeft);
+}
+
+/**
+* Nothing depends on the values in a plain BST.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::valueChanged(Node<Key, Value>*)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename NodeType, typename K, typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::insertOrAssignNode(K&& key, V&& value, Node<Key, Value>* start)
+{
+    Node<Key, Value>* parent;
+    bool isLeft;
+    Node<Key, Value>* existing = findSlot(key, parent, isLeft, start);
+    if(existing != nullptr)
+    {
+        //if key is already in tree, overwrite with new value
+        existing->getValue() = std::forward<V>(value);
+        valueChanged(existing);
+        return std::make_pair(iterator(this, existing), false);
+    }
+
+    //inserting new node at end
+    NodeType* newNode = createNode<NodeType>(parent, std::forward<K>(key), std::forward<V>(value));
+    attachNode(newNode, parent, isLeft);
+    return std::make_pair(iterator(this, newNode), true);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename NodeType, typename K, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::tryEmplaceNode(K&& key, Args&&... args)
+{
+    Node<Key, Value>* parent;
+    bool isLeft;
+    Node<Key, Value>* existing = findSlot(key, parent, isLeft);
+    if(existing != nullptr)
+    {
+        return std::make_pair(iterator(this, existing), false);
+    }
+
+    NodeType* newNode = createNode<NodeType>(parent, std::piecewise_construct,
+        std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+    attachNode(newNode, parent, isLeft);
+    return std::make_pair(iterator(this, newNode), true);
+}
+
+/**
+* emplace() with a key and a value: look the key up first.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename NodeType, typename K, typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::emplaceNode(std::true_type, K&& key, V&& value)
+{
+    return tryEmplaceNode<NodeType>(std::forward<K>(key), std::forward<V>(value));
+}
+
+/**
+* Any other emplace(): the key is only known once the item exists, so the
+* node is built first and destroyed again if its key is already in the tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+template<typename NodeType, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator, bool>
+BinarySearchTree<Key, Value, Compare, Alloc>::emplaceNode(std::false_type, Args&&... args)
+{
+    NodeType* newNode = createNode<NodeType>(nullptr, std::forward<Args>(args)...);
+    Node<Key, Value>* parent;
+    bool isLeft;
+    Node<Key, Value>* existing = findSlot(newNode->getKey(), parent, isLeft);
+    if(existing != nullptr)
+    {
+        destroyNode(newNode);
+        return std::make_pair(iterator(this, existing), false);
+    }
+    attachNode(newNode, parent, isLeft);
+    return std::make_pair(iterator(this, newNode), true);
+}
+
+
+/**
+* A remove method to remove a specific key from a Binary Search Tree.
+* Recall: The writeup specifies that if a node has 2 children you
+* should swap with the predecessor and then remove.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::remove(const Key& key)
+{
+    // TODO
+    Node<Key, Value>* removeNode = internalFind(key);
+
+    //node to remove does not exist in tree
+    if(removeNode == nullptr)
+    {
+        return;
+    }
+    eraseNode(removeNode);
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::eraseNode(Node<Key, Value>* removeNode)
+{
     //case 1 - the node we want to remove has 2 children. Swap with the predecessor of the node and remove 
     if(removeNode->getLeft() != nullptr && removeNode->getRight() != nullptr)
     {
         nodeSwap(removeNode, predecessor(removeNode));
     }
+    nodeDetaching(removeNode);
 
     //case 2 - the node we want to remove has at MOST 1 child (0 children or 1)
 
@@ -560,23 +1796,101 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     //if node to remove is right child of parent
     else
     {
-        parent->setRight(child);
-        //if child exists, set parent to parent of node to remove
-        if(child != nullptr)
-        {
-            child->setParent(parent);
-        }
+        parent->setRight(child);
+        //if child exists, set parent to parent of node to remove
+        if(child != nullptr)
+        {
+            child->setParent(parent);
+        }
+    }
+
+    destroyNode(removeNode);
+
+}
+
+/**
+* The smallest entry. Throws std::out_of_range if the tree is empty.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::pair<const Key, Value>& BinarySearchTree<Key, Value, Compare, Alloc>::front()
+{
+    if(leftmost_ == nullptr)
+    {
+        throw std::out_of_range("front: tree is empty");
+    }
+    return leftmost_->getItem();
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+const std::pair<const Key, Value>& BinarySearchTree<Key, Value, Compare, Alloc>::front() const
+{
+    if(leftmost_ == nullptr)
+    {
+        throw std::out_of_range("front: tree is empty");
+    }
+    return leftmost_->getItem();
+}
+
+/**
+* The largest entry. Throws std::out_of_range if the tree is empty.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::pair<const Key, Value>& BinarySearchTree<Key, Value, Compare, Alloc>::back()
+{
+    if(rightmost_ == nullptr)
+    {
+        throw std::out_of_range("back: tree is empty");
+    }
+    return rightmost_->getItem();
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+const std::pair<const Key, Value>& BinarySearchTree<Key, Value, Compare, Alloc>::back() const
+{
+    if(rightmost_ == nullptr)
+    {
+        throw std::out_of_range("back: tree is empty");
     }
+    return rightmost_->getItem();
+}
 
-    delete removeNode;
+/**
+* Removes the smallest entry and returns it, its value moved out. Unlike
+* remove(front().first), this does not search for the key again.
+* Throws std::out_of_range if the tree is empty.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::pair<Key, Value> BinarySearchTree<Key, Value, Compare, Alloc>::popMin()
+{
+    if(leftmost_ == nullptr)
+    {
+        throw std::out_of_range("popMin: tree is empty");
+    }
+    std::pair<Key, Value> item(leftmost_->getKey(), std::move(leftmost_->getValue()));
+    eraseNode(leftmost_);
+    return item;
+}
 
+/**
+* Same for the largest entry.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+std::pair<Key, Value> BinarySearchTree<Key, Value, Compare, Alloc>::popMax()
+{
+    if(rightmost_ == nullptr)
+    {
+        throw std::out_of_range("popMax: tree is empty");
+    }
+    std::pair<Key, Value> item(rightmost_->getKey(), std::move(rightmost_->getValue()));
+    eraseNode(rightmost_);
+    return item;
 }
 
 
 
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare, Alloc>::predecessor(Node<Key, Value>* current)
 {
     // TODO
     //case 1 - current pointer is not pointing to node anymore
@@ -584,7 +1898,9 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
     {
         return nullptr;
     }
-
+#ifdef BST_THREADED_NODES
+    return current->getPrev();
+#else
     //case 2 - if the current has a left child, go to the rightmost node of that left subtree (predecessor)
     if(current->getLeft() != nullptr)
     {
@@ -607,19 +1923,22 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
         }
         return current->getParent();
     }
-
+#endif
 }
 
 //writing successor function for increment operator in iterator class
-template<class Key, class Value>
+template<class Key, class Value, class Compare, class Alloc>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare, Alloc>::successor(Node<Key, Value>* current)
 {
     //case 1 - current pointer is not pointing to node anymore
     if(current == nullptr)
     {
         return nullptr;
     }
+#ifdef BST_THREADED_NODES
+    return current->getNext();
+#else
     //case 2 - if the current has a right child, go to the leftmost node of that right subtree (successor)
     if(current->getRight() != nullptr)
     {
@@ -642,33 +1961,372 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
         }
         return current->getParent();
     }
-    
+#endif
 }
 
 
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
+* Runs in O(n): the nodes are freed in a single pass, without recursion
+* (so even a degenerate tree cannot overflow the stack) and without the
+* per-key search and rebalancing of remove().
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::clear()
 {
     // TODO
-    while(root_ != nullptr)
+    destroyAllNodes();
+    root_ = nullptr;
+    leftmost_ = nullptr;
+    rightmost_ = nullptr;
+    releaseNodeMemory();
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::destroyAllNodes()
+{
+    destroySubtree(root_);
+}
+
+/**
+* Copies root and everything below it into new nodes of the same type, in
+* pre-order and without recursion. Returns the copy of root, whose parent
+* is nullptr. If a copy throws, the nodes copied so far are freed again.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType>
+NodeType* BinarySearchTree<Key, Value, Compare, Alloc>::cloneSubtree(const NodeType* root)
+{
+    if(root == nullptr)
+    {
+        return nullptr;
+    }
+    NodeType* copyRoot = createNode<NodeType>(nullptr, root->getItem());
+    copyRoot->copyMetadata(*root);
+
+    const NodeType* from = root;
+    NodeType* to = copyRoot;
+    try
+    {
+        while(true)
+        {
+            //copy the left subtree first, then the right one, then go back up
+            if(from->getLeft() != nullptr && to->getLeft() == nullptr)
+            {
+                from = from->getLeft();
+                to->setLeft(createNode<NodeType>(to, from->getItem()));
+                to = to->getLeft();
+                to->copyMetadata(*from);
+            }
+            else if(from->getRight() != nullptr && to->getRight() == nullptr)
+            {
+                from = from->getRight();
+                to->setRight(createNode<NodeType>(to, from->getItem()));
+                to = to->getRight();
+                to->copyMetadata(*from);
+            }
+            else if(from == root)
+            {
+                break;
+            }
+            else
+            {
+                from = from->getParent();
+                to = to->getParent();
+            }
+        }
+    }
+    catch(...)
+    {
+        destroySubtree(copyRoot);
+        throw;
+    }
+    threadSubtree(copyRoot);
+    return copyRoot;
+}
+
+/**
+* Links a new leaf in between its in-order neighbours, one of which is its
+* parent: a left child comes right before its parent, a right child right
+* after it.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::threadLeaf(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft)
+{
+#ifdef BST_THREADED_NODES
+    if(parent == nullptr)
+    {
+        node->setPrev(nullptr);
+        node->setNext(nullptr);
+        return;
+    }
+    Node<Key, Value>* prev = isLeft ? parent->getPrev() : parent;
+    Node<Key, Value>* next = isLeft ? parent : parent->getNext();
+    node->setPrev(prev);
+    node->setNext(next);
+    if(prev != nullptr)
+    {
+        prev->setNext(node);
+    }
+    if(next != nullptr)
+    {
+        next->setPrev(node);
+    }
+#else
+    (void)node;
+    (void)parent;
+    (void)isLeft;
+#endif
+}
+
+/**
+* Takes a node that is about to be freed out of the thread.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::unthread(Node<Key, Value>* node)
+{
+#ifdef BST_THREADED_NODES
+    if(node->getPrev() != nullptr)
+    {
+        node->getPrev()->setNext(node->getNext());
+    }
+    if(node->getNext() != nullptr)
+    {
+        node->getNext()->setPrev(node->getPrev());
+    }
+#else
+    (void)node;
+#endif
+}
+
+/**
+* nodeSwap exchanges the places of two nodes in the tree, so they exchange
+* their places in the thread too. In remove() they are always neighbours.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::swapThreads(Node<Key, Value>* n1, Node<Key, Value>* n2)
+{
+#ifdef BST_THREADED_NODES
+    if(n2->getNext() == n1)
+    {
+        std::swap(n1, n2);
+    }
+    if(n1->getNext() == n2)
+    {
+        //neighbours: prev, n1, n2, next becomes prev, n2, n1, next
+        Node<Key, Value>* prev = n1->getPrev();
+        Node<Key, Value>* next = n2->getNext();
+        n2->setPrev(prev);
+        n2->setNext(n1);
+        n1->setPrev(n2);
+        n1->setNext(next);
+        if(prev != nullptr)
+        {
+            prev->setNext(n2);
+        }
+        if(next != nullptr)
+        {
+            next->setPrev(n1);
+        }
+        return;
+    }
+    Node<Key, Value>* n1Prev = n1->getPrev();
+    Node<Key, Value>* n1Next = n1->getNext();
+    Node<Key, Value>* n2Prev = n2->getPrev();
+    Node<Key, Value>* n2Next = n2->getNext();
+    n1->setPrev(n2Prev);
+    n1->setNext(n2Next);
+    n2->setPrev(n1Prev);
+    n2->setNext(n1Next);
+    if(n1Prev != nullptr)
+    {
+        n1Prev->setNext(n2);
+    }
+    if(n1Next != nullptr)
+    {
+        n1Next->setPrev(n2);
+    }
+    if(n2Prev != nullptr)
+    {
+        n2Prev->setNext(n1);
+    }
+    if(n2Next != nullptr)
+    {
+        n2Next->setPrev(n1);
+    }
+#else
+    (void)n1;
+    (void)n2;
+#endif
+}
+
+/**
+* Relinks the whole thread of a subtree in one in-order walk, for code that
+* rebuilds trees wholesale (copies, bulk loads, set operations). The ends of
+* the thread are left null.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::threadSubtree(Node<Key, Value>* root)
+{
+#ifdef BST_THREADED_NODES
+    if(root == nullptr)
+    {
+        return;
+    }
+    Node<Key, Value>* current = root;
+    while(current->getLeft() != nullptr)
+    {
+        current = current->getLeft();
+    }
+    Node<Key, Value>* prev = nullptr;
+    while(current != nullptr)
+    {
+        current->setPrev(prev);
+        if(prev != nullptr)
+        {
+            prev->setNext(current);
+        }
+        prev = current;
+
+        //the structural successor, as successor() finds it without threads
+        if(current->getRight() != nullptr)
+        {
+            current = current->getRight();
+            while(current->getLeft() != nullptr)
+            {
+                current = current->getLeft();
+            }
+        }
+        else
+        {
+            while(current->getParent() != nullptr && current->getParent()->getRight() == current)
+            {
+                current = current->getParent();
+            }
+            current = current->getParent();
+        }
+    }
+    prev->setNext(nullptr);
+#else
+    (void)root;
+#endif
+}
+
+/**
+* Links the threads of two subtrees whose keys are in order, through middle
+* if it is not null, in O(log n).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::joinThreads(Node<Key, Value>* leftRoot, Node<Key, Value>* middle,
+                                                               Node<Key, Value>* rightRoot)
+{
+#ifdef BST_THREADED_NODES
+    Node<Key, Value>* last = leftRoot;
+    while(last != nullptr && last->getRight() != nullptr)
+    {
+        last = last->getRight();
+    }
+    Node<Key, Value>* first = rightRoot;
+    while(first != nullptr && first->getLeft() != nullptr)
+    {
+        first = first->getLeft();
+    }
+    if(middle != nullptr)
+    {
+        middle->setPrev(last);
+        middle->setNext(first);
+        if(last != nullptr)
+        {
+            last->setNext(middle);
+        }
+        if(first != nullptr)
+        {
+            first->setPrev(middle);
+        }
+    }
+    else
     {
-        remove(root_->getKey());
+        if(last != nullptr)
+        {
+            last->setNext(first);
+        }
+        if(first != nullptr)
+        {
+            first->setPrev(last);
+        }
+    }
+#else
+    (void)leftRoot;
+    (void)middle;
+    (void)rightRoot;
+#endif
+}
+
+/**
+* Cuts the thread between two subtrees that used to be one, in O(log n).
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::cutThreads(Node<Key, Value>* leftRoot, Node<Key, Value>* rightRoot)
+{
+#ifdef BST_THREADED_NODES
+    Node<Key, Value>* last = leftRoot;
+    while(last != nullptr && last->getRight() != nullptr)
+    {
+        last = last->getRight();
+    }
+    Node<Key, Value>* first = rightRoot;
+    while(first != nullptr && first->getLeft() != nullptr)
+    {
+        first = first->getLeft();
+    }
+    if(last != nullptr)
+    {
+        last->setNext(nullptr);
     }
+    if(first != nullptr)
+    {
+        first->setPrev(nullptr);
+    }
+#else
+    (void)leftRoot;
+    (void)rightRoot;
+#endif
+}
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::cloneNodes(const Node<Key, Value>* root)
+{
+    return cloneSubtree(root);
 }
 
 
 /**
 * A helper function to find the smallest node in the tree.
+* The tree keeps track of it, so this is O(1).
 */
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Compare, typename Alloc>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+BinarySearchTree<Key, Value, Compare, Alloc>::getSmallestNode() const
 {
     // TODO
+    return leftmost_;
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::getLargestNode() const
+{
+    return rightmost_;
+}
+
+/**
+* Finds both ends again by walking down the spines, in O(log n) for a
+* balanced tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::refreshBounds()
+{
     Node<Key, Value>* current = root_;
     //go to leftmost node in tree (in bst leftmost node is smallest)
     while(current != nullptr && current->getLeft() != nullptr)
@@ -676,8 +2334,54 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
         //keep moving left until null
         current = current->getLeft();
     }
-    return current;
+    leftmost_ = current;
+    current = root_;
+    while(current != nullptr && current->getRight() != nullptr)
+    {
+        current = current->getRight();
+    }
+    rightmost_ = current;
+}
+
+/**
+* A new leaf is a new end of the tree when it hangs to the left of the
+* smallest node or to the right of the largest one.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::nodeAttached(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft)
+{
+    if(parent == nullptr)
+    {
+        leftmost_ = node;
+        rightmost_ = node;
+    }
+    else if(isLeft && parent == leftmost_)
+    {
+        leftmost_ = node;
+    }
+    else if(!isLeft && parent == rightmost_)
+    {
+        rightmost_ = node;
+    }
+    threadLeaf(node, parent, isLeft);
+}
 
+/**
+* Called while node is still linked in, with at most one child. An end that
+* goes away passes to its in-order neighbour.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::nodeDetaching(Node<Key, Value>* node)
+{
+    if(node == leftmost_)
+    {
+        leftmost_ = successor(node);
+    }
+    if(node == rightmost_)
+    {
+        rightmost_ = predecessor(node);
+    }
+    unthread(node);
 }
 
 /**
@@ -685,20 +2389,31 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
 * return a pointer to it or NULL if no item with that key
 * exists
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::internalFind(const Key& key) const
 {
     // TODO
+    return findNode(key);
+}
+
+/**
+* The search loop behind internalFind and the heterogeneous find.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::findNode(const K& key) const
+{
     Node<Key, Value>* current = root_;
     while(current!= nullptr)
     {
+        const int order = compareKeys(comp_, key, current->getKey());
         //if desired key is LESS THAN current node's key, go LEFT
-        if(key < current->getKey())
+        if(order < 0)
         {
             current = current->getLeft();
         }
         //if desired key is GREATER THAN current node's key, go RIGHT
-        else if(key > current->getKey())
+        else if(order > 0)
         {
             current = current->getRight();
         }
@@ -713,21 +2428,50 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) con
 
 }
 
+/**
+* Remembers the last node where the search went left: it is the bound
+* unless the subtree the search went into has a closer one.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare, Alloc>::boundNode(const Key& key, bool strict) const
+{
+    Node<Key, Value>* bound = nullptr;
+    Node<Key, Value>* current = root_;
+    while(current != nullptr)
+    {
+        const int order = compareKeys(comp_, key, current->getKey());
+        if(order == 0 && !strict)
+        {
+            return current;
+        }
+        if(order < 0)
+        {
+            bound = current;
+            current = current->getLeft();
+        }
+        else
+        {
+            current = current->getRight();
+        }
+    }
+    return bound;
+}
+
 
 
 /**
  * Return true iff the BST is balanced.
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::isBalanced() const
 {
     // TODO
     return isBalancedHelper(root_);
 }
 
 //helper function isBalancedHelper - isBalanced helper
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalancedHelper(Node<Key, Value>* root) const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+bool BinarySearchTree<Key, Value, Compare, Alloc>::isBalancedHelper(Node<Key, Value>* root) const
 {
     //base case, empty tree
 	if(root == nullptr)
@@ -756,8 +2500,8 @@ bool BinarySearchTree<Key, Value>::isBalancedHelper(Node<Key, Value>* root) cons
 }
 
 //helper function to get height of a node - isBalanced helper
-template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::getHeight(Node<Key, Value>* root) const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+int BinarySearchTree<Key, Value, Compare, Alloc>::getHeight(Node<Key, Value>* root) const
 {
     //base case, empty tree
 	if(root == nullptr)
@@ -773,10 +2517,112 @@ int BinarySearchTree<Key, Value>::getHeight(Node<Key, Value>* root) const
 	return std::max(leftHeight, rightHeight) + 1;
 }
 
+/**
+* Allocates a node of the given type through the tree's allocator and
+* builds its item in place from itemArgs.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType, typename... Args>
+NodeType* BinarySearchTree<Key, Value, Compare, Alloc>::createNode(Node<Key, Value>* parent, Args&&... itemArgs)
+{
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<NodeType> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeTraits;
+    NodeAlloc nodeAlloc(alloc_);
+    NodeType* node = NodeTraits::allocate(nodeAlloc, 1);
+    try
+    {
+        NodeTraits::construct(nodeAlloc, node, static_cast<NodeType*>(parent), std::forward<Args>(itemArgs)...);
+    }
+    catch(...)
+    {
+        NodeTraits::deallocate(nodeAlloc, node, 1);
+        throw;
+    }
+    return node;
+}
+
+/**
+* Destroys a node and hands its memory back to the tree's allocator.
+* The node must be passed as its own type, since nodes have no virtual destructor.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType>
+void BinarySearchTree<Key, Value, Compare, Alloc>::destroyNode(NodeType* node)
+{
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<NodeType> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeTraits;
+    NodeAlloc nodeAlloc(alloc_);
+    NodeTraits::destroy(nodeAlloc, node);
+    NodeTraits::deallocate(nodeAlloc, node, 1);
+}
+
+/**
+* Destroys root and everything below it in one pass, with no recursion and
+* no rebalancing: each leaf is unlinked from its parent and destroyed, which
+* turns the parent into a leaf. root's own parent is not touched.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+template<typename NodeType>
+void BinarySearchTree<Key, Value, Compare, Alloc>::destroySubtree(NodeType* root)
+{
+    NodeType* current = root;
+    while(current != nullptr)
+    {
+        if(current->getLeft() != nullptr)
+        {
+            current = current->getLeft();
+        }
+        else if(current->getRight() != nullptr)
+        {
+            current = current->getRight();
+        }
+        else
+        {
+            NodeType* parent = (current == root) ? nullptr : current->getParent();
+            if(parent != nullptr)
+            {
+                if(parent->getLeft() == current)
+                {
+                    parent->setLeft(nullptr);
+                }
+                else
+                {
+                    parent->setRight(nullptr);
+                }
+            }
+            destroyNode(current);
+            current = parent;
+        }
+    }
+}
+
+// allocators that cache memory (see pool_alloc.h) provide release(),
+// which clear() uses to give back all of it at once
+template<typename A>
+auto releaseAllocator(A& alloc, int) -> decltype(alloc.release(), void())
+{
+    alloc.release();
+}
 
+template<typename A>
+void releaseAllocator(A&, long)
+{
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+}
+
+/**
+* Called once the tree is empty: lets the allocator drop its cached node memory in bulk.
+*/
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::releaseNodeMemory()
+{
+    releaseAllocator(alloc_, 0);
+}
+
+
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
@@ -857,6 +2703,7 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
         this->root_ = n1;
     }
 
+    swapThreads(n1, n2);
 }
 
 /**
@@ -0,0 +1,1125 @@
+#ifndef CONCURRENT_AVLBST_H
+#define CONCURRENT_AVLBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+* A map that many threads can read and write at once: a relaxed AVL tree
+* after Bronson, Casper, Chafi and Olukotun, "A Practical Concurrent Binary
+* Search Tree" (PPoPP 2010).
+*
+* Every node has a version number that a rotation bumps when it moves the
+* node down. A lookup takes no locks and stores nothing. It reads a child
+* pointer and then checks that the parent's version is unchanged. If the
+* version changed, it backs up one level and tries again. If the child is
+* in the middle of a rotation, it spins (yielding) until the rotation is
+* done. Writers lock only what they change: the parent of a new leaf, the
+* node whose value they replace, or the parent and the node they unlink.
+* A rotation locks the parent, the node and the one or two children that
+* move. Locks are always taken top down.
+*
+* A removed key with two children stays in the tree as a routing node
+* without a value. It is unlinked once it has at most one child. Heights
+* are repaired bottom up after each change, so the tree is only AVL
+* balanced when no writer is running.
+*
+* A node or value taken out of the tree may still be in use by a reader.
+* Nothing is freed while the tree is in use. reclaim() frees it when no
+* other thread uses the tree, and the destructor frees it otherwise. A
+* tree whose values are replaced often should call reclaim() from time to
+* time.
+*
+* find() copies the value out: Value must be copy constructible. Key must
+* be copy constructible, and Compare must be safe to call from several
+* threads.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class ConcurrentAVLTree
+{
+public:
+    ConcurrentAVLTree();
+    explicit ConcurrentAVLTree(const Compare& comp);
+    ~ConcurrentAVLTree();
+
+    ConcurrentAVLTree(const ConcurrentAVLTree&) = delete;
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree&) = delete;
+
+    // Safe to call from any number of threads at once.
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    // Sets the key's value. Returns true if the key was new.
+    bool insert(const std::pair<const Key, Value>& keyValuePair);
+    // Returns true if the key was there.
+    bool remove(const Key& key);
+
+    // Only while no other thread uses the tree.
+    std::size_t size() const;
+    bool isBalanced() const;
+    template<typename Fn>
+    void forEach(Fn fn) const;
+    void reclaim();
+
+protected:
+    // A value is never changed in place. A new value gets a new box, so a
+    // reader can still copy the old one.
+    struct ValueBox
+    {
+        explicit ValueBox(const Value& v) : value(v), nextRetired(nullptr) { }
+        const Value value;
+        ValueBox* nextRetired;
+    };
+
+    struct Node;
+
+    // What the nodes and the root holder have in common. The root holder
+    // has no key; the root is its right child.
+    struct Link
+    {
+        Link() : height_(0), version_(0), parent_(nullptr), left_(nullptr), right_(nullptr) { }
+        std::atomic<int> height_;
+        std::atomic<std::uint64_t> version_;
+        std::atomic<Link*> parent_;
+        std::atomic<Node*> left_;
+        std::atomic<Node*> right_;
+        std::mutex lock_;
+    };
+
+    struct Node : public Link
+    {
+        Node(const Key& key, ValueBox* value, Link* parent) : key_(key), value_(value), nextRetired_(nullptr)
+        {
+            this->height_ = 1;
+            this->parent_ = parent;
+        }
+        const Key key_;
+        std::atomic<ValueBox*> value_;  // nullptr: a routing node
+        Node* nextRetired_;
+    };
+
+    // Low version bits. The rest counts the rotations that moved the node down.
+    static const std::uint64_t UNLINKED = 1;
+    static const std::uint64_t SHRINKING = 2;
+
+    // What an attempt found. RETRY: the tree changed under it.
+    enum Attempt { RETRY, ABSENT, PRESENT };
+
+    // nodeCondition results other than a new height
+    static const int NOTHING_REQUIRED = -1;
+    static const int REBALANCE_REQUIRED = -2;
+    static const int UNLINK_REQUIRED = -3;
+
+    int direction(const Key& key, const Node* node) const;
+    static std::atomic<Node*>& child(Link* link, int dir);
+    static int height(const Node* node);
+    static std::uint64_t beginChange(std::uint64_t version);
+    static std::uint64_t endChange(std::uint64_t version);
+    static void waitUntilNotChanging(const Node* node);
+
+    Attempt attemptGet(const Key& key, Link* node, int dir, std::uint64_t nodeVersion, ValueBox*& found) const;
+    Attempt attemptPut(const Key& key, ValueBox* box, Link* node, int dir, std::uint64_t nodeVersion);
+    Attempt attemptInsert(const Key& key, ValueBox* box, Link* node, int dir, std::uint64_t nodeVersion);
+    Attempt attemptUpdate(Node* node, ValueBox* box);
+    Attempt attemptRemove(const Key& key, Link* node, int dir, std::uint64_t nodeVersion);
+    Attempt attemptRemoveNode(Link* parent, Node* node);
+
+    // Rebalancing. The _nl functions expect the caller to hold the locks of
+    // their first two arguments; they return the next node to repair.
+    void fixHeightAndRebalance(Link* link);
+    int nodeCondition(Node* node) const;
+    Link* fixHeight_nl(Link* link);
+    Link* rebalance_nl(Link* parent, Node* node);
+    Link* rebalanceToRight_nl(Link* parent, Node* node, Node* left, int hR0);
+    Link* rebalanceToLeft_nl(Link* parent, Node* node, Node* right, int hL0);
+    Link* rotateRight_nl(Link* parent, Node* node, Node* left, int hR, int hLL, Node* leftRight, int hLR);
+    Link* rotateLeft_nl(Link* parent, Node* node, int hL, Node* right, Node* rightLeft, int hRL, int hRR);
+    Link* rotateRightOverLeft_nl(Link* parent, Node* node, Node* left, int hR, int hLL, Node* leftRight, int hLRL);
+    Link* rotateLeftOverRight_nl(Link* parent, Node* node, int hL, Node* right, Node* rightLeft, int hRR, int hRLR);
+    bool attemptUnlink_nl(Link* parent, Node* node);
+
+    void retire(Node* node);
+    void retire(ValueBox* box);
+    int checkHeights(const Node* node, bool& balanced) const;
+
+    mutable Link holder_;
+    std::atomic<Node*> retiredNodes_;
+    std::atomic<ValueBox*> retiredValues_;
+    Compare comp_;
+};
+
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::ConcurrentAVLTree() :
+    retiredNodes_(nullptr), retiredValues_(nullptr), comp_()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::ConcurrentAVLTree(const Compare& comp) :
+    retiredNodes_(nullptr), retiredValues_(nullptr), comp_(comp)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::~ConcurrentAVLTree()
+{
+    reclaim();
+    std::vector<Node*> pending;
+    if(holder_.right_ != nullptr)
+    {
+        pending.push_back(holder_.right_);
+    }
+    while(!pending.empty())
+    {
+        Node* node = pending.back();
+        pending.pop_back();
+        if(node->left_ != nullptr)
+        {
+            pending.push_back(node->left_);
+        }
+        if(node->right_ != nullptr)
+        {
+            pending.push_back(node->right_);
+        }
+        delete node->value_.load();
+        delete node;
+    }
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::find(const Key& key, Value& value) const
+{
+    ValueBox* found = nullptr;
+    while(attemptGet(key, &holder_, 1, 0, found) == RETRY)
+    {
+
+    }
+    if(found == nullptr)
+    {
+        return false;
+    }
+    value = found->value;
+    return true;
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::contains(const Key& key) const
+{
+    ValueBox* found = nullptr;
+    while(attemptGet(key, &holder_, 1, 0, found) == RETRY)
+    {
+
+    }
+    return found != nullptr;
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::unique_ptr<ValueBox> box(new ValueBox(keyValuePair.second));
+    Attempt result;
+    while((result = attemptPut(keyValuePair.first, box.get(), &holder_, 1, 0)) == RETRY)
+    {
+
+    }
+    box.release();
+    return result == ABSENT;
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    Attempt result;
+    while((result = attemptRemove(key, &holder_, 1, 0)) == RETRY)
+    {
+
+    }
+    return result == PRESENT;
+}
+
+template<class Key, class Value, class Compare>
+std::size_t ConcurrentAVLTree<Key, Value, Compare>::size() const
+{
+    std::size_t count = 0;
+    forEach([&count](const Key&, const Value&) { ++count; });
+    return count;
+}
+
+/*
+ * Checks the stored heights as well as the balance: a routing node counts
+ * like any other node.
+ */
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    bool balanced = true;
+    checkHeights(holder_.right_, balanced);
+    return balanced;
+}
+
+template<class Key, class Value, class Compare>
+int ConcurrentAVLTree<Key, Value, Compare>::checkHeights(const Node* node, bool& balanced) const
+{
+    if(node == nullptr)
+    {
+        return 0;
+    }
+    const int leftHeight = checkHeights(node->left_, balanced);
+    const int rightHeight = checkHeights(node->right_, balanced);
+    const int nodeHeight = 1 + std::max(leftHeight, rightHeight);
+    if(leftHeight - rightHeight > 1 || rightHeight - leftHeight > 1 || node->height_ != nodeHeight)
+    {
+        balanced = false;
+    }
+    return nodeHeight;
+}
+
+/*
+ * Calls fn(key, value) for every key, in key order.
+ */
+template<class Key, class Value, class Compare>
+template<typename Fn>
+void ConcurrentAVLTree<Key, Value, Compare>::forEach(Fn fn) const
+{
+    std::vector<const Node*> path;
+    const Node* node = holder_.right_;
+    while(node != nullptr || !path.empty())
+    {
+        while(node != nullptr)
+        {
+            path.push_back(node);
+            node = node->left_;
+        }
+        node = path.back();
+        path.pop_back();
+        const ValueBox* box = node->value_;
+        if(box != nullptr)
+        {
+            fn(node->key_, box->value);
+        }
+        node = node->right_;
+    }
+}
+
+/*
+ * Frees the nodes and values taken out of the tree since the last call.
+ */
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::reclaim()
+{
+    Node* node = retiredNodes_.exchange(nullptr);
+    while(node != nullptr)
+    {
+        Node* next = node->nextRetired_;
+        delete node;
+        node = next;
+    }
+    ValueBox* box = retiredValues_.exchange(nullptr);
+    while(box != nullptr)
+    {
+        ValueBox* next = box->nextRetired;
+        delete box;
+        box = next;
+    }
+}
+
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::retire(Node* node)
+{
+    node->nextRetired_ = retiredNodes_.load(std::memory_order_relaxed);
+    while(!retiredNodes_.compare_exchange_weak(node->nextRetired_, node))
+    {
+
+    }
+}
+
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::retire(ValueBox* box)
+{
+    box->nextRetired = retiredValues_.load(std::memory_order_relaxed);
+    while(!retiredValues_.compare_exchange_weak(box->nextRetired, box))
+    {
+
+    }
+}
+
+/*
+ * -1 if key belongs to the left of node, 1 if to the right, 0 if it is node's key.
+ */
+template<class Key, class Value, class Compare>
+int ConcurrentAVLTree<Key, Value, Compare>::direction(const Key& key, const Node* node) const
+{
+    if(comp_(key, node->key_))
+    {
+        return -1;
+    }
+    return comp_(node->key_, key) ? 1 : 0;
+}
+
+template<class Key, class Value, class Compare>
+std::atomic<typename ConcurrentAVLTree<Key, Value, Compare>::Node*>&
+ConcurrentAVLTree<Key, Value, Compare>::child(Link* link, int dir)
+{
+    return dir < 0 ? link->left_ : link->right_;
+}
+
+template<class Key, class Value, class Compare>
+int ConcurrentAVLTree<Key, Value, Compare>::height(const Node* node)
+{
+    return node == nullptr ? 0 : node->height_.load();
+}
+
+template<class Key, class Value, class Compare>
+std::uint64_t ConcurrentAVLTree<Key, Value, Compare>::beginChange(std::uint64_t version)
+{
+    return version | SHRINKING;
+}
+
+/*
+ * Clears SHRINKING and counts the change: the carry lands in the count bits.
+ */
+template<class Key, class Value, class Compare>
+std::uint64_t ConcurrentAVLTree<Key, Value, Compare>::endChange(std::uint64_t version)
+{
+    return (version | SHRINKING) + SHRINKING;
+}
+
+/*
+ * A rotation holds a node SHRINKING for a handful of stores. Readers spin
+ * through it rather than lock, yielding if it takes longer (e.g. when the
+ * writer was preempted).
+ */
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::waitUntilNotChanging(const Node* node)
+{
+    int spins = 0;
+    while((node->version_ & SHRINKING) != 0)
+    {
+        if(++spins >= 100)
+        {
+            std::this_thread::yield();
+            spins = 0;
+        }
+    }
+}
+
+/*
+ * Looks for key below child dir of node, which had version nodeVersion when
+ * the caller read it. Each child pointer read is checked against the
+ * version of the node it was read from: if that changed, the subtree may
+ * no longer hold the key and the caller has to look again.
+ */
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Attempt
+ConcurrentAVLTree<Key, Value, Compare>::attemptGet(const Key& key, Link* node, int dir, std::uint64_t nodeVersion, ValueBox*& found) const
+{
+    while(true)
+    {
+        Node* next = child(node, dir);
+        if(node->version_ != nodeVersion)
+        {
+            return RETRY;
+        }
+        if(next == nullptr)
+        {
+            found = nullptr;
+            return ABSENT;
+        }
+        const int nextDir = direction(key, next);
+        if(nextDir == 0)
+        {
+            found = next->value_;
+            return found != nullptr ? PRESENT : ABSENT;
+        }
+        const std::uint64_t nextVersion = next->version_;
+        if((nextVersion & SHRINKING) != 0)
+        {
+            waitUntilNotChanging(next);
+        }
+        else if((nextVersion & UNLINKED) == 0 && next == child(node, dir))
+        {
+            if(node->version_ != nodeVersion)
+            {
+                return RETRY;
+            }
+            const Attempt result = attemptGet(key, next, nextDir, nextVersion, found);
+            if(result != RETRY)
+            {
+                return result;
+            }
+        }
+    }
+}
+
+/*
+ * The same descent as attemptGet, which ends in attemptInsert or attemptUpdate.
+ */
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Attempt
+ConcurrentAVLTree<Key, Value, Compare>::attemptPut(const Key& key, ValueBox* box, Link* node, int dir, std::uint64_t nodeVersion)
+{
+    Attempt result = RETRY;
+    do
+    {
+        Node* next = child(node, dir);
+        if(node->version_ != nodeVersion)
+        {
+            return RETRY;
+        }
+        if(next == nullptr)
+        {
+            result = attemptInsert(key, box, node, dir, nodeVersion);
+            continue;
+        }
+        const int nextDir = direction(key, next);
+        if(nextDir == 0)
+        {
+            result = attemptUpdate(next, box);
+            continue;
+        }
+        const std::uint64_t nextVersion = next->version_;
+        if((nextVersion & SHRINKING) != 0)
+        {
+            waitUntilNotChanging(next);
+        }
+        else if((nextVersion & UNLINKED) == 0 && next == child(node, dir))
+        {
+            if(node->version_ != nodeVersion)
+            {
+                return RETRY;
+            }
+            result = attemptPut(key, box, next, nextDir, nextVersion);
+        }
+    } while(result == RETRY);
+    return result;
+}
+
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Attempt
+ConcurrentAVLTree<Key, Value, Compare>::attemptInsert(const Key& key, ValueBox* box, Link* node, int dir, std::uint64_t nodeVersion)
+{
+    {
+        std::lock_guard<std::mutex> guard(node->lock_);
+        if(node->version_ != nodeVersion || child(node, dir) != nullptr)
+        {
+            return RETRY;
+        }
+        child(node, dir) = new Node(key, box, node);
+    }
+    fixHeightAndRebalance(node);
+    return ABSENT;
+}
+
+/*
+ * Setting the value of a routing node puts its key back.
+ */
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Attempt
+ConcurrentAVLTree<Key, Value, Compare>::attemptUpdate(Node* node, ValueBox* box)
+{
+    ValueBox* previous;
+    {
+        std::lock_guard<std::mutex> guard(node->lock_);
+        if((node->version_ & UNLINKED) != 0)
+        {
+            return RETRY;
+        }
+        previous = node->value_.exchange(box);
+    }
+    if(previous == nullptr)
+    {
+        return ABSENT;
+    }
+    retire(previous);
+    return PRESENT;
+}
+
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Attempt
+ConcurrentAVLTree<Key, Value, Compare>::attemptRemove(const Key& key, Link* node, int dir, std::uint64_t nodeVersion)
+{
+    Attempt result = RETRY;
+    do
+    {
+        Node* next = child(node, dir);
+        if(node->version_ != nodeVersion)
+        {
+            return RETRY;
+        }
+        if(next == nullptr)
+        {
+            return ABSENT;
+        }
+        const int nextDir = direction(key, next);
+        if(nextDir == 0)
+        {
+            result = attemptRemoveNode(node, next);
+            continue;
+        }
+        const std::uint64_t nextVersion = next->version_;
+        if((nextVersion & SHRINKING) != 0)
+        {
+            waitUntilNotChanging(next);
+        }
+        else if((nextVersion & UNLINKED) == 0 && next == child(node, dir))
+        {
+            if(node->version_ != nodeVersion)
+            {
+                return RETRY;
+            }
+            result = attemptRemove(key, next, nextDir, nextVersion);
+        }
+    } while(result == RETRY);
+    return result;
+}
+
+/*
+ * A node with two children only loses its value and becomes a routing
+ * node. Otherwise it is spliced out under the locks of its parent and itself.
+ */
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Attempt
+ConcurrentAVLTree<Key, Value, Compare>::attemptRemoveNode(Link* parent, Node* node)
+{
+    if(node->value_ == nullptr)
+    {
+        return ABSENT;
+    }
+    ValueBox* previous;
+    if(node->left_ != nullptr && node->right_ != nullptr)
+    {
+        std::lock_guard<std::mutex> guard(node->lock_);
+        if((node->version_ & UNLINKED) != 0 || node->left_ == nullptr || node->right_ == nullptr)
+        {
+            return RETRY;
+        }
+        previous = node->value_.exchange(nullptr);
+    }
+    else
+    {
+        {
+            std::lock_guard<std::mutex> parentGuard(parent->lock_);
+            if((parent->version_ & UNLINKED) != 0 || node->parent_ != parent)
+            {
+                return RETRY;
+            }
+            std::lock_guard<std::mutex> guard(node->lock_);
+            previous = node->value_;
+            if(previous == nullptr)
+            {
+                return ABSENT;
+            }
+            if(!attemptUnlink_nl(parent, node))
+            {
+                return RETRY;
+            }
+        }
+        fixHeightAndRebalance(parent);
+    }
+    if(previous == nullptr)
+    {
+        return ABSENT;
+    }
+    retire(previous);
+    return PRESENT;
+}
+
+/*
+ * Walks up from link, fixing heights and rotating where needed, until a
+ * node needs nothing. A height fix only locks the node; a rotation or an
+ * unlink locks its parent first.
+ */
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::fixHeightAndRebalance(Link* link)
+{
+    while(link != nullptr && link != &holder_)
+    {
+        Node* node = static_cast<Node*>(link);
+        const int condition = nodeCondition(node);
+        if(condition == NOTHING_REQUIRED || (node->version_ & UNLINKED) != 0)
+        {
+            return;
+        }
+        if(condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED)
+        {
+            std::lock_guard<std::mutex> guard(node->lock_);
+            link = fixHeight_nl(node);
+        }
+        else
+        {
+            Link* parent = node->parent_;
+            Link* next = node;
+            bool rotated = false;
+            {
+                std::lock_guard<std::mutex> parentGuard(parent->lock_);
+                if((parent->version_ & UNLINKED) == 0 && node->parent_ == parent)
+                {
+                    std::lock_guard<std::mutex> guard(node->lock_);
+                    next = rebalance_nl(parent, node);
+                    rotated = node->parent_ != parent;
+                }
+            }
+            // A rotation that leaves a node below parent to repair may also
+            // have changed the height of parent's subtree: parent comes next.
+            if(next != nullptr && next != parent && next != parent->parent_ && (next != node || rotated))
+            {
+                fixHeightAndRebalance(next);
+                next = parent;
+            }
+            link = next;
+        }
+    }
+}
+
+/*
+ * UNLINK_REQUIRED for a routing node with at most one child,
+ * REBALANCE_REQUIRED if the children's heights differ by more than one,
+ * otherwise the node's correct height if it is off, or NOTHING_REQUIRED.
+ */
+template<class Key, class Value, class Compare>
+int ConcurrentAVLTree<Key, Value, Compare>::nodeCondition(Node* node) const
+{
+    Node* left = node->left_;
+    Node* right = node->right_;
+    if((left == nullptr || right == nullptr) && node->value_ == nullptr)
+    {
+        return UNLINK_REQUIRED;
+    }
+    const int hN = node->height_;
+    const int hL0 = height(left);
+    const int hR0 = height(right);
+    const int hNRepl = 1 + std::max(hL0, hR0);
+    const int balance = hL0 - hR0;
+    if(balance < -1 || balance > 1)
+    {
+        return REBALANCE_REQUIRED;
+    }
+    return hN != hNRepl ? hNRepl : NOTHING_REQUIRED;
+}
+
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Link*
+ConcurrentAVLTree<Key, Value, Compare>::fixHeight_nl(Link* link)
+{
+    if(link == &holder_)
+    {
+        return nullptr;
+    }
+    Node* node = static_cast<Node*>(link);
+    const int condition = nodeCondition(node);
+    switch(condition)
+    {
+    case REBALANCE_REQUIRED:
+    case UNLINK_REQUIRED:
+        return node;
+    case NOTHING_REQUIRED:
+        return nullptr;
+    default:
+        node->height_ = condition;
+        return node->parent_;
+    }
+}
+
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Link*
+ConcurrentAVLTree<Key, Value, Compare>::rebalance_nl(Link* parent, Node* node)
+{
+    Node* left = node->left_;
+    Node* right = node->right_;
+    if((left == nullptr || right == nullptr) && node->value_ == nullptr)
+    {
+        if(attemptUnlink_nl(parent, node))
+        {
+            return fixHeight_nl(parent);
+        }
+        return node;
+    }
+    const int hN = node->height_;
+    const int hL0 = height(left);
+    const int hR0 = height(right);
+    const int hNRepl = 1 + std::max(hL0, hR0);
+    const int balance = hL0 - hR0;
+    if(balance > 1)
+    {
+        return rebalanceToRight_nl(parent, node, left, hR0);
+    }
+    if(balance < -1)
+    {
+        return rebalanceToLeft_nl(parent, node, right, hL0);
+    }
+    if(hNRepl != hN)
+    {
+        node->height_ = hNRepl;
+        return fixHeight_nl(parent);
+    }
+    return nullptr;
+}
+
+/*
+ * node is too heavy on the left. Rotates right, or left-right if the left
+ * child leans right. If a left-right rotation would leave the left child
+ * unbalanced (only while other repairs are pending below), that child is
+ * rotated left first instead.
+ */
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Link*
+ConcurrentAVLTree<Key, Value, Compare>::rebalanceToRight_nl(Link* parent, Node* node, Node* left, int hR0)
+{
+    std::lock_guard<std::mutex> leftGuard(left->lock_);
+    const int hL = left->height_;
+    if(hL - hR0 <= 1)
+    {
+        return node;
+    }
+    Node* leftRight = left->right_;
+    const int hLL0 = height(left->left_);
+    const int hLR0 = height(leftRight);
+    if(hLL0 >= hLR0)
+    {
+        return rotateRight_nl(parent, node, left, hR0, hLL0, leftRight, hLR0);
+    }
+    {
+        std::lock_guard<std::mutex> leftRightGuard(leftRight->lock_);
+        const int hLR = leftRight->height_;
+        if(hLL0 >= hLR)
+        {
+            return rotateRight_nl(parent, node, left, hR0, hLL0, leftRight, hLR);
+        }
+        const int hLRL = height(leftRight->left_);
+        const int balance = hLL0 - hLRL;
+        if(balance >= -1 && balance <= 1)
+        {
+            return rotateRightOverLeft_nl(parent, node, left, hR0, hLL0, leftRight, hLRL);
+        }
+    }
+    return rebalanceToLeft_nl(node, left, leftRight, hLL0);
+}
+
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Link*
+ConcurrentAVLTree<Key, Value, Compare>::rebalanceToLeft_nl(Link* parent, Node* node, Node* right, int hL0)
+{
+    std::lock_guard<std::mutex> rightGuard(right->lock_);
+    const int hR = right->height_;
+    if(hL0 - hR >= -1)
+    {
+        return node;
+    }
+    Node* rightLeft = right->left_;
+    const int hRL0 = height(rightLeft);
+    const int hRR0 = height(right->right_);
+    if(hRR0 >= hRL0)
+    {
+        return rotateLeft_nl(parent, node, hL0, right, rightLeft, hRL0, hRR0);
+    }
+    {
+        std::lock_guard<std::mutex> rightLeftGuard(rightLeft->lock_);
+        const int hRL = rightLeft->height_;
+        if(hRR0 >= hRL)
+        {
+            return rotateLeft_nl(parent, node, hL0, right, rightLeft, hRL, hRR0);
+        }
+        const int hRLR = height(rightLeft->right_);
+        const int balance = hRR0 - hRLR;
+        if(balance >= -1 && balance <= 1)
+        {
+            return rotateLeftOverRight_nl(parent, node, hL0, right, rightLeft, hRR0, hRLR);
+        }
+    }
+    return rebalanceToRight_nl(node, right, rightLeft, hRR0);
+}
+
+/*
+ * node moves down, so it is marked SHRINKING while the links change:
+ * a reader below it may be looking for a key that is about to be above it.
+ * Returns whichever of the two nodes still needs work, else the parent.
+ */
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Link*
+ConcurrentAVLTree<Key, Value, Compare>::rotateRight_nl(Link* parent, Node* node, Node* left, int hR, int hLL, Node* leftRight, int hLR)
+{
+    const std::uint64_t nodeVersion = node->version_;
+    Node* parentLeft = parent->left_;
+    node->version_ = beginChange(nodeVersion);
+
+    node->left_ = leftRight;
+    if(leftRight != nullptr)
+    {
+        leftRight->parent_ = node;
+    }
+    left->right_ = node;
+    node->parent_ = left;
+    if(parentLeft == node)
+    {
+        parent->left_ = left;
+    }
+    else
+    {
+        parent->right_ = left;
+    }
+    left->parent_ = parent;
+
+    const int hNRepl = 1 + std::max(hLR, hR);
+    node->height_ = hNRepl;
+    left->height_ = 1 + std::max(hLL, hNRepl);
+    node->version_ = endChange(nodeVersion);
+
+    const int balanceN = hLR - hR;
+    if(balanceN < -1 || balanceN > 1)
+    {
+        return node;
+    }
+    if((leftRight == nullptr || hR == 0) && node->value_ == nullptr)
+    {
+        return node;
+    }
+    const int balanceL = hLL - hNRepl;
+    if(balanceL < -1 || balanceL > 1)
+    {
+        return left;
+    }
+    if(hLL == 0 && left->value_ == nullptr)
+    {
+        return left;
+    }
+    return fixHeight_nl(parent);
+}
+
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Link*
+ConcurrentAVLTree<Key, Value, Compare>::rotateLeft_nl(Link* parent, Node* node, int hL, Node* right, Node* rightLeft, int hRL, int hRR)
+{
+    const std::uint64_t nodeVersion = node->version_;
+    Node* parentLeft = parent->left_;
+    node->version_ = beginChange(nodeVersion);
+
+    node->right_ = rightLeft;
+    if(rightLeft != nullptr)
+    {
+        rightLeft->parent_ = node;
+    }
+    right->left_ = node;
+    node->parent_ = right;
+    if(parentLeft == node)
+    {
+        parent->left_ = right;
+    }
+    else
+    {
+        parent->right_ = right;
+    }
+    right->parent_ = parent;
+
+    const int hNRepl = 1 + std::max(hL, hRL);
+    node->height_ = hNRepl;
+    right->height_ = 1 + std::max(hNRepl, hRR);
+    node->version_ = endChange(nodeVersion);
+
+    const int balanceN = hRL - hL;
+    if(balanceN < -1 || balanceN > 1)
+    {
+        return node;
+    }
+    if((rightLeft == nullptr || hL == 0) && node->value_ == nullptr)
+    {
+        return node;
+    }
+    const int balanceR = hRR - hNRepl;
+    if(balanceR < -1 || balanceR > 1)
+    {
+        return right;
+    }
+    if(hRR == 0 && right->value_ == nullptr)
+    {
+        return right;
+    }
+    return fixHeight_nl(parent);
+}
+
+/*
+ * Both node and left move down; leftRight moves up to node's place.
+ */
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Link*
+ConcurrentAVLTree<Key, Value, Compare>::rotateRightOverLeft_nl(Link* parent, Node* node, Node* left, int hR, int hLL, Node* leftRight, int hLRL)
+{
+    const std::uint64_t nodeVersion = node->version_;
+    const std::uint64_t leftVersion = left->version_;
+    Node* parentLeft = parent->left_;
+    Node* leftRightLeft = leftRight->left_;
+    Node* leftRightRight = leftRight->right_;
+    const int hLRR = height(leftRightRight);
+
+    node->version_ = beginChange(nodeVersion);
+    left->version_ = beginChange(leftVersion);
+
+    node->left_ = leftRightRight;
+    if(leftRightRight != nullptr)
+    {
+        leftRightRight->parent_ = node;
+    }
+    left->right_ = leftRightLeft;
+    if(leftRightLeft != nullptr)
+    {
+        leftRightLeft->parent_ = left;
+    }
+    leftRight->left_ = left;
+    left->parent_ = leftRight;
+    leftRight->right_ = node;
+    node->parent_ = leftRight;
+    if(parentLeft == node)
+    {
+        parent->left_ = leftRight;
+    }
+    else
+    {
+        parent->right_ = leftRight;
+    }
+    leftRight->parent_ = parent;
+
+    const int hNRepl = 1 + std::max(hLRR, hR);
+    node->height_ = hNRepl;
+    const int hLRepl = 1 + std::max(hLL, hLRL);
+    left->height_ = hLRepl;
+    leftRight->height_ = 1 + std::max(hLRepl, hNRepl);
+
+    node->version_ = endChange(nodeVersion);
+    left->version_ = endChange(leftVersion);
+
+    const int balanceN = hLRR - hR;
+    if(balanceN < -1 || balanceN > 1)
+    {
+        return node;
+    }
+    if((leftRightRight == nullptr || hR == 0) && node->value_ == nullptr)
+    {
+        return node;
+    }
+    if((hLL == 0 || leftRightLeft == nullptr) && left->value_ == nullptr)
+    {
+        return left;
+    }
+    const int balanceLR = hLRepl - hNRepl;
+    if(balanceLR < -1 || balanceLR > 1)
+    {
+        return leftRight;
+    }
+    return fixHeight_nl(parent);
+}
+
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::Link*
+ConcurrentAVLTree<Key, Value, Compare>::rotateLeftOverRight_nl(Link* parent, Node* node, int hL, Node* right, Node* rightLeft, int hRR, int hRLR)
+{
+    const std::uint64_t nodeVersion = node->version_;
+    const std::uint64_t rightVersion = right->version_;
+    Node* parentLeft = parent->left_;
+    Node* rightLeftLeft = rightLeft->left_;
+    Node* rightLeftRight = rightLeft->right_;
+    const int hRLL = height(rightLeftLeft);
+
+    node->version_ = beginChange(nodeVersion);
+    right->version_ = beginChange(rightVersion);
+
+    node->right_ = rightLeftLeft;
+    if(rightLeftLeft != nullptr)
+    {
+        rightLeftLeft->parent_ = node;
+    }
+    right->left_ = rightLeftRight;
+    if(rightLeftRight != nullptr)
+    {
+        rightLeftRight->parent_ = right;
+    }
+    rightLeft->right_ = right;
+    right->parent_ = rightLeft;
+    rightLeft->left_ = node;
+    node->parent_ = rightLeft;
+    if(parentLeft == node)
+    {
+        parent->left_ = rightLeft;
+    }
+    else
+    {
+        parent->right_ = rightLeft;
+    }
+    rightLeft->parent_ = parent;
+
+    const int hNRepl = 1 + std::max(hL, hRLL);
+    node->height_ = hNRepl;
+    const int hRRepl = 1 + std::max(hRLR, hRR);
+    right->height_ = hRRepl;
+    rightLeft->height_ = 1 + std::max(hNRepl, hRRepl);
+
+    node->version_ = endChange(nodeVersion);
+    right->version_ = endChange(rightVersion);
+
+    const int balanceN = hRLL - hL;
+    if(balanceN < -1 || balanceN > 1)
+    {
+        return node;
+    }
+    if((rightLeftLeft == nullptr || hL == 0) && node->value_ == nullptr)
+    {
+        return node;
+    }
+    if((hRR == 0 || rightLeftRight == nullptr) && right->value_ == nullptr)
+    {
+        return right;
+    }
+    const int balanceRL = hRRepl - hNRepl;
+    if(balanceRL < -1 || balanceRL > 1)
+    {
+        return rightLeft;
+    }
+    return fixHeight_nl(parent);
+}
+
+/*
+ * Splices out node, which must have at most one child. Its version is
+ * marked UNLINKED, so readers and writers that still hold it start over.
+ */
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::attemptUnlink_nl(Link* parent, Node* node)
+{
+    Node* parentLeft = parent->left_;
+    Node* parentRight = parent->right_;
+    if(parentLeft != node && parentRight != node)
+    {
+        return false;
+    }
+    Node* left = node->left_;
+    Node* right = node->right_;
+    if(left != nullptr && right != nullptr)
+    {
+        return false;
+    }
+    Node* splice = (left != nullptr) ? left : right;
+    if(parentLeft == node)
+    {
+        parent->left_ = splice;
+    }
+    else
+    {
+        parent->right_ = splice;
+    }
+    if(splice != nullptr)
+    {
+        splice->parent_ = parent;
+    }
+    node->version_ = node->version_ | UNLINKED;
+    node->value_ = nullptr;
+    retire(node);
+    return true;
+}
+
+#endif
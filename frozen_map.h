@@ -0,0 +1,440 @@
+#ifndef FROZEN_MAP_H
+#define FROZEN_MAP_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* An immutable sorted map for data that is built once and then only read,
+* e.g. the result of AVLTree::freeze().
+*
+* The keys are stored in one array in Eytzinger order: the breadth first
+* order of a complete binary search tree, with the root at index 1 and the
+* children of k at 2k and 2k + 1. A search needs no pointers and no
+* branches: every level is one comparison whose result is added to the
+* next index, so there is nothing for the branch predictor to get wrong.
+* The first four levels share a cache line or two, and the node four
+* levels down lies in a block of 16 consecutive slots, which is prefetched
+* while the current levels are compared. The values are kept in a parallel
+* array and only touched once the key is found.
+*
+* Key and Value must be default constructible and copy assignable. Compare
+* should be cheap and branch free (std::less on arithmetic keys is).
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class FrozenMap
+{
+public:
+    FrozenMap();
+    explicit FrozenMap(const Compare& comp);
+    // Builds the map from a range of pairs sorted by key, in O(n). Unsorted
+    // or repeated keys throw std::invalid_argument.
+    template<typename ForwardIt>
+    FrozenMap(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+
+    bool empty() const;
+    std::size_t size() const;
+
+    /**
+    * An iterator over the entries in key order. Keys and values live in
+    * separate arrays, so *it is a pair of references rather than a
+    * reference to a pair; it->first and it->second work as usual.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key&, const Value&> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type reference;
+
+        // what operator-> returns: holds the pair it points to
+        class pointer
+        {
+        public:
+            explicit pointer(const value_type& item) : item_(item) { }
+            const value_type* operator->() const { return &item_; }
+        private:
+            value_type item_;
+        };
+
+        const_iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    protected:
+        friend class FrozenMap<Key, Value, Compare>;
+        const_iterator(const FrozenMap<Key, Value, Compare>* map, std::size_t index);
+        const FrozenMap<Key, Value, Compare>* map_;
+        std::size_t index_;     // Eytzinger index, 0 at the end
+    };
+    typedef const_iterator iterator;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lower_bound(const Key& key) const;
+    const_iterator upper_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+    // Calls fn(key, value) for every entry with low <= key <= high, in key order.
+    template<typename Fn>
+    void forEachInRange(const Key& low, const Key& high, Fn fn) const;
+
+protected:
+    std::size_t boundIndex(const Key& key, bool strict) const;
+    std::size_t firstIndex() const;
+    std::size_t lastIndex() const;
+    std::size_t nextIndex(std::size_t index) const;
+    std::size_t prevIndex(std::size_t index) const;
+    static std::size_t stripRightTurns(std::size_t index);
+
+protected:
+    // slot 0 is unused, so that the children of k are 2k and 2k + 1
+    std::vector<Key> keys_;
+    std::vector<Value> values_;
+    std::size_t size_;
+    Compare comp_;
+};
+
+/*
+  -------------------------------------------------------
+  Begin implementations for the FrozenMap::const_iterator class.
+  -------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+FrozenMap<Key, Value, Compare>::const_iterator::const_iterator() : map_(nullptr), index_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+FrozenMap<Key, Value, Compare>::const_iterator::const_iterator(const FrozenMap<Key, Value, Compare>* map, std::size_t index) :
+    map_(map), index_(index)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator::reference
+FrozenMap<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return value_type(map_->keys_[index_], map_->values_[index_]);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator::pointer
+FrozenMap<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return pointer(**this);
+}
+
+template<class Key, class Value, class Compare>
+bool FrozenMap<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return index_ == rhs.index_;
+}
+
+template<class Key, class Value, class Compare>
+bool FrozenMap<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return index_ != rhs.index_;
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator&
+FrozenMap<Key, Value, Compare>::const_iterator::operator++()
+{
+    index_ = map_->nextIndex(index_);
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator
+FrozenMap<Key, Value, Compare>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Stepping back from end() goes to the largest entry.
+*/
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator&
+FrozenMap<Key, Value, Compare>::const_iterator::operator--()
+{
+    index_ = (index_ == 0) ? map_->lastIndex() : map_->prevIndex(index_);
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator
+FrozenMap<Key, Value, Compare>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+  -----------------------------------------------------
+  End implementations for the FrozenMap::const_iterator class.
+  -----------------------------------------------------
+*/
+
+/*
+  -------------------------------------------
+  Begin implementations for the FrozenMap class.
+  -------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+FrozenMap<Key, Value, Compare>::FrozenMap() : keys_(1), values_(1), size_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+FrozenMap<Key, Value, Compare>::FrozenMap(const Compare& comp) : keys_(1), values_(1), size_(0), comp_(comp)
+{
+
+}
+
+/**
+* Walks the Eytzinger indices in key order (their in-order sequence) and
+* hands each one the next entry of the input.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+FrozenMap<Key, Value, Compare>::FrozenMap(ForwardIt first, ForwardIt last, const Compare& comp) :
+    size_(static_cast<std::size_t>(std::distance(first, last))), comp_(comp)
+{
+    keys_.resize(size_ + 1);
+    values_.resize(size_ + 1);
+    const Key* previous = nullptr;
+    for(std::size_t index = firstIndex(); first != last; ++first, index = nextIndex(index))
+    {
+        keys_[index] = first->first;
+        values_[index] = first->second;
+        if(previous != nullptr && !comp_(*previous, keys_[index]))
+        {
+            throw std::invalid_argument(comp_(keys_[index], *previous) ? "FrozenMap: keys are not sorted"
+                                                                      : "FrozenMap: duplicate key");
+        }
+        previous = &keys_[index];
+    }
+}
+
+template<class Key, class Value, class Compare>
+bool FrozenMap<Key, Value, Compare>::empty() const
+{
+    return size_ == 0;
+}
+
+template<class Key, class Value, class Compare>
+std::size_t FrozenMap<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator FrozenMap<Key, Value, Compare>::begin() const
+{
+    return const_iterator(this, firstIndex());
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator FrozenMap<Key, Value, Compare>::end() const
+{
+    return const_iterator(this, 0);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator FrozenMap<Key, Value, Compare>::find(const Key& key) const
+{
+    const std::size_t index = boundIndex(key, false);
+    return const_iterator(this, (index != 0 && !comp_(key, keys_[index])) ? index : 0);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator FrozenMap<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return const_iterator(this, boundIndex(key, false));
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenMap<Key, Value, Compare>::const_iterator FrozenMap<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return const_iterator(this, boundIndex(key, true));
+}
+
+/**
+* @precondition The key exists in the map
+* Returns the value associated with the key
+*/
+template<class Key, class Value, class Compare>
+Value const & FrozenMap<Key, Value, Compare>::operator[](const Key& key) const
+{
+    const std::size_t index = find(key).index_;
+    if(index == 0) throw std::out_of_range("Invalid key");
+    return values_[index];
+}
+
+template<class Key, class Value, class Compare>
+template<typename Fn>
+void FrozenMap<Key, Value, Compare>::forEachInRange(const Key& low, const Key& high, Fn fn) const
+{
+    for(std::size_t index = boundIndex(low, false); index != 0 && !comp_(high, keys_[index]); index = nextIndex(index))
+    {
+        fn(keys_[index], values_[index]);
+    }
+}
+
+/**
+* The branch free descent: at every level the comparison picks the left
+* (2k) or right (2k + 1) child, until k falls off the bottom. The last left
+* turn was taken at the first key not less than key (greater than key if
+* strict); stripping the right turns after it, and then that left turn,
+* gives its index, or 0 if there was no left turn at all.
+*/
+template<class Key, class Value, class Compare>
+std::size_t FrozenMap<Key, Value, Compare>::boundIndex(const Key& key, bool strict) const
+{
+    const Key* keys = keys_.data();
+    std::size_t index = 1;
+    if(strict)
+    {
+        while(index <= size_)
+        {
+            if(16 * index <= size_)
+            {
+                prefetchForRead(keys + 16 * index);
+            }
+            index = 2 * index + static_cast<std::size_t>(!comp_(key, keys[index]));
+        }
+    }
+    else
+    {
+        while(index <= size_)
+        {
+            if(16 * index <= size_)
+            {
+                prefetchForRead(keys + 16 * index);
+            }
+            index = 2 * index + static_cast<std::size_t>(comp_(keys[index], key));
+        }
+    }
+    return stripRightTurns(index) >> 1;
+}
+
+/**
+* Drops the trailing 1 bits of index, i.e. climbs while index is a right child.
+*/
+template<class Key, class Value, class Compare>
+std::size_t FrozenMap<Key, Value, Compare>::stripRightTurns(std::size_t index)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return index >> __builtin_ctzll(~static_cast<unsigned long long>(index));
+#else
+    while(index & 1)
+    {
+        index >>= 1;
+    }
+    return index;
+#endif
+}
+
+// the leftmost index, or 0 when empty
+template<class Key, class Value, class Compare>
+std::size_t FrozenMap<Key, Value, Compare>::firstIndex() const
+{
+    if(size_ == 0)
+    {
+        return 0;
+    }
+    std::size_t index = 1;
+    while(2 * index <= size_)
+    {
+        index = 2 * index;
+    }
+    return index;
+}
+
+template<class Key, class Value, class Compare>
+std::size_t FrozenMap<Key, Value, Compare>::lastIndex() const
+{
+    if(size_ == 0)
+    {
+        return 0;
+    }
+    std::size_t index = 1;
+    while(2 * index + 1 <= size_)
+    {
+        index = 2 * index + 1;
+    }
+    return index;
+}
+
+/**
+* The in-order successor in the implicit tree: the leftmost index of the
+* right subtree if there is one, else the parent of the last left child
+* on the way up. 0 after the last entry.
+*/
+template<class Key, class Value, class Compare>
+std::size_t FrozenMap<Key, Value, Compare>::nextIndex(std::size_t index) const
+{
+    if(2 * index + 1 <= size_)
+    {
+        index = 2 * index + 1;
+        while(2 * index <= size_)
+        {
+            index = 2 * index;
+        }
+        return index;
+    }
+    return stripRightTurns(index) >> 1;
+}
+
+template<class Key, class Value, class Compare>
+std::size_t FrozenMap<Key, Value, Compare>::prevIndex(std::size_t index) const
+{
+    if(2 * index <= size_)
+    {
+        index = 2 * index;
+        while(2 * index + 1 <= size_)
+        {
+            index = 2 * index + 1;
+        }
+        return index;
+    }
+    //climb while index is a left child, then once more
+    while(index != 0 && (index & 1) == 0)
+    {
+        index >>= 1;
+    }
+    return index >> 1;
+}
+
+/*
+  -----------------------------------------
+  End implementations for the FrozenMap class.
+  -----------------------------------------
+*/
+
+#endif
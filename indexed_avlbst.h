@@ -0,0 +1,931 @@
+#ifndef INDEXED_AVLBST_H
+#define INDEXED_AVLBST_H
+
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "bst.h"
+
+/**
+* An AVL tree whose nodes live in one contiguous, growable array and link to
+* each other with 32-bit indices instead of pointers. Slots of removed nodes
+* go on a free list and are reused by later inserts.
+*
+* Halving the links shrinks a node of AVLTree<uint64_t,uint64_t> from 48 to
+* 32 bytes, and keeps the nodes packed together however the tree was built.
+* Since no link is an address, the node array can be moved or written out
+* as a whole (for trivially copyable keys and values) without any fix-up.
+*
+* insert/remove/find/operator[] and the iterator behave like their AVLTree
+* counterparts. Inserting or removing invalidates iterators, since the node
+* array may be reallocated. A tree holds fewer than 2^32 entries.
+* Keys are ordered by Compare, through compareKeys (see bst.h).
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = std::allocator<std::pair<const Key, Value> > >
+class IndexedAVLTree
+{
+public:
+    typedef std::uint32_t Index;
+    static const Index NIL = 0xFFFFFFFFu;
+
+    IndexedAVLTree();
+    explicit IndexedAVLTree(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit IndexedAVLTree(const Alloc& alloc);
+    ~IndexedAVLTree();
+
+    void insert(const std::pair<const Key, Value>& new_item);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+    void reserve(std::size_t capacity);
+
+    /**
+    * An iterator over the contents of the tree, in key order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+
+    protected:
+        friend class IndexedAVLTree<Key, Value, Compare, Alloc>;
+        iterator(const IndexedAVLTree<Key, Value, Compare, Alloc>* tree, Index current);
+        const IndexedAVLTree<Key, Value, Compare, Alloc>* tree_;
+        Index current_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    typedef std::pair<const Key, Value> Item;
+
+    /**
+    * A slot of the node array. A free slot has no item constructed and
+    * keeps the next free slot in left.
+    */
+    struct IndexNode
+    {
+        typename std::aligned_storage<sizeof(Item), alignof(Item)>::type item;
+        Index parent;
+        Index left;
+        Index right;
+        int8_t balance;
+
+        Item& getItem() { return *reinterpret_cast<Item*>(&item); }
+        const Item& getItem() const { return *reinterpret_cast<const Item*>(&item); }
+    };
+
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<IndexNode> NodeAlloc;
+    typedef std::allocator_traits<NodeAlloc> NodeTraits;
+
+    IndexedAVLTree(const IndexedAVLTree&) = delete;
+    IndexedAVLTree& operator=(const IndexedAVLTree&) = delete;
+
+    Index internalFind(const Key& key) const;
+    Index getSmallestNode() const;
+    Index predecessor(Index current) const;
+    Index successor(Index current) const;
+
+    Index allocateSlot(const Item& item, Index parent);
+    void freeSlot(Index slot);
+    void grow(std::size_t capacity);
+
+    void nodeSwap(Index n1, Index n2);
+    void rotateLeft(Index node);
+    void rotateRight(Index node);
+    void insertFix(Index parent, Index node);
+    void removeFix(Index node, int diff);
+
+protected:
+    Compare comp_;
+    NodeAlloc alloc_;
+    IndexNode* nodes_;
+    std::size_t capacity_;  // slots allocated
+    std::size_t used_;      // slots ever handed out; every slot past it is untouched
+    std::size_t size_;
+    Index freeList_;
+    Index root_;
+};
+
+template<class Key, class Value, class Compare, class Alloc>
+const typename IndexedAVLTree<Key, Value, Compare, Alloc>::Index IndexedAVLTree<Key, Value, Compare, Alloc>::NIL;
+
+/*
+-----------------------------------------------------------
+Begin implementations for the IndexedAVLTree::iterator class.
+-----------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+IndexedAVLTree<Key, Value, Compare, Alloc>::iterator::iterator() : tree_(nullptr), current_(NIL)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+IndexedAVLTree<Key, Value, Compare, Alloc>::iterator::iterator(const IndexedAVLTree<Key, Value, Compare, Alloc>* tree, Index current) :
+    tree_(tree), current_(current)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<const Key,Value>&
+IndexedAVLTree<Key, Value, Compare, Alloc>::iterator::operator*() const
+{
+    return tree_->nodes_[current_].getItem();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+std::pair<const Key,Value>*
+IndexedAVLTree<Key, Value, Compare, Alloc>::iterator::operator->() const
+{
+    return &(tree_->nodes_[current_].getItem());
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+bool IndexedAVLTree<Key, Value, Compare, Alloc>::iterator::operator==(const iterator& rhs) const
+{
+    return current_ == rhs.current_;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+bool IndexedAVLTree<Key, Value, Compare, Alloc>::iterator::operator!=(const iterator& rhs) const
+{
+    return current_ != rhs.current_;
+}
+
+/**
+* Advances the iterator's location using an in-order sequencing
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::iterator&
+IndexedAVLTree<Key, Value, Compare, Alloc>::iterator::operator++()
+{
+    if(current_ != NIL)
+    {
+        current_ = tree_->successor(current_);
+    }
+    return *this;
+}
+
+/*
+---------------------------------------------------------
+End implementations for the IndexedAVLTree::iterator class.
+---------------------------------------------------------
+*/
+
+/*
+---------------------------------------------------
+Begin implementations for the IndexedAVLTree class.
+---------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+IndexedAVLTree<Key, Value, Compare, Alloc>::IndexedAVLTree() :
+    nodes_(nullptr), capacity_(0), used_(0), size_(0), freeList_(NIL), root_(NIL)
+{
+
+}
+
+/**
+* Constructs an empty tree whose node array is allocated with a copy of alloc.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+IndexedAVLTree<Key, Value, Compare, Alloc>::IndexedAVLTree(const Alloc& alloc) :
+    alloc_(alloc), nodes_(nullptr), capacity_(0), used_(0), size_(0), freeList_(NIL), root_(NIL)
+{
+
+}
+
+/**
+* Constructs an empty tree ordered by a copy of comp.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+IndexedAVLTree<Key, Value, Compare, Alloc>::IndexedAVLTree(const Compare& comp, const Alloc& alloc) :
+    comp_(comp), alloc_(alloc), nodes_(nullptr), capacity_(0), used_(0), size_(0), freeList_(NIL), root_(NIL)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+IndexedAVLTree<Key, Value, Compare, Alloc>::~IndexedAVLTree()
+{
+    clear();
+    if(nodes_ != nullptr)
+    {
+        NodeTraits::deallocate(alloc_, nodes_, capacity_);
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+bool IndexedAVLTree<Key, Value, Compare, Alloc>::empty() const
+{
+    return root_ == NIL;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t IndexedAVLTree<Key, Value, Compare, Alloc>::size() const
+{
+    return size_;
+}
+
+/**
+* Makes room for capacity nodes, so that many inserts do not reallocate the array.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::reserve(std::size_t capacity)
+{
+    if(capacity > capacity_)
+    {
+        grow(capacity);
+    }
+}
+
+/**
+* Destroys every item and forgets all slots. The node array itself is kept.
+* Every slot is visited in array order, which is linear in the slots used.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::clear()
+{
+    //mark the free slots, so that only live items are destroyed
+    for(Index slot = freeList_; slot != NIL; slot = nodes_[slot].left)
+    {
+        nodes_[slot].parent = slot;
+    }
+    for(std::size_t i = 0; i < used_; ++i)
+    {
+        if(nodes_[i].parent != i)
+        {
+            nodes_[i].getItem().~Item();
+        }
+    }
+    used_ = 0;
+    size_ = 0;
+    freeList_ = NIL;
+    root_ = NIL;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::iterator
+IndexedAVLTree<Key, Value, Compare, Alloc>::begin() const
+{
+    return iterator(this, getSmallestNode());
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::iterator
+IndexedAVLTree<Key, Value, Compare, Alloc>::end() const
+{
+    return iterator(this, NIL);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::iterator
+IndexedAVLTree<Key, Value, Compare, Alloc>::find(const Key& key) const
+{
+    return iterator(this, internalFind(key));
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare, class Alloc>
+Value& IndexedAVLTree<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    Index curr = internalFind(key);
+    if(curr == NIL) throw std::out_of_range("Invalid key");
+    return nodes_[curr].getItem().second;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Value const & IndexedAVLTree<Key, Value, Compare, Alloc>::operator[](const Key& key) const
+{
+    Index curr = internalFind(key);
+    if(curr == NIL) throw std::out_of_range("Invalid key");
+    return nodes_[curr].getItem().second;
+}
+
+/**
+* Helper function to find the slot with the given key, or NIL.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::Index
+IndexedAVLTree<Key, Value, Compare, Alloc>::internalFind(const Key& key) const
+{
+    Index current = root_;
+    while(current != NIL)
+    {
+        const IndexNode& node = nodes_[current];
+        const int order = compareKeys(comp_, key, node.getItem().first);
+        if(order < 0)
+        {
+            current = node.left;
+        }
+        else if(order > 0)
+        {
+            current = node.right;
+        }
+        else
+        {
+            return current;
+        }
+    }
+    return NIL;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::Index
+IndexedAVLTree<Key, Value, Compare, Alloc>::getSmallestNode() const
+{
+    Index current = root_;
+    while(current != NIL && nodes_[current].left != NIL)
+    {
+        current = nodes_[current].left;
+    }
+    return current;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::Index
+IndexedAVLTree<Key, Value, Compare, Alloc>::predecessor(Index current) const
+{
+    if(current == NIL)
+    {
+        return NIL;
+    }
+    //rightmost node of the left subtree
+    if(nodes_[current].left != NIL)
+    {
+        current = nodes_[current].left;
+        while(nodes_[current].right != NIL)
+        {
+            current = nodes_[current].right;
+        }
+        return current;
+    }
+    //otherwise the first ancestor we reach from its right subtree
+    Index parent = nodes_[current].parent;
+    while(parent != NIL && nodes_[parent].left == current)
+    {
+        current = parent;
+        parent = nodes_[current].parent;
+    }
+    return parent;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::Index
+IndexedAVLTree<Key, Value, Compare, Alloc>::successor(Index current) const
+{
+    if(current == NIL)
+    {
+        return NIL;
+    }
+    //leftmost node of the right subtree
+    if(nodes_[current].right != NIL)
+    {
+        current = nodes_[current].right;
+        while(nodes_[current].left != NIL)
+        {
+            current = nodes_[current].left;
+        }
+        return current;
+    }
+    //otherwise the first ancestor we reach from its left subtree
+    Index parent = nodes_[current].parent;
+    while(parent != NIL && nodes_[parent].right == current)
+    {
+        current = parent;
+        parent = nodes_[current].parent;
+    }
+    return parent;
+}
+
+/**
+* Takes a slot from the free list (or past the used slots, growing the
+* array if needed) and constructs a leaf holding item in it.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename IndexedAVLTree<Key, Value, Compare, Alloc>::Index
+IndexedAVLTree<Key, Value, Compare, Alloc>::allocateSlot(const Item& item, Index parent)
+{
+    Index slot;
+    if(freeList_ != NIL)
+    {
+        slot = freeList_;
+        ::new (static_cast<void*>(&nodes_[slot].item)) Item(item);
+        freeList_ = nodes_[slot].left;
+    }
+    else
+    {
+        if(used_ == capacity_)
+        {
+            if(capacity_ >= NIL)
+            {
+                throw std::length_error("IndexedAVLTree is full");
+            }
+            grow(std::min<std::size_t>(std::max<std::size_t>(16, capacity_ * 2), NIL));
+        }
+        slot = static_cast<Index>(used_);
+        ::new (static_cast<void*>(&nodes_[slot].item)) Item(item);
+        ++used_;
+    }
+    IndexNode& node = nodes_[slot];
+    node.parent = parent;
+    node.left = NIL;
+    node.right = NIL;
+    node.balance = 0;
+    ++size_;
+    return slot;
+}
+
+/**
+* Destroys the item in slot and puts the slot on the free list.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::freeSlot(Index slot)
+{
+    nodes_[slot].getItem().~Item();
+    nodes_[slot].left = freeList_;
+    freeList_ = slot;
+    --size_;
+}
+
+/**
+* Moves the used slots into a new array of the given capacity. Free slots
+* keep their place (and their free list link), so no index changes.
+* The items are moved only if that cannot throw, else copied; if a copy
+* throws, the tree is left as it was.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::grow(std::size_t capacity)
+{
+    IndexNode* nodes = NodeTraits::allocate(alloc_, capacity);
+
+    //mark the free slots, as in clear()
+    for(Index slot = freeList_; slot != NIL; slot = nodes_[slot].left)
+    {
+        nodes_[slot].parent = slot;
+    }
+    std::size_t built = 0;
+    try
+    {
+        for(; built < used_; ++built)
+        {
+            IndexNode& from = nodes_[built];
+            IndexNode& to = nodes[built];
+            to.parent = from.parent;
+            to.left = from.left;
+            to.right = from.right;
+            to.balance = from.balance;
+            if(from.parent != built)
+            {
+                ::new (static_cast<void*>(&to.item)) Item(std::move_if_noexcept(from.getItem()));
+            }
+        }
+    }
+    catch(...)
+    {
+        for(std::size_t i = 0; i < built; ++i)
+        {
+            if(nodes_[i].parent != i)
+            {
+                nodes[i].getItem().~Item();
+            }
+        }
+        NodeTraits::deallocate(alloc_, nodes, capacity);
+        for(Index slot = freeList_; slot != NIL; slot = nodes_[slot].left)
+        {
+            nodes_[slot].parent = NIL;
+        }
+        throw;
+    }
+
+    //the old items go only once every one has been copied
+    for(std::size_t i = 0; i < used_; ++i)
+    {
+        if(nodes_[i].parent != i)
+        {
+            nodes_[i].getItem().~Item();
+        }
+    }
+    //restore the parent links of the free slots
+    for(Index slot = freeList_; slot != NIL; slot = nodes[slot].left)
+    {
+        nodes[slot].parent = NIL;
+    }
+
+    if(nodes_ != nullptr)
+    {
+        NodeTraits::deallocate(alloc_, nodes_, capacity_);
+    }
+    nodes_ = nodes;
+    capacity_ = capacity;
+}
+
+/*
+ * Recall: If key is already in the tree, you should
+ * overwrite the current value with the updated value.
+ * The tree is searched first, so no slot is taken for an existing key.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::insert(const std::pair<const Key, Value>& new_item)
+{
+    if(root_ == NIL)
+    {
+        root_ = allocateSlot(new_item, NIL);
+        return;
+    }
+
+    Index current = root_;
+    Index parent = NIL;
+    bool goLeft = false;
+
+    //find the correct spot to insert the new node - at leaf
+    while(current != NIL)
+    {
+        parent = current;
+        IndexNode& node = nodes_[current];
+        const int order = compareKeys(comp_, new_item.first, node.getItem().first);
+        if(order < 0)
+        {
+            goLeft = true;
+            current = node.left;
+        }
+        else if(order > 0)
+        {
+            goLeft = false;
+            current = node.right;
+        }
+        else
+        {
+            node.getItem().second = new_item.second;
+            return;
+        }
+    }
+
+    //insert new node (allocating may move the array, so link it by index afterwards)
+    Index newNode = allocateSlot(new_item, parent);
+    if(goLeft)
+    {
+        nodes_[parent].left = newNode;
+    }
+    else
+    {
+        nodes_[parent].right = newNode;
+    }
+
+    //fix balance factors
+    if(nodes_[parent].balance != 0)
+    {
+        nodes_[parent].balance = 0;
+    }
+    else
+    {
+        nodes_[parent].balance = goLeft ? -1 : 1;
+        insertFix(parent, newNode);
+    }
+}
+
+/*
+ * helper function for insert - rotate left around node
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::rotateLeft(Index node)
+{
+    Index rightChild = nodes_[node].right;
+    Index parent = nodes_[node].parent;
+
+    nodes_[node].right = nodes_[rightChild].left;
+    if(nodes_[rightChild].left != NIL)
+    {
+        nodes_[nodes_[rightChild].left].parent = node;
+    }
+
+    nodes_[rightChild].parent = parent;
+    if(parent == NIL)
+    {
+        root_ = rightChild;
+    }
+    else if(nodes_[parent].left == node)
+    {
+        nodes_[parent].left = rightChild;
+    }
+    else
+    {
+        nodes_[parent].right = rightChild;
+    }
+
+    nodes_[rightChild].left = node;
+    nodes_[node].parent = rightChild;
+
+    int8_t nodeBalance = nodes_[node].balance;
+    int8_t rightBalance = nodes_[rightChild].balance;
+    nodes_[node].balance = nodeBalance - 1 - std::max(static_cast<int8_t>(0), rightBalance);
+    nodes_[rightChild].balance = rightBalance - 1 + std::min(static_cast<int8_t>(0), nodeBalance);
+}
+
+/*
+ * helper function for insert - rotate right around node
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::rotateRight(Index node)
+{
+    Index leftChild = nodes_[node].left;
+    Index parent = nodes_[node].parent;
+
+    nodes_[node].left = nodes_[leftChild].right;
+    if(nodes_[leftChild].right != NIL)
+    {
+        nodes_[nodes_[leftChild].right].parent = node;
+    }
+
+    nodes_[leftChild].parent = parent;
+    if(parent == NIL)
+    {
+        root_ = leftChild;
+    }
+    else if(nodes_[parent].left == node)
+    {
+        nodes_[parent].left = leftChild;
+    }
+    else
+    {
+        nodes_[parent].right = leftChild;
+    }
+
+    nodes_[leftChild].right = node;
+    nodes_[node].parent = leftChild;
+
+    int8_t nodeBalance = nodes_[node].balance;
+    int8_t leftBalance = nodes_[leftChild].balance;
+    nodes_[node].balance = nodeBalance + 1 - std::min(static_cast<int8_t>(0), leftBalance);
+    nodes_[leftChild].balance = leftBalance + 1 + std::max(static_cast<int8_t>(0), nodeBalance);
+}
+
+/*
+ * helper function for insert - walks up from parent (whose subtree just grew
+ * through node) and rotates where a grandparent goes out of balance.
+ * Same cases as AVLTree::insertFix.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::insertFix(Index parent, Index node)
+{
+    if(parent == NIL || nodes_[parent].parent == NIL)
+    {
+        return;
+    }
+
+    Index grandparent = nodes_[parent].parent;
+    //-1 if parent is the left child of grandparent, +1 if it is the right child
+    int8_t side = (nodes_[grandparent].left == parent) ? -1 : 1;
+    nodes_[grandparent].balance += side;
+
+    if(nodes_[grandparent].balance == 0)
+    {
+        return;
+    }
+    if(nodes_[grandparent].balance == side)
+    {
+        insertFix(grandparent, parent);
+        return;
+    }
+
+    //balance is -2 or +2
+    bool zigZig = (side == -1) ? (nodes_[parent].left == node) : (nodes_[parent].right == node);
+    if(zigZig)
+    {
+        if(side == -1) rotateRight(grandparent);
+        else rotateLeft(grandparent);
+        nodes_[parent].balance = 0;
+        nodes_[grandparent].balance = 0;
+    }
+    else
+    {
+        int8_t nodeBalance = nodes_[node].balance;
+        if(side == -1)
+        {
+            rotateLeft(parent);
+            rotateRight(grandparent);
+        }
+        else
+        {
+            rotateRight(parent);
+            rotateLeft(grandparent);
+        }
+        //node leaned away from parent: parent is balanced, grandparent leans the other way
+        nodes_[parent].balance = (nodeBalance == -side) ? side : 0;
+        nodes_[grandparent].balance = (nodeBalance == side) ? -side : 0;
+        nodes_[node].balance = 0;
+    }
+}
+
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::remove(const Key& key)
+{
+    Index removeNode = internalFind(key);
+    if(removeNode == NIL)
+    {
+        return;
+    }
+
+    //node has 2 children - swap with predecessor
+    if(nodes_[removeNode].left != NIL && nodes_[removeNode].right != NIL)
+    {
+        nodeSwap(removeNode, predecessor(removeNode));
+    }
+
+    //node has 1 or 0 children
+    Index parent = nodes_[removeNode].parent;
+    Index child = (nodes_[removeNode].left != NIL) ? nodes_[removeNode].left : nodes_[removeNode].right;
+    int diff = 0;
+
+    if(parent == NIL)
+    {
+        root_ = child;
+    }
+    else if(nodes_[parent].left == removeNode)
+    {
+        nodes_[parent].left = child;
+        diff = 1;
+    }
+    else
+    {
+        nodes_[parent].right = child;
+        diff = -1;
+    }
+
+    if(child != NIL)
+    {
+        nodes_[child].parent = parent;
+    }
+
+    freeSlot(removeNode);
+
+    if(parent != NIL)
+    {
+        removeFix(parent, diff);
+    }
+}
+
+/*
+ * helper function for remove - the subtree at node lost height on one side;
+ * diff is +1 when that was the left side and -1 when it was the right side.
+ * Same cases as AVLTree::removeFix.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::removeFix(Index node, int diff)
+{
+    if(node == NIL)
+    {
+        return;
+    }
+
+    Index parent = nodes_[node].parent;
+    int ndiff = 0;
+    if(parent != NIL)
+    {
+        ndiff = (nodes_[parent].left == node) ? 1 : -1;
+    }
+
+    int newBalance = nodes_[node].balance + diff;
+
+    if(newBalance == 2 * diff)
+    {
+        //the taller child is on the side opposite to the removal
+        Index c = (diff == -1) ? nodes_[node].left : nodes_[node].right;
+        int8_t cBalance = nodes_[c].balance;
+
+        //zig-zig
+        if(cBalance == diff)
+        {
+            if(diff == -1) rotateRight(node);
+            else rotateLeft(node);
+            nodes_[node].balance = 0;
+            nodes_[c].balance = 0;
+            removeFix(parent, ndiff);
+        }
+        //zig-zig with a balanced child: height is unchanged, stop here
+        else if(cBalance == 0)
+        {
+            if(diff == -1) rotateRight(node);
+            else rotateLeft(node);
+            nodes_[node].balance = static_cast<int8_t>(diff);
+            nodes_[c].balance = static_cast<int8_t>(-diff);
+        }
+        //zig-zag
+        else
+        {
+            Index g = (diff == -1) ? nodes_[c].right : nodes_[c].left;
+            int8_t gBalance = nodes_[g].balance;
+            if(diff == -1)
+            {
+                rotateLeft(c);
+                rotateRight(node);
+            }
+            else
+            {
+                rotateRight(c);
+                rotateLeft(node);
+            }
+            nodes_[node].balance = (gBalance == diff) ? static_cast<int8_t>(-diff) : 0;
+            nodes_[c].balance = (gBalance == -diff) ? static_cast<int8_t>(diff) : 0;
+            nodes_[g].balance = 0;
+            removeFix(parent, ndiff);
+        }
+    }
+    else if(newBalance == diff)
+    {
+        //was balanced, so the height did not change
+        nodes_[node].balance = static_cast<int8_t>(diff);
+    }
+    else if(newBalance == 0)
+    {
+        nodes_[node].balance = 0;
+        removeFix(parent, ndiff);
+    }
+}
+
+/**
+* Swaps the positions of two nodes in the tree, balances included.
+* Same approach as BinarySearchTree::nodeSwap.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+void IndexedAVLTree<Key, Value, Compare, Alloc>::nodeSwap(Index n1, Index n2)
+{
+    if(n1 == n2 || n1 == NIL || n2 == NIL)
+    {
+        return;
+    }
+    IndexNode& a = nodes_[n1];
+    IndexNode& b = nodes_[n2];
+    Index n1p = a.parent, n1r = a.right, n1lt = a.left;
+    Index n2p = b.parent, n2r = b.right, n2lt = b.left;
+    bool n1isLeft = (n1p != NIL && nodes_[n1p].left == n1);
+    bool n2isLeft = (n2p != NIL && nodes_[n2p].left == n2);
+
+    std::swap(a.parent, b.parent);
+    std::swap(a.left, b.left);
+    std::swap(a.right, b.right);
+    std::swap(a.balance, b.balance);
+
+    //adjacent nodes now point at themselves; point them at each other instead
+    if(n1r == n2) { b.right = n1; a.parent = n2; }
+    else if(n2r == n1) { a.right = n2; b.parent = n1; }
+    else if(n1lt == n2) { b.left = n1; a.parent = n2; }
+    else if(n2lt == n1) { a.left = n2; b.parent = n1; }
+
+    if(n1p != NIL && n1p != n2)
+    {
+        if(n1isLeft) nodes_[n1p].left = n2;
+        else nodes_[n1p].right = n2;
+    }
+    if(n1r != NIL && n1r != n2) nodes_[n1r].parent = n2;
+    if(n1lt != NIL && n1lt != n2) nodes_[n1lt].parent = n2;
+
+    if(n2p != NIL && n2p != n1)
+    {
+        if(n2isLeft) nodes_[n2p].left = n1;
+        else nodes_[n2p].right = n1;
+    }
+    if(n2r != NIL && n2r != n1) nodes_[n2r].parent = n1;
+    if(n2lt != NIL && n2lt != n1) nodes_[n2lt].parent = n1;
+
+    if(root_ == n1) root_ = n2;
+    else if(root_ == n2) root_ = n1;
+}
+
+/*
+-------------------------------------------------
+End implementations for the IndexedAVLTree class.
+-------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,388 @@
+#ifndef POOL_ALLOC_H
+#define POOL_ALLOC_H
+
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+* A pool of fixed-size blocks, carved out of large slabs.
+* Freed blocks go on a free list and are handed out again before any new
+* slab is touched, so a tree under insert/remove churn recycles its nodes
+* instead of going back to the general purpose heap every time.
+*
+* The block size and alignment are fixed by the first allocation, the size
+* rounded up to the alignment. Larger requests, and requests that need a
+* stricter alignment, are passed through to ::operator new, so the pool is
+* meant to serve exactly one node type. Neither the slabs nor the requests
+* passed through are aligned beyond std::max_align_t, so allocate() throws
+* std::invalid_argument for a stricter alignment.
+*/
+class NodePool
+{
+public:
+    explicit NodePool(std::size_t blocksPerSlab = 1024);
+    ~NodePool();
+
+    void* allocate(std::size_t bytes, std::size_t align = alignof(std::max_align_t));
+    void deallocate(void* block, std::size_t bytes, std::size_t align = alignof(std::max_align_t));
+
+    // Frees every slab at once, but only when no block is in use.
+    void release();
+
+    std::size_t blockSize() const;
+    std::size_t slabBytes() const;
+    std::size_t slabCount() const;
+    std::size_t blocksInUse() const;
+
+    // Reference counting for the PoolAllocator handles sharing this pool.
+    void addRef();
+    bool dropRef();
+
+private:
+    NodePool(const NodePool&);
+    NodePool& operator=(const NodePool&);
+
+    bool passesThrough(std::size_t bytes, std::size_t align) const;
+    std::size_t slabHeaderBytes() const;
+    void addSlab();
+    void freeSlabs();
+
+    struct FreeBlock { FreeBlock* next; };
+    struct Slab { Slab* next; };
+
+    std::size_t blockSize_;
+    std::size_t blockAlign_;
+    std::size_t blocksPerSlab_;
+    std::size_t blocksInUse_;
+    std::size_t slabCount_;
+    std::size_t refCount_;
+    FreeBlock* freeList_;
+    Slab* slabs_;
+    char* bumpNext_;    // unused tail of the newest slab
+    char* bumpEnd_;
+};
+
+/*
+  ---------------------------------------------
+  Begin implementations for the NodePool class.
+  ---------------------------------------------
+*/
+
+inline NodePool::NodePool(std::size_t blocksPerSlab) :
+    blockSize_(0),
+    blockAlign_(0),
+    blocksPerSlab_(blocksPerSlab == 0 ? 1 : blocksPerSlab),
+    blocksInUse_(0),
+    slabCount_(0),
+    refCount_(1),
+    freeList_(nullptr),
+    slabs_(nullptr),
+    bumpNext_(nullptr),
+    bumpEnd_(nullptr)
+{
+
+}
+
+inline NodePool::~NodePool()
+{
+    freeSlabs();
+}
+
+/**
+* Hands out a block from the free list, or from the newest slab when the
+* free list is empty. A fresh slab is only allocated when both are exhausted.
+*/
+inline void* NodePool::allocate(std::size_t bytes, std::size_t align)
+{
+    if(align > alignof(std::max_align_t))
+    {
+        throw std::invalid_argument("NodePool: alignment beyond std::max_align_t");
+    }
+    if(blockSize_ == 0)
+    {
+        //round up so that every block keeps the alignment of the first request
+        if(align < alignof(FreeBlock))
+        {
+            align = alignof(FreeBlock);
+        }
+        blockSize_ = (bytes < sizeof(FreeBlock)) ? sizeof(FreeBlock) : bytes;
+        blockSize_ = (blockSize_ + align - 1) / align * align;
+        blockAlign_ = align;
+    }
+    if(passesThrough(bytes, align))
+    {
+        return ::operator new(bytes);
+    }
+
+    ++blocksInUse_;
+    if(freeList_ != nullptr)
+    {
+        FreeBlock* block = freeList_;
+        freeList_ = block->next;
+        return block;
+    }
+    if(bumpNext_ == bumpEnd_)
+    {
+        addSlab();
+    }
+    void* block = bumpNext_;
+    bumpNext_ += blockSize_;
+    return block;
+}
+
+/**
+* Puts a block back on the free list. Slabs are only returned by release().
+* bytes and align must be those the block was allocated with.
+*/
+inline void NodePool::deallocate(void* block, std::size_t bytes, std::size_t align)
+{
+    if(block == nullptr)
+    {
+        return;
+    }
+    if(passesThrough(bytes, align))
+    {
+        ::operator delete(block);
+        return;
+    }
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+    freed->next = freeList_;
+    freeList_ = freed;
+    --blocksInUse_;
+}
+
+inline void NodePool::release()
+{
+    if(blocksInUse_ == 0)
+    {
+        freeSlabs();
+    }
+}
+
+inline std::size_t NodePool::blockSize() const
+{
+    return blockSize_;
+}
+
+/**
+* The size of one slab, including its header. Zero until the block size is known.
+*/
+inline std::size_t NodePool::slabBytes() const
+{
+    return (blockSize_ == 0) ? 0 : slabHeaderBytes() + blockSize_ * blocksPerSlab_;
+}
+
+inline std::size_t NodePool::slabCount() const
+{
+    return slabCount_;
+}
+
+inline std::size_t NodePool::blocksInUse() const
+{
+    return blocksInUse_;
+}
+
+inline void NodePool::addRef()
+{
+    ++refCount_;
+}
+
+/**
+* Returns true when the last reference is gone and the pool should be deleted.
+*/
+inline bool NodePool::dropRef()
+{
+    return --refCount_ == 0;
+}
+
+/**
+* Whether a request does not fit a block, in size or in alignment.
+*/
+inline bool NodePool::passesThrough(std::size_t bytes, std::size_t align) const
+{
+    return bytes > blockSize_ || align > blockAlign_;
+}
+
+/**
+* The slab header is padded to a full block so that the blocks behind it stay aligned.
+*/
+inline std::size_t NodePool::slabHeaderBytes() const
+{
+    return (sizeof(Slab) + blockSize_ - 1) / blockSize_ * blockSize_;
+}
+
+/**
+* Allocates a new slab and makes it the bump region.
+*/
+inline void NodePool::addSlab()
+{
+    const std::size_t header = slabHeaderBytes();
+    char* memory = static_cast<char*>(::operator new(slabBytes()));
+    Slab* slab = reinterpret_cast<Slab*>(memory);
+    slab->next = slabs_;
+    slabs_ = slab;
+    ++slabCount_;
+    bumpNext_ = memory + header;
+    bumpEnd_ = bumpNext_ + blockSize_ * blocksPerSlab_;
+}
+
+inline void NodePool::freeSlabs()
+{
+    while(slabs_ != nullptr)
+    {
+        Slab* next = slabs_->next;
+        ::operator delete(slabs_);
+        slabs_ = next;
+    }
+    slabCount_ = 0;
+    freeList_ = nullptr;
+    bumpNext_ = nullptr;
+    bumpEnd_ = nullptr;
+}
+
+/*
+  -------------------------------------------
+  End implementations for the NodePool class.
+  -------------------------------------------
+*/
+
+/**
+* A standard allocator handle on a shared NodePool, for use as the Alloc
+* parameter of BinarySearchTree/AVLTree. Copies and rebound copies share
+* the same pool, so the tree's node type ends up owning the block size.
+* The reference count is not atomic: like the trees, a pool is meant to
+* be used from one thread at a time.
+*/
+template <typename T>
+class PoolAllocator
+{
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "PoolAllocator: over-aligned types are not supported, the pool only aligns to std::max_align_t");
+
+public:
+    typedef T value_type;
+    // a tree moved or swapped into another keeps its nodes in their pool
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    PoolAllocator();
+    explicit PoolAllocator(std::size_t blocksPerSlab);
+    PoolAllocator(const PoolAllocator<T>& other) noexcept;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept;
+    ~PoolAllocator();
+    PoolAllocator<T>& operator=(const PoolAllocator<T>& other);
+
+    T* allocate(std::size_t n);
+    void deallocate(T* p, std::size_t n);
+
+    // Called by BinarySearchTree::clear() once the tree is empty.
+    void release();
+
+    NodePool& pool() const;
+
+protected:
+    template <typename U> friend class PoolAllocator;
+    NodePool* pool_;
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the PoolAllocator class.
+  --------------------------------------------------
+*/
+
+/**
+* Default constructor, which starts a new pool.
+*/
+template<typename T>
+PoolAllocator<T>::PoolAllocator() : pool_(new NodePool())
+{
+
+}
+
+template<typename T>
+PoolAllocator<T>::PoolAllocator(std::size_t blocksPerSlab) : pool_(new NodePool(blocksPerSlab))
+{
+
+}
+
+template<typename T>
+PoolAllocator<T>::PoolAllocator(const PoolAllocator<T>& other) noexcept : pool_(other.pool_)
+{
+    pool_->addRef();
+}
+
+template<typename T>
+template<typename U>
+PoolAllocator<T>::PoolAllocator(const PoolAllocator<U>& other) noexcept : pool_(other.pool_)
+{
+    pool_->addRef();
+}
+
+template<typename T>
+PoolAllocator<T>::~PoolAllocator()
+{
+    if(pool_->dropRef())
+    {
+        delete pool_;
+    }
+}
+
+template<typename T>
+PoolAllocator<T>& PoolAllocator<T>::operator=(const PoolAllocator<T>& other)
+{
+    other.pool_->addRef();
+    if(pool_->dropRef())
+    {
+        delete pool_;
+    }
+    pool_ = other.pool_;
+    return *this;
+}
+
+template<typename T>
+T* PoolAllocator<T>::allocate(std::size_t n)
+{
+    return static_cast<T*>(pool_->allocate(n * sizeof(T), alignof(T)));
+}
+
+template<typename T>
+void PoolAllocator<T>::deallocate(T* p, std::size_t n)
+{
+    pool_->deallocate(p, n * sizeof(T), alignof(T));
+}
+
+template<typename T>
+void PoolAllocator<T>::release()
+{
+    pool_->release();
+}
+
+template<typename T>
+NodePool& PoolAllocator<T>::pool() const
+{
+    return *pool_;
+}
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+    return &lhs.pool() == &rhs.pool();
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+    return &lhs.pool() != &rhs.pool();
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the PoolAllocator class.
+  ------------------------------------------------
+*/
+
+#endif
@@ -17,8 +17,8 @@
 // 1 means that it is the root.
 // Returns -1 (not found) if the distance is more than PPBST_MAX_HEIGHT,
 // or -2 if the tree is inconsistent.
-template<typename Key, typename Value>
-int getNodeDepth(BinarySearchTree<Key, Value> const & tree, Node<Key, Value> * root, Node<Key, Value> * node)
+template<typename Key, typename Value, typename Compare, typename Alloc>
+int getNodeDepth(BinarySearchTree<Key, Value, Compare, Alloc> const & tree, Node<Key, Value> * root, Node<Key, Value> * node)
 {
     int dist = 1;
 
@@ -92,8 +92,8 @@ int getSubtreeHeight(Node<Key, Value> * root, int recursionDepth = 1)
 
     */
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
+template<typename Key, typename Value, typename Compare, typename Alloc>
+void BinarySearchTree<Key, Value, Compare, Alloc>::printRoot (Node<Key, Value>* root) const
 {
     // special case for empty trees:
     if(root == nullptr)
@@ -130,7 +130,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
     std::map<Key, uint8_t> valuePlaceholders;
 
     uint8_t nextPlaceHolderVal = 1;
-    for(typename BinarySearchTree<Key, Value>::iterator treeIter = this->begin(); treeIter != this->end(); ++treeIter)
+    for(typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator treeIter = this->begin(); treeIter != this->end(); ++treeIter)
     {
 
         if(getNodeDepth(*this, root, treeIter.current_) != -1)
@@ -222,7 +222,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
                     for(int numLines = 0; numLines < (elementPadding/2 - 1); ++numLines)
                     {
-                        std::cout << u8"\u2500";
+                        std::cout << reinterpret_cast<const char*>(u8"\u2500"); // u8 literals are char8_t since C++20
                     }
 
                     std::cout << "\u2518  ";
@@ -239,7 +239,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
 
                     for(int numLines = 0; numLines < (elementPadding/2 - 1); ++numLines)
                     {
-                        std::cout << u8"\u2500";
+                        std::cout << reinterpret_cast<const char*>(u8"\u2500"); // u8 literals are char8_t since C++20
                     }
 
                     std::cout << "\u2510  ";
@@ -273,7 +273,7 @@ void BinarySearchTree<Key, Value>::printRoot (Node<Key, Value>* root) const
             std::cout.flags(origCoutState);
             std::cout << '(' << placeholdersIter->first << ", ";
 
-            typename BinarySearchTree<Key, Value>::iterator elementIter = this->find(placeholdersIter->first);
+            typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator elementIter = this->find(placeholdersIter->first);
             if(elementIter == this->end())
             {
                 std::cout << "<error: lookup failed>";
@@ -0,0 +1,298 @@
+#ifndef RANKED_AVLBST_H
+#define RANKED_AVLBST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include "avlbst.h"
+
+/**
+* Node augmentation counting the nodes of a subtree, the node itself included.
+* The count is 32 bits wide so that it fits into the padding behind the
+* node's links: an AVLNode<uint64_t,uint64_t> stays 48 bytes (40 in the
+* compact layout gets rounded up to 48). A tree holds fewer than 2^32 entries.
+*/
+struct SubtreeSize
+{
+    static const bool aggregates = true;
+
+    SubtreeSize() : subtreeSize_(1) { }
+
+    template<typename Item>
+    void update(const Item&, const SubtreeSize* left, const SubtreeSize* right)
+    {
+        subtreeSize_ = 1 + ((left != nullptr) ? left->subtreeSize_ : 0)
+                         + ((right != nullptr) ? right->subtreeSize_ : 0);
+    }
+
+    std::uint32_t subtreeSize_;
+};
+
+/**
+* An order-statistic AVL tree: an AVLTree whose nodes also know the size
+* of their subtree, so that positions in key order can be found in
+* O(log n) instead of by walking an iterator.
+*
+* rank(key) is the number of keys less than key, and select(i) the entry
+* at position i (0-based), making them inverses of each other for keys in
+* the tree. countInRange, percentile and median are built on them.
+*
+* Everything else behaves like AVLTree. Keeping the sizes costs a refresh
+* of every node on the path of an insert or remove, plus two per rotation;
+* see "./bst-bench ranked" for what that amounts to.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = std::allocator<std::pair<const Key, Value> > >
+class RankedAVLTree : public AVLTree<Key, Value, Compare, Alloc, SubtreeSize>
+{
+public:
+    typedef AVLTree<Key, Value, Compare, Alloc, SubtreeSize> BaseTree;
+    typedef typename BaseTree::iterator iterator;
+    typedef typename BaseTree::const_iterator const_iterator;
+
+    RankedAVLTree();
+    explicit RankedAVLTree(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit RankedAVLTree(const Alloc& alloc);
+    template<typename InputIt>
+    RankedAVLTree(InputIt first, InputIt last, const Compare& comp = Compare(), const Alloc& alloc = Alloc());
+    // Takes over the nodes of an AVLTree with the same augmentation, e.g. one returned by split().
+    explicit RankedAVLTree(BaseTree&& other) noexcept;
+
+    std::size_t size() const;
+    std::size_t rank(const Key& key) const;
+    iterator select(std::size_t index);
+    const_iterator select(std::size_t index) const;
+    std::size_t countInRange(const Key& low, const Key& high) const;
+    iterator percentile(double fraction);
+    const_iterator percentile(double fraction) const;
+    iterator median();
+    const_iterator median() const;
+
+    // Same as AVLTree::split, keeping the result ranked.
+    RankedAVLTree<Key, Value, Compare, Alloc> split(const Key& key);
+
+protected:
+    typedef AVLNode<Key, Value, SubtreeSize> RankedNode;
+
+    static std::size_t subtreeSize(const RankedNode* node);
+    RankedNode* selectNode(std::size_t index) const;
+    std::size_t percentileIndex(double fraction) const;
+    std::size_t countBelow(const Key& key, bool inclusive) const;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the RankedAVLTree class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+RankedAVLTree<Key, Value, Compare, Alloc>::RankedAVLTree()
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+RankedAVLTree<Key, Value, Compare, Alloc>::RankedAVLTree(const Compare& comp, const Alloc& alloc) :
+    BaseTree(comp, alloc)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+RankedAVLTree<Key, Value, Compare, Alloc>::RankedAVLTree(const Alloc& alloc) : BaseTree(alloc)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt>
+RankedAVLTree<Key, Value, Compare, Alloc>::RankedAVLTree(InputIt first, InputIt last, const Compare& comp, const Alloc& alloc) :
+    BaseTree(first, last, comp, alloc)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+RankedAVLTree<Key, Value, Compare, Alloc>::RankedAVLTree(BaseTree&& other) noexcept :
+    BaseTree(std::move(other))
+{
+
+}
+
+/**
+* The number of entries, in O(1).
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t RankedAVLTree<Key, Value, Compare, Alloc>::size() const
+{
+    return subtreeSize(static_cast<const RankedNode*>(this->root_));
+}
+
+/**
+* The number of keys less than key, whether or not key itself is in the tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t RankedAVLTree<Key, Value, Compare, Alloc>::rank(const Key& key) const
+{
+    return countBelow(key, false);
+}
+
+/**
+* The entry at position index in key order, or end() if index >= size().
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename RankedAVLTree<Key, Value, Compare, Alloc>::iterator
+RankedAVLTree<Key, Value, Compare, Alloc>::select(std::size_t index)
+{
+    return this->makeIterator(selectNode(index));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename RankedAVLTree<Key, Value, Compare, Alloc>::const_iterator
+RankedAVLTree<Key, Value, Compare, Alloc>::select(std::size_t index) const
+{
+    return this->makeIterator(selectNode(index));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename RankedAVLTree<Key, Value, Compare, Alloc>::RankedNode*
+RankedAVLTree<Key, Value, Compare, Alloc>::selectNode(std::size_t index) const
+{
+    RankedNode* node = static_cast<RankedNode*>(this->root_);
+    while(node != nullptr)
+    {
+        const std::size_t leftSize = subtreeSize(node->getLeft());
+        if(index < leftSize)
+        {
+            node = node->getLeft();
+        }
+        else if(index == leftSize)
+        {
+            break;
+        }
+        else
+        {
+            index -= leftSize + 1;
+            node = node->getRight();
+        }
+    }
+    return node;
+}
+
+/**
+* The number of keys k with low <= k <= high; zero if high is less than low.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t RankedAVLTree<Key, Value, Compare, Alloc>::countInRange(const Key& low, const Key& high) const
+{
+    if(compareKeys(this->comp_, high, low) < 0)
+    {
+        return 0;
+    }
+    return countBelow(high, true) - countBelow(low, false);
+}
+
+/**
+* The entry at the given fraction of the key order: fraction 0 is the
+* smallest key and 1 the largest, and in between the position is
+* fraction * (size() - 1), rounded down. Returns end() for an empty tree;
+* a fraction outside [0, 1] throws std::invalid_argument.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename RankedAVLTree<Key, Value, Compare, Alloc>::iterator
+RankedAVLTree<Key, Value, Compare, Alloc>::percentile(double fraction)
+{
+    return select(percentileIndex(fraction));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename RankedAVLTree<Key, Value, Compare, Alloc>::const_iterator
+RankedAVLTree<Key, Value, Compare, Alloc>::percentile(double fraction) const
+{
+    return select(percentileIndex(fraction));
+}
+
+/**
+* The middle entry, or the lower of the two middle ones for an even size.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+typename RankedAVLTree<Key, Value, Compare, Alloc>::iterator
+RankedAVLTree<Key, Value, Compare, Alloc>::median()
+{
+    return select(percentileIndex(0.5));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename RankedAVLTree<Key, Value, Compare, Alloc>::const_iterator
+RankedAVLTree<Key, Value, Compare, Alloc>::median() const
+{
+    return select(percentileIndex(0.5));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+RankedAVLTree<Key, Value, Compare, Alloc> RankedAVLTree<Key, Value, Compare, Alloc>::split(const Key& key)
+{
+    return RankedAVLTree<Key, Value, Compare, Alloc>(BaseTree::split(key));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t RankedAVLTree<Key, Value, Compare, Alloc>::subtreeSize(const RankedNode* node)
+{
+    return (node == nullptr) ? 0 : node->subtreeSize_;
+}
+
+/**
+* The position for percentile(); size() (the end) for an empty tree.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t RankedAVLTree<Key, Value, Compare, Alloc>::percentileIndex(double fraction) const
+{
+    if(!(fraction >= 0.0 && fraction <= 1.0))
+    {
+        throw std::invalid_argument("percentile: fraction must be in [0, 1]");
+    }
+    const std::size_t count = size();
+    if(count == 0)
+    {
+        return 0;
+    }
+    return static_cast<std::size_t>(fraction * static_cast<double>(count - 1));
+}
+
+/**
+* The number of keys less than key, or less than or equal to it if
+* inclusive. One descent: every step right skips a left subtree and its root.
+*/
+template<class Key, class Value, class Compare, class Alloc>
+std::size_t RankedAVLTree<Key, Value, Compare, Alloc>::countBelow(const Key& key, bool inclusive) const
+{
+    std::size_t count = 0;
+    const RankedNode* node = static_cast<const RankedNode*>(this->root_);
+    while(node != nullptr)
+    {
+        const int order = compareKeys(this->comp_, key, node->getKey());
+        if(order < 0)
+        {
+            node = node->getLeft();
+        }
+        else if(order > 0)
+        {
+            count += subtreeSize(node->getLeft()) + 1;
+            node = node->getRight();
+        }
+        else
+        {
+            return count + subtreeSize(node->getLeft()) + (inclusive ? 1 : 0);
+        }
+    }
+    return count;
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the RankedAVLTree class.
+  ---------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef SPLAY_BST_H
+#define SPLAY_BST_H
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include "bst.h"
+
+/**
+* How far SplayTree moves an accessed node up: all the way to the root, or
+* (semi-splaying) about half way, which costs about half the rotations and
+* still moves the whole access path up.
+*/
+enum class SplayMode { FULL, SEMI };
+
+/**
+* A splay tree (Sleator and Tarjan): a plain BinarySearchTree of plain
+* Nodes that rotates every node it finds, inserts or removes up to the root.
+* Hot keys so end up near the root, and a run of lookups of k distinct keys
+* costs O(log k) each instead of O(log n), amortized. There is no balance
+* guarantee: sorted inserts leave a path, and a single lookup may take O(n).
+*
+* Since a lookup rotates, find() and operator[] write to the tree. To keep
+* that down, setSplaying can switch to semi-splaying and/or only splay every
+* k-th lookup; inserts and removes always splay. The const find and
+* operator[], findBatch and finger searches do not splay at all.
+*
+* SplayTree is copied and moved like a BinarySearchTree, settings included.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = std::allocator<std::pair<const Key, Value> > >
+class SplayTree : public BinarySearchTree<Key, Value, Compare, Alloc>
+{
+public:
+    SplayTree();
+    explicit SplayTree(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit SplayTree(const Alloc& alloc);
+
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::iterator iterator;
+    typedef typename BinarySearchTree<Key, Value, Compare, Alloc>::const_iterator const_iterator;
+
+    // Splays a lookup's node (see setSplaying). Other overloads as in BinarySearchTree.
+    using BinarySearchTree<Key, Value, Compare, Alloc>::find;
+    iterator find(const Key& key);
+    using BinarySearchTree<Key, Value, Compare, Alloc>::operator[];
+    Value& operator[](const Key& key);
+
+    // Lookups splay their node once every splayEvery times (1: always), as far as mode says.
+    void setSplaying(SplayMode mode, unsigned splayEvery = 1);
+
+protected:
+    virtual void attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft);
+    virtual void eraseNode(Node<Key, Value>* node);
+    virtual void valueChanged(Node<Key, Value>* node);
+
+    // splays node after a lookup, if it is its turn
+    void accessed(Node<Key, Value>* node);
+    void splay(Node<Key, Value>* node, SplayMode mode);
+    // rotates node above its parent
+    void rotateUp(Node<Key, Value>* node);
+
+    SplayMode mode_;
+    unsigned splayEvery_;
+    unsigned untilSplay_;   // lookups left before the next one splays
+};
+
+template<class Key, class Value, class Compare, class Alloc>
+SplayTree<Key, Value, Compare, Alloc>::SplayTree() :
+    mode_(SplayMode::FULL), splayEvery_(1), untilSplay_(1)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+SplayTree<Key, Value, Compare, Alloc>::SplayTree(const Compare& comp, const Alloc& alloc) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(comp, alloc),
+    mode_(SplayMode::FULL), splayEvery_(1), untilSplay_(1)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+SplayTree<Key, Value, Compare, Alloc>::SplayTree(const Alloc& alloc) :
+    BinarySearchTree<Key, Value, Compare, Alloc>(alloc),
+    mode_(SplayMode::FULL), splayEvery_(1), untilSplay_(1)
+{
+
+}
+
+/*
+ * Throws std::invalid_argument if splayEvery is 0.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::setSplaying(SplayMode mode, unsigned splayEvery)
+{
+    if(splayEvery == 0)
+    {
+        throw std::invalid_argument("setSplaying: splayEvery must be at least 1");
+    }
+    mode_ = mode;
+    splayEvery_ = splayEvery;
+    untilSplay_ = splayEvery;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename SplayTree<Key, Value, Compare, Alloc>::iterator
+SplayTree<Key, Value, Compare, Alloc>::find(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        return this->end();
+    }
+    accessed(node);
+    return this->makeIterator(node);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Value& SplayTree<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == nullptr)
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    accessed(node);
+    return node->getValue();
+}
+
+/*
+ * A new leaf is splayed to the root.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft)
+{
+    BinarySearchTree<Key, Value, Compare, Alloc>::attachNode(node, parent, isLeft);
+    splay(node, SplayMode::FULL);
+}
+
+/*
+ * An insert that overwrote a value counts as a lookup.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::valueChanged(Node<Key, Value>* node)
+{
+    accessed(node);
+}
+
+/*
+ * The node is splayed to the root first, so that its predecessor, which
+ * takes its place if it has two children, is the largest node of the left
+ * subtree: the two subtrees are joined below it.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::eraseNode(Node<Key, Value>* node)
+{
+    splay(node, SplayMode::FULL);
+    BinarySearchTree<Key, Value, Compare, Alloc>::eraseNode(node);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::accessed(Node<Key, Value>* node)
+{
+    if(--untilSplay_ == 0)
+    {
+        untilSplay_ = splayEvery_;
+        splay(node, mode_);
+    }
+}
+
+/*
+ * Bottom-up splaying. A node whose parent and grandparent are on the same
+ * side (zig-zig) rotates its parent first, then itself; otherwise (zig-zag)
+ * it rotates up twice. Semi-splaying stops a zig-zig after the first
+ * rotation and goes on from the parent instead.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::splay(Node<Key, Value>* node, SplayMode mode)
+{
+    while(node->getParent() != nullptr)
+    {
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grandparent = parent->getParent();
+        //zig - parent is the root
+        if(grandparent == nullptr)
+        {
+            rotateUp(node);
+            return;
+        }
+        //zig-zig
+        if((node == parent->getLeft()) == (parent == grandparent->getLeft()))
+        {
+            rotateUp(parent);
+            if(mode == SplayMode::SEMI)
+            {
+                node = parent;
+                continue;
+            }
+            rotateUp(node);
+        }
+        //zig-zag
+        else
+        {
+            rotateUp(node);
+            rotateUp(node);
+        }
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void SplayTree<Key, Value, Compare, Alloc>::rotateUp(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    Node<Key, Value>* grandparent = parent->getParent();
+
+    //node's inner subtree moves over to parent
+    if(node == parent->getLeft())
+    {
+        parent->setLeft(node->getRight());
+        if(node->getRight() != nullptr)
+        {
+            node->getRight()->setParent(parent);
+        }
+        node->setRight(parent);
+    }
+    else
+    {
+        parent->setRight(node->getLeft());
+        if(node->getLeft() != nullptr)
+        {
+            node->getLeft()->setParent(parent);
+        }
+        node->setLeft(parent);
+    }
+    parent->setParent(node);
+
+    //node takes parent's place below grandparent
+    node->setParent(grandparent);
+    if(grandparent == nullptr)
+    {
+        this->root_ = node;
+    }
+    else if(grandparent->getLeft() == parent)
+    {
+        grandparent->setLeft(node);
+    }
+    else
+    {
+        grandparent->setRight(node);
+    }
+}
+
+#endif
@@ -0,0 +1,500 @@
+#ifndef WEIGHTED_AVLBST_H
+#define WEIGHTED_AVLBST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "avlbst.h"
+
+/**
+* Node augmentation counting the lookups of a node's key. Unlike the other
+* augmentations it belongs to the key, not to the subtree: update() leaves
+* it alone, and WeightedAVLTree keeps it with its node when nodes swap places.
+*/
+struct AccessCount
+{
+    static const bool aggregates = false;
+
+    AccessCount() : accesses_(0) { }
+
+    template<typename Item>
+    void update(const Item&, const AccessCount*, const AccessCount*) { }
+
+    std::uint32_t accesses_;
+};
+
+/**
+* What WeightedAVLTree::optimizeForAccessPattern achieved: the expected
+* number of nodes a lookup visits, weighing every key by its count of
+* lookups plus one, before and after.
+*/
+struct AccessPatternReport
+{
+    double expectedDepthBefore;
+    double expectedDepthAfter;
+};
+
+/**
+* An AVLTree that counts the lookups of every key, for read-mostly tables
+* with a stable, skewed popularity. find() and operator[] count (the const
+* versions do not, nor do findBatch and finger searches).
+*
+* optimizeForAccessPattern() then rebuilds the tree as a nearly optimal
+* BST for those counts, by Mehlhorn's bisection in O(n log n): the root of
+* every subtree is the key at the middle of its weight, so a key of weight
+* w out of a total of W ends up at depth at most log2(W / w) + 1, and the
+* expected depth is within a small additive constant of optimal. Weights
+* are counts plus one, so no key sinks deeper than 33 + log2 n.
+*
+* The rebuilt tree is in general no AVL tree. Lookups and iteration work
+* on it as on any BST, but the first insert or remove after it restores
+* the AVL shape in O(n) (see restoreBalance), after which the tree is an
+* ordinary AVL tree again. The same holds for join, split, the set
+* operations, relayout and bulkLoad, which are redeclared here for that;
+* call them on a WeightedAVLTree, not through an AVLTree reference.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, class Alloc = std::allocator<std::pair<const Key, Value> > >
+class WeightedAVLTree : public AVLTree<Key, Value, Compare, Alloc, AccessCount>
+{
+public:
+    typedef AVLTree<Key, Value, Compare, Alloc, AccessCount> BaseTree;
+    typedef typename BaseTree::iterator iterator;
+    typedef typename BaseTree::const_iterator const_iterator;
+
+    WeightedAVLTree();
+    explicit WeightedAVLTree(const Compare& comp, const Alloc& alloc = Alloc());
+    explicit WeightedAVLTree(const Alloc& alloc);
+    template<typename InputIt>
+    WeightedAVLTree(InputIt first, InputIt last, const Compare& comp = Compare(), const Alloc& alloc = Alloc());
+    // Takes over the nodes of an AVLTree with the same augmentation, e.g. one returned by split().
+    explicit WeightedAVLTree(BaseTree&& other) noexcept;
+
+    // Count the lookup. Other overloads as in AVLTree.
+    using BaseTree::find;
+    iterator find(const Key& key);
+    using BaseTree::operator[];
+    Value& operator[](const Key& key);
+
+    // The lookups of key counted so far; 0 if it is not in the tree.
+    std::uint32_t accessCount(const Key& key) const;
+    void resetAccessCounts();
+
+    AccessPatternReport optimizeForAccessPattern();
+    // Whether the tree has been optimized and not written to since.
+    bool isReshaped() const;
+    // Rebuilds an optimized tree into a perfectly balanced AVL tree, in O(n)
+    // and without allocating; does nothing if it is not optimized.
+    void restoreBalance();
+
+    // Same as in AVLTree, restoring the AVL shape of both trees first.
+    template<typename InputIt>
+    void bulkLoad(InputIt first, InputIt last, DuplicateKeys duplicates = DuplicateKeys::KEEP_LAST);
+    void join(const std::pair<const Key, Value>& item, WeightedAVLTree<Key, Value, Compare, Alloc>&& right);
+    WeightedAVLTree<Key, Value, Compare, Alloc> split(const Key& key);
+    void unionWith(WeightedAVLTree<Key, Value, Compare, Alloc>&& other);
+    void unionWith(const WeightedAVLTree<Key, Value, Compare, Alloc>& other);
+    void intersectWith(const WeightedAVLTree<Key, Value, Compare, Alloc>& other);
+    void difference(const WeightedAVLTree<Key, Value, Compare, Alloc>& other);
+    void relayout();
+
+protected:
+    typedef AVLNode<Key, Value, AccessCount> WeightedNode;
+
+    virtual void nodeSwap(WeightedNode* n1, WeightedNode* n2);
+    virtual void attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft);
+    virtual void eraseNode(Node<Key, Value>* node);
+
+    static void countAccess(WeightedNode* node);
+    // optimizeForAccessPattern helpers; prefix[i] is the weight of nodes[0, i)
+    static WeightedNode* buildWeighted(const std::vector<WeightedNode*>& nodes, const std::vector<std::uint64_t>& prefix,
+                                       std::size_t first, std::size_t last, std::size_t depth, double& weightedDepth);
+    // restoreBalance helper: links the next count nodes of a right-linked vine
+    static WeightedNode* linkBalanced(WeightedNode*& vine, std::size_t count, int& height);
+
+    bool reshaped_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the WeightedAVLTree class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, class Alloc>
+WeightedAVLTree<Key, Value, Compare, Alloc>::WeightedAVLTree() : reshaped_(false)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+WeightedAVLTree<Key, Value, Compare, Alloc>::WeightedAVLTree(const Compare& comp, const Alloc& alloc) :
+    BaseTree(comp, alloc), reshaped_(false)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+WeightedAVLTree<Key, Value, Compare, Alloc>::WeightedAVLTree(const Alloc& alloc) : BaseTree(alloc), reshaped_(false)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt>
+WeightedAVLTree<Key, Value, Compare, Alloc>::WeightedAVLTree(InputIt first, InputIt last, const Compare& comp, const Alloc& alloc) :
+    BaseTree(first, last, comp, alloc), reshaped_(false)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+WeightedAVLTree<Key, Value, Compare, Alloc>::WeightedAVLTree(BaseTree&& other) noexcept :
+    BaseTree(std::move(other)), reshaped_(false)
+{
+
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename WeightedAVLTree<Key, Value, Compare, Alloc>::iterator
+WeightedAVLTree<Key, Value, Compare, Alloc>::find(const Key& key)
+{
+    WeightedNode* node = static_cast<WeightedNode*>(this->internalFind(key));
+    if(node == nullptr)
+    {
+        return this->end();
+    }
+    countAccess(node);
+    return this->makeIterator(node);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+Value& WeightedAVLTree<Key, Value, Compare, Alloc>::operator[](const Key& key)
+{
+    WeightedNode* node = static_cast<WeightedNode*>(this->internalFind(key));
+    if(node == nullptr)
+    {
+        throw std::out_of_range("Invalid key");
+    }
+    countAccess(node);
+    return node->getValue();
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+std::uint32_t WeightedAVLTree<Key, Value, Compare, Alloc>::accessCount(const Key& key) const
+{
+    const WeightedNode* node = static_cast<const WeightedNode*>(this->internalFind(key));
+    return (node == nullptr) ? 0 : node->accesses_;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::resetAccessCounts()
+{
+    for(Node<Key, Value>* node = this->getSmallestNode(); node != nullptr; node = this->successor(node))
+    {
+        static_cast<WeightedNode*>(node)->accesses_ = 0;
+    }
+}
+
+/*
+ * Counts saturate instead of wrapping around.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::countAccess(WeightedNode* node)
+{
+    if(node->accesses_ != std::numeric_limits<std::uint32_t>::max())
+    {
+        ++node->accesses_;
+    }
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+bool WeightedAVLTree<Key, Value, Compare, Alloc>::isReshaped() const
+{
+    return reshaped_;
+}
+
+/*
+ * Relinks the nodes in place; they and their counts stay the same, so
+ * iterators stay valid. The node list is allocated before anything is
+ * changed, so if that throws, the tree is as it was.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+AccessPatternReport WeightedAVLTree<Key, Value, Compare, Alloc>::optimizeForAccessPattern()
+{
+    AccessPatternReport report = { 0.0, 0.0 };
+    if(this->root_ == nullptr)
+    {
+        return report;
+    }
+    std::vector<WeightedNode*> nodes;
+    std::vector<std::uint64_t> prefix(1, 0);
+    double weightedDepth = 0.0;
+    for(Node<Key, Value>* node = this->getSmallestNode(); node != nullptr; node = this->successor(node))
+    {
+        WeightedNode* weighted = static_cast<WeightedNode*>(node);
+        const std::uint64_t weight = std::uint64_t(weighted->accesses_) + 1;
+        std::size_t depth = 0;
+        for(Node<Key, Value>* up = node; up != nullptr; up = up->getParent())
+        {
+            ++depth;
+        }
+        nodes.push_back(weighted);
+        prefix.push_back(prefix.back() + weight);
+        weightedDepth += double(weight) * double(depth);
+    }
+    const double totalWeight = double(prefix.back());
+    report.expectedDepthBefore = weightedDepth / totalWeight;
+
+    weightedDepth = 0.0;
+    WeightedNode* root = buildWeighted(nodes, prefix, 0, nodes.size(), 1, weightedDepth);
+    root->setParent(nullptr);
+    this->root_ = root;
+    reshaped_ = true;
+    report.expectedDepthAfter = weightedDepth / totalWeight;
+    return report;
+}
+
+/*
+ * Makes the node at the middle of the weight of nodes[first, last) their
+ * root, and does the same for both sides, so that every step down at least
+ * halves the weight of the subtree. The balances are left at
+ * 0: they mean nothing until restoreBalance.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+typename WeightedAVLTree<Key, Value, Compare, Alloc>::WeightedNode*
+WeightedAVLTree<Key, Value, Compare, Alloc>::buildWeighted(const std::vector<WeightedNode*>& nodes, const std::vector<std::uint64_t>& prefix,
+                                                           std::size_t first, std::size_t last, std::size_t depth, double& weightedDepth)
+{
+    if(first == last)
+    {
+        return nullptr;
+    }
+    //the node whose weight spans the middle leaves at most half of it to either side
+    const std::uint64_t middle = prefix[first] + (prefix[last] - prefix[first]) / 2;
+    const std::size_t mid = std::upper_bound(prefix.begin() + first + 1, prefix.begin() + last + 1, middle) - prefix.begin() - 1;
+
+    WeightedNode* node = nodes[mid];
+    weightedDepth += double(prefix[mid + 1] - prefix[mid]) * double(depth);
+    node->setBalance(0);
+    WeightedNode* left = buildWeighted(nodes, prefix, first, mid, depth + 1, weightedDepth);
+    WeightedNode* right = buildWeighted(nodes, prefix, mid + 1, last, depth + 1, weightedDepth);
+    node->setLeft(left);
+    node->setRight(right);
+    if(left != nullptr)
+    {
+        left->setParent(node);
+    }
+    if(right != nullptr)
+    {
+        right->setParent(node);
+    }
+    return node;
+}
+
+/*
+ * Day-Stout-Warren style: the tree is first rotated into a vine, a list of
+ * its nodes in key order linked through their right children, which is
+ * then linked up into a tree of minimal height, as bulkLoad builds it.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::restoreBalance()
+{
+    if(!reshaped_)
+    {
+        return;
+    }
+    reshaped_ = false;
+
+    //rotate every left child up until there is none
+    WeightedNode* vine = nullptr;
+    WeightedNode* tail = nullptr;
+    WeightedNode* rest = static_cast<WeightedNode*>(this->root_);
+    std::size_t count = 0;
+    while(rest != nullptr)
+    {
+        if(rest->getLeft() == nullptr)
+        {
+            if(tail == nullptr)
+            {
+                vine = rest;
+            }
+            else
+            {
+                tail->setRight(rest);
+            }
+            tail = rest;
+            rest = rest->getRight();
+            ++count;
+        }
+        else
+        {
+            WeightedNode* left = rest->getLeft();
+            rest->setLeft(left->getRight());
+            left->setRight(rest);
+            rest = left;
+        }
+    }
+
+    int height;
+    WeightedNode* root = linkBalanced(vine, count, height);
+    if(root != nullptr)
+    {
+        root->setParent(nullptr);
+    }
+    this->root_ = root;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+typename WeightedAVLTree<Key, Value, Compare, Alloc>::WeightedNode*
+WeightedAVLTree<Key, Value, Compare, Alloc>::linkBalanced(WeightedNode*& vine, std::size_t count, int& height)
+{
+    if(count == 0)
+    {
+        height = 0;
+        return nullptr;
+    }
+    //the left half gets the smaller share, as in buildBalanced
+    int leftHeight, rightHeight;
+    WeightedNode* left = linkBalanced(vine, (count - 1) / 2, leftHeight);
+    WeightedNode* node = vine;
+    vine = vine->getRight();
+    WeightedNode* right = linkBalanced(vine, count - 1 - (count - 1) / 2, rightHeight);
+
+    node->setLeft(left);
+    node->setRight(right);
+    if(left != nullptr)
+    {
+        left->setParent(node);
+    }
+    if(right != nullptr)
+    {
+        right->setParent(node);
+    }
+    node->setBalance(static_cast<int8_t>(rightHeight - leftHeight));
+    node->refreshAugment();
+    height = std::max(leftHeight, rightHeight) + 1;
+    return node;
+}
+
+/*
+ * The AVL code swaps the augmentation along with the balance, as position
+ * data; access counts go with their keys, so they are swapped back.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::nodeSwap(WeightedNode* n1, WeightedNode* n2)
+{
+    BaseTree::nodeSwap(n1, n2);
+    std::swap(n1->accesses_, n2->accesses_);
+}
+
+/*
+ * On an optimized tree, the AVL shape comes back first, and the new node
+ * is then inserted into that.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::attachNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft)
+{
+    if(reshaped_)
+    {
+        restoreBalance();
+        this->findSlot(node->getKey(), parent, isLeft);
+    }
+    BaseTree::attachNode(node, parent, isLeft);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::eraseNode(Node<Key, Value>* node)
+{
+    restoreBalance();
+    BaseTree::eraseNode(node);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+template<typename InputIt>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::bulkLoad(InputIt first, InputIt last, DuplicateKeys duplicates)
+{
+    BaseTree::bulkLoad(first, last, duplicates);
+    reshaped_ = false;
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::join(const std::pair<const Key, Value>& item, WeightedAVLTree<Key, Value, Compare, Alloc>&& right)
+{
+    restoreBalance();
+    right.restoreBalance();
+    BaseTree::join(item, std::move(right));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+WeightedAVLTree<Key, Value, Compare, Alloc> WeightedAVLTree<Key, Value, Compare, Alloc>::split(const Key& key)
+{
+    restoreBalance();
+    return WeightedAVLTree<Key, Value, Compare, Alloc>(BaseTree::split(key));
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::unionWith(WeightedAVLTree<Key, Value, Compare, Alloc>&& other)
+{
+    restoreBalance();
+    other.restoreBalance();
+    BaseTree::unionWith(std::move(other));
+}
+
+/*
+ * An optimized other is copied and the copy rebalanced.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::unionWith(const WeightedAVLTree<Key, Value, Compare, Alloc>& other)
+{
+    restoreBalance();
+    if(other.reshaped_ && &other != this)
+    {
+        WeightedAVLTree<Key, Value, Compare, Alloc> copy(other);
+        copy.restoreBalance();
+        BaseTree::unionWith(std::move(copy));
+        return;
+    }
+    BaseTree::unionWith(other);
+}
+
+/*
+ * These only search other, whatever its shape.
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::intersectWith(const WeightedAVLTree<Key, Value, Compare, Alloc>& other)
+{
+    if(&other != this)
+    {
+        restoreBalance();
+    }
+    BaseTree::intersectWith(other);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::difference(const WeightedAVLTree<Key, Value, Compare, Alloc>& other)
+{
+    if(&other != this)
+    {
+        restoreBalance();
+    }
+    BaseTree::difference(other);
+}
+
+template<class Key, class Value, class Compare, class Alloc>
+void WeightedAVLTree<Key, Value, Compare, Alloc>::relayout()
+{
+    restoreBalance();
+    BaseTree::relayout();
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the WeightedAVLTree class.
+  ---------------------------------------------
+*/
+
+#endif